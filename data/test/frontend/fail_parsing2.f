@@ -0,0 +1,5 @@
+var snapshot = 1;
+
+var f = function(snapshot) {
+  return snapshot;
+};
@@ -23,4 +23,5 @@ _ = int(1, 2);
 _ = float(3, 2);
 _ = length(1, 2);
 _ = charAt(1, 2, 3);
-_ = append(1, 2, 3);
\ No newline at end of file
+_ = append(1, 2, 3);
+_ = snapshot(1);
\ No newline at end of file
@@ -0,0 +1,38 @@
+var println = function(x) {
+  print(x);
+  print("\n");
+};
+
+println("strings keep their bytes: \ttab");
+println("");
+println(9223372036854775807);
+println(subtract(subtract(0, 9223372036854775807), 1));
+println(0.1);
+println(12345.678);
+println(true);
+println(false);
+println(undefined);
+
+var point = {x: 1, y: 2.5, label: "p"};
+println(get(point, "label"));
+println(add(get(point, "y"), 1.0));
+
+var counter = function(start) {
+  var step = function(n) {
+    return add(n, start);
+  };
+  return step;
+};
+var byTen = counter(10);
+println(byTen(5));
+var half = counter(0.5);
+println(half(1.5));
+
+var words = {};
+var i = 0;
+while (less(i, 5)) {
+  set(words, append("", i), charAt("flang", i));
+  i = add(i, 1);
+}
+println(length(words));
+println(get(words, "4"));
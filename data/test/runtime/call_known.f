@@ -0,0 +1,49 @@
+var calls = {};
+var note = function(tag) {
+  set(calls, append("c", length(calls)), tag);
+  print(tag);
+  return tag;
+};
+
+var three = function(a, b, c) {
+  print(a); print(" "); print(b); print(" "); print(c); print("\n");
+  return add(a, 1);
+};
+
+var _ = three(1, 2, 3);
+_ = three(1);
+_ = three();
+
+_ = print("extra arguments are still evaluated: ");
+_ = three(1, 2, 3, note("x"), note("y"));
+print(length(calls)); print("\n");
+
+var countdown = function(n) {
+  if (lessOrEqual(n, 0)) {
+    return 0;
+  }
+  return add(n, countdown(subtract(n, 1)));
+};
+print(countdown(100)); print("\n");
+
+var sum = 0;
+var i = 0;
+while (less(i, 1000)) {
+  sum = add(sum, three(i, i, i, i));
+  i = add(i, 1000);
+}
+
+var twice = function(x) { return multiply(x, 2); };
+var hot = 0;
+var j = 0;
+while (less(j, 2000)) {
+  hot = add(hot, twice(j));
+  j = add(j, 1);
+}
+print(hot); print("\n");
+
+var outer = function(n) {
+  var inner = function(m) { return add(m, n); };
+  return inner(n);
+};
+print(outer(21)); print("\n");
@@ -0,0 +1,76 @@
+var intoFloat = function(n) {
+  var i = 0;
+  var total = 0;
+  var step = 2;
+  while (less(i, n)) {
+    total = add(total, step);
+    if (equal(i, 2500)) {
+      print(total); print(" ");
+      total = 0.5;
+      step = 0.25;
+    }
+    i = add(i, 1);
+  }
+  return total;
+};
+print(intoFloat(3000)); print("\n");
+
+var byZero = function(dividend, n) {
+  var divisor = 3;
+  var quotient = 0;
+  var undefinedCount = 0;
+  var j = 0;
+  while (less(j, n)) {
+    if (equal(j, 1000)) { divisor = 0; }
+    if (equal(j, 1001)) { divisor = 7; }
+    var q = divide(dividend, divisor);
+    if (equal(q, undefined)) {
+      undefinedCount = add(undefinedCount, 1);
+    } else {
+      quotient = q;
+    }
+    j = add(j, 1);
+  }
+  print(quotient); print(" "); print(undefinedCount); print("\n");
+};
+byZero(12, 2000);
+
+var byMinusOne = function(dividend, n) {
+  var divisor = 3;
+  var quotient = 0;
+  var j = 0;
+  while (less(j, n)) {
+    if (equal(j, 1000)) { divisor = subtract(0, 1); }
+    quotient = add(quotient, divide(dividend, divisor));
+    j = add(j, 1);
+  }
+  print(quotient); print("\n");
+};
+byMinusOne(subtract(subtract(0, 9223372036854775807), 1), 1001);
+byMinusOne(subtract(0, 12), 2000);
+
+var plus = function(a, b) { return add(a, b); };
+var minus = function(a, b) { return subtract(a, b); };
+var apply = function(f, a, b) { return f(a, b); };
+var callTargets = function(n) {
+  var k = 0;
+  var acc = 0;
+  while (less(k, n)) {
+    acc = apply(plus, acc, k);
+    if (greater(k, 2500)) { acc = apply(minus, acc, 1); }
+    k = add(k, 1);
+  }
+  return acc;
+};
+print(callTargets(3000)); print("\n");
+
+var countTo = function(n) {
+  var c = 0;
+  var s = 0;
+  while (less(c, n)) {
+    s = add(s, c);
+    c = add(c, 1);
+  }
+  return s;
+};
+print(countTo(5000)); print(" "); print(countTo(2.5)); print(" "); print(countTo(10)); print("\n");
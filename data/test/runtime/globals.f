@@ -0,0 +1,43 @@
+var counter = 0;
+var current = function() { return counter; };
+
+counter = add(counter, 1);
+print(current()); print("\n");
+
+var name = "outer";
+{
+  var name = "block";
+  print(name); print("\n");
+  counter = add(counter, 10);
+}
+print(name); print(" "); print(counter); print(" "); print(current()); print("\n");
+
+var shadow = function(counter) {
+  counter = add(counter, 100);
+  return counter;
+};
+print(shadow(1)); print(" "); print(counter); print("\n");
+
+var i = 0;
+while (less(i, 1000)) {
+  counter = add(current(), 1);
+  i = add(i, 1);
+}
+print(counter); print("\n");
+
+var makeAdder = function(n) {
+  return function(x) { return add(add(x, n), counter); };
+};
+var addFive = makeAdder(5);
+counter = 0;
+print(addFive(1)); print("\n");
+counter = "now a string";
+print(current()); print("\n");
+
+var total = 0;
+var j = 0;
+while (less(j, 500)) {
+  total = add(total, j);
+  j = add(j, 1);
+}
+print(total); print("\n");
@@ -0,0 +1,120 @@
+var println = function(x) {
+  print(x);
+  print("\n");
+};
+
+var square = function(x) { return multiply(x, x); };
+var sign = function(x) {
+  if (less(x, 0)) { return subtract(0, 1); }
+  if (greater(x, 0)) { return 1; }
+  return 0;
+};
+var pad = function(a, b) { return append(a, b); };
+println(square(12));
+println(add(sign(subtract(0, 5)), add(sign(0), sign(7))));
+println(pad("x"));
+println(pad("x", "y", "z"));
+
+var factorial = function(n) {
+  if (lessOrEqual(n, 1)) { return 1; }
+  return multiply(n, factorial(subtract(n, 1)));
+};
+println(factorial(20));
+
+var outer = function() {
+  var inner = function(y) { return multiply(y, 2); };
+  var r = inner(21);
+  inner = function(y) { return y; };
+  return add(r, inner(1));
+};
+println(outer());
+
+var invariant = function(n, base) {
+  var total = 0;
+  var i = 0;
+  while (less(i, n)) {
+    var scale = multiply(base, 3);
+    var quotient = divide(base, 0);
+    if (equal(quotient, undefined)) {
+      total = add(total, scale);
+    }
+    i = add(i, 1);
+  }
+  return total;
+};
+println(invariant(10, 2));
+println(invariant(0, 2));
+
+var growing = function() {
+  var o = {};
+  var sizes = 0;
+  var i = 0;
+  while (less(i, 4)) {
+    sizes = add(sizes, length(o));
+    set(o, append("k", i), i);
+    i = add(i, 1);
+  }
+  return sizes;
+};
+println(growing());
+
+var numbering = function(o) {
+  var first = get(o, "a");
+  var again = get(o, "a");
+  var before = length(o);
+  set(o, "b", 2);
+  var after = length(o);
+  return add(add(first, again), multiply(10, subtract(after, before)));
+};
+println(numbering({a: 4}));
+println(numbering({a: 4, b: 1}));
+
+var sameSum = function(a, b) {
+  var x = add(a, b);
+  var y = add(a, b);
+  if (less(a, b)) {
+    var z = add(a, b);
+    return add(x, z);
+  }
+  return add(x, y);
+};
+println(sameSum(1, 2));
+println(sameSum(2.5, 1.0));
+
+var point = function(x, y) {
+  var p = {x: x, y: y};
+  return add(get(p, "x"), get(p, "y"));
+};
+println(point(3, 4));
+
+var widened = function(x) {
+  var p = {x: x};
+  set(p, "y", 5);
+  set(p, "x", 100);
+  return add(get(p, "x"), add(get(p, "y"), length(p)));
+};
+println(widened(1));
+
+var escaping = function(x) {
+  var p = {v: x};
+  var peek = function() { return get(p, "v"); };
+  set(p, "w", 1);
+  return add(peek(), length(p));
+};
+println(escaping(8));
+
+var stored = function(x) {
+  var p = {v: x};
+  var holder = {inner: p};
+  set(p, "z", 9);
+  return get(get(holder, "inner"), "z");
+};
+println(stored(1));
+
+var hot = 0;
+var j = 0;
+while (less(j, 3000)) {
+  hot = add(hot, add(square(j), point(j, 1)));
+  j = add(j, 1);
+}
+println(hot);
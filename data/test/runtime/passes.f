@@ -0,0 +1,60 @@
+var i = 0;
+while (true) {
+  i = add(i, 1);
+  if (greater(i, 5)) { break; }
+}
+print(i); print("\n");
+if (false) { print("no\n"); } else { print("yes\n"); }
+if (1) { print("one\n"); }
+if (undefined) { print("bad\n"); }
+var f = function(n) {
+  if (less(n, 0)) { return "neg"; print("unreachable"); }
+  var _ = print("dead store\n");
+  var unused = add(n, 1);
+  while (true) { return "pos"; }
+};
+print(f(subtract(0, 1))); print(f(1)); print("\n");
+var j = 0;
+var total = 0;
+while (less(j, 10)) {
+  var k = 0;
+  while (true) {
+    if (greaterOrEqual(k, j)) { break; }
+    total = add(total, k);
+    k = add(k, 1);
+  }
+  j = add(j, 1);
+}
+print(total); print("\n");
+var obj = { a: 1, b: "two" };
+var n = 0;
+while (less(n, 3)) {
+  print(get(obj, "a")); print(length(obj));
+  set(obj, append("k", n), n);
+  n = add(n, 1);
+}
+print("\n"); print(length(obj)); print("\n");
+var m = 0;
+while (less(m, 3)) { var t = add(m, 100); print(t); m = add(m, 1); }
+print("\n");
+var limit = multiply(60, 60);
+print(limit); print("\n");
+print(append("prefix-", "x")); print("\n");
+print(add(1.5, 2.5)); print("\n");
+print(divide(7, 0)); print("\n");
+print(divide(7.0, 2.0)); print("\n");
+print(add(1, 2.0)); print("\n");
+print(less(1, 2)); print(greater(1, 2)); print(lessOrEqual(2, 2)); print(greaterOrEqual(1, 2)); print("\n");
+print(length("hello")); print(type(1)); print(type("s")); print(type(1.0)); print(type(true)); print(type(undefined)); print("\n");
+print(length(1)); print("\n");
+var c = 10;
+var d = add(c, 5);
+print(d); print("\n");
+print(append(1, 2)); print("\n");
+print(subtract(10, 3)); print(subtract(1.0, 0.5)); print("\n");
+print(int("42")); print(float("1.5")); print(charAt("abc", 1)); print("\n");
+var s = "q";
+s = append(s, "r");
+print(s); print("\n");
+print(add(9223372036854775807, 1)); print("\n");
+print(multiply(true, true)); print("\n");
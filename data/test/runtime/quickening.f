@@ -0,0 +1,52 @@
+var sum = function(a, b) { return add(a, b); };
+var diff = function(a, b) { return subtract(a, b); };
+var scale = function(a, b) { return multiply(a, b); };
+var ratio = function(a, b) { return divide(a, b); };
+var below = function(a, b) { return less(a, b); };
+var atMost = function(a, b) { return lessOrEqual(a, b); };
+var above = function(a, b) { return greater(a, b); };
+var atLeast = function(a, b) { return greaterOrEqual(a, b); };
+
+var run = function(a, b) {
+  print(sum(a, b)); print(" ");
+  print(diff(a, b)); print(" ");
+  print(scale(a, b)); print(" ");
+  print(ratio(a, b)); print(" ");
+  print(below(a, b)); print(" ");
+  print(atMost(a, b)); print(" ");
+  print(above(a, b)); print(" ");
+  print(atLeast(a, b)); print("\n");
+};
+
+var i = 0;
+var total = 0;
+while (less(i, 600)) {
+  total = add(total, sum(i, 1));
+  total = subtract(total, diff(i, 2));
+  total = add(total, scale(i, 3));
+  total = add(total, ratio(i, 7));
+  if (below(i, 300)) { total = add(total, 1); }
+  if (atLeast(i, 300)) { total = subtract(total, 1); }
+  i = add(i, 1);
+}
+print(total); print("\n");
+
+run(7, 2);
+run(7.5, 2.5);
+run(7, 0);
+run(2, 7.5);
+run("a", "b");
+run(true, false);
+run(undefined, 1);
+run(7, 2);
+run(1.0, 4.0);
+
+var mixed = 0;
+var step = 1;
+var j = 0;
+while (less(j, 600)) {
+  if (equal(j, 400)) { mixed = 0.5; step = 1.5; }
+  mixed = sum(mixed, step);
+  j = add(j, 1);
+}
+print(mixed); print("\n");
@@ -0,0 +1,33 @@
+var calls = {};
+var f = function(tag, value) {
+  set(calls, append("c", length(calls)), tag);
+  print(tag);
+  return value;
+};
+
+print(and(false, f("a", true))); print("\n");
+print(or(true, f("b", false))); print("\n");
+print(and(true, f("c", 1))); print("\n");
+print(or(false, f("d", "s"))); print("\n");
+print(and(f("e", false), f("f", true))); print("\n");
+print(or(f("g", 0), f("h", undefined))); print("\n");
+print(and(and(true, false), f("i", true))); print("\n");
+print(or(and(false, f("j", true)), f("k", 2))); print("\n");
+print(and(1, "x")); print(or(undefined, 0)); print("\n");
+print(length(calls)); print("\n");
+
+var x = undefined;
+if (and(notEqual(x, undefined), less(get(x, "a"), 3))) { print("t\n"); } else { print("f\n"); }
+
+var guarded = function(n) {
+  var hits = 0;
+  var i = 0;
+  while (less(i, n)) {
+    if (or(equal(i, 0), greater(divide(100, i), 10))) {
+      hits = add(hits, 1);
+    }
+    i = add(i, 1);
+  }
+  return hits;
+};
+print(guarded(3000)); print("\n");
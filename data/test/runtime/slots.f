@@ -0,0 +1,86 @@
+var swap = function(n) {
+  var a = 1;
+  var b = 2;
+  var i = 0;
+  while (less(i, n)) {
+    var t = a;
+    a = b;
+    b = t;
+    i = add(i, 1);
+  }
+  return add(multiply(a, 10), b);
+};
+print(swap(3)); print("\n");
+print(swap(4)); print("\n");
+
+var nested = function(n) {
+  var total = 0;
+  var i = 0;
+  while (true) {
+    if (greater(i, n)) { break; }
+    var j = 0;
+    while (less(j, i)) {
+      if (equal(j, 3)) { break; }
+      total = add(total, j);
+      j = add(j, 1);
+    }
+    i = add(i, 1);
+  }
+  return total;
+};
+print(nested(6)); print("\n");
+
+var counter = function(start) {
+  var value = start;
+  var getter = function() { return value; };
+  value = add(value, 5);
+  var first = getter();
+  value = add(value, 1);
+  return add(first, getter());
+};
+print(counter(1)); print("\n");
+
+var args = function(a, b, c) {
+  a = add(a, 1);
+  return add(c, add(b, a));
+};
+print(args(1, 2, 3)); print("\n");
+print(args(1, 2)); print("\n");
+
+var deep = function(x) {
+  var y = x;
+  if (x) { y = "yes"; } else { y = "no"; }
+  var inner = function() {
+    var z = y;
+    var f = function() { return append(z, y); };
+    return f();
+  };
+  return inner();
+};
+print(deep(true)); print("\n");
+print(deep(false)); print("\n");
+
+var phases = function(n) {
+  var first = multiply(n, 2);
+  var done = add(first, 1);
+  var second = append("s", done);
+  var third = float(n);
+  var fourth = add(third, 0.5);
+  return append(second, fourth);
+};
+print(phases(3)); print("\n");
+
+var loopCarried = function(n) {
+  var result = 0;
+  var i = 0;
+  while (less(i, n)) {
+    var early = multiply(i, 2);
+    result = add(result, early);
+    var late = add(result, i);
+    if (greater(late, 1000)) { return late; }
+    i = add(i, 1);
+  }
+  return result;
+};
+print(loopCarried(10)); print("\n");
+print(loopCarried(100)); print("\n");
@@ -0,0 +1,59 @@
+var println = function(x) {
+  print(x);
+  print("\n");
+};
+
+var makeCounter = function(start) {
+  var seen = {};
+  return {
+    Next: function() {
+      set(seen, append("n", length(seen)), true);
+      return add(start, length(seen));
+    }
+  };
+};
+
+var next = get(makeCounter(40), "Next");
+var square = function(x) { return multiply(x, x); };
+var table = {};
+var total = 0;
+var i = 0;
+while (less(i, 3000)) {
+  total = add(total, square(i));
+  if (equal(multiply(divide(i, 1000), 1000), i)) {
+    set(table, append("k", i), float(i));
+  }
+  i = add(i, 1);
+}
+
+println("before");
+println(next());
+
+var pause = function(label) {
+  var local = append(label, "!");
+  snapshot();
+  return local;
+};
+
+var resumed = 0;
+var j = 0;
+while (less(j, 3)) {
+  if (equal(j, 1)) {
+    println(pause("resumed"));
+  }
+  resumed = add(resumed, j);
+  j = add(j, 1);
+}
+
+println("after");
+println(next());
+println(total);
+println(get(table, "k2000"));
+println(resumed);
+total = 0;
+i = 0;
+while (less(i, 3000)) {
+  total = add(total, square(i));
+  i = add(i, 1);
+}
+println(total);
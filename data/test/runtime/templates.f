@@ -0,0 +1,55 @@
+var mix = function(a, b, c, d, e) {
+  var wide = add(add(a, b), add(c, add(d, add(e, multiply(a, 2)))));
+  var narrow = subtract(multiply(a, b), c);
+  var flag = less(wide, narrow);
+  var t = a;
+  a = b;
+  b = t;
+  a = add(a, a);
+  if (greaterOrEqual(a, b)) {
+    return add(add(wide, narrow), a);
+  }
+  if (flag) {
+    return subtract(narrow, b);
+  }
+  return b;
+};
+
+var loop = function(n) {
+  var i = 0;
+  var acc = 0;
+  var swaps = 0;
+  var other = 1;
+  while (less(i, n)) {
+    acc = add(acc, mix(i, 1, 2, 3, 4));
+    var tmp = acc;
+    acc = other;
+    other = tmp;
+    if (lessOrEqual(i, 10)) {
+      swaps = add(swaps, 1);
+    }
+    i = add(i, 1);
+  }
+  return add(add(acc, other), swaps);
+};
+
+print(loop(5)); print("\n");
+print(loop(2000)); print("\n");
+print(mix(1.5, 2.5, 3.5, 4.5, 5.5)); print("\n");
+print(mix("a", "b", "c", "d", "e")); print("\n");
+print(mix(2, 1.0, 3, 4, 5)); print("\n");
+print(loop(2000)); print("\n");
+
+var g = 0;
+var h = 3;
+var i = 0;
+while (less(i, 3000)) {
+  g = add(g, h);
+  h = subtract(h, 1);
+  if (greater(h, 5)) { h = 0; }
+  if (less(h, subtract(0, 5))) { h = 5; }
+  var cmp = greater(g, 100);
+  if (cmp) { g = subtract(g, 100); }
+  i = add(i, 1);
+}
+print(g); print(" "); print(h); print("\n");
@@ -0,0 +1,41 @@
+var x = 1;
+var y = 2.5;
+{
+  var x = 1.5;
+  print(add(x, y)); print("\n");
+}
+print(add(x, 2)); print(" "); print(multiply(x, 3)); print(" "); print(less(x, 2)); print("\n");
+
+var f = function(a) { return add(a, x); };
+print(f(3)); print(" "); print(f(0.5)); print("\n");
+
+var z = 10;
+while (greater(z, 0)) {
+  z = subtract(z, 3);
+}
+print(z); print("\n");
+
+var w = 4;
+var i = 0;
+while (less(i, 3)) {
+  print(multiply(w, 2)); print("\n");
+  w = 1.5;
+  i = add(i, 1);
+}
+
+var later = 7;
+var early = function() { return later; };
+print(early()); print(" "); print(add(later, 1)); print("\n");
+later = "seven";
+print(early()); print(" "); print(add(later, 1)); print("\n");
+
+var n = 0;
+var fl = 0.0;
+var k = 0;
+while (less(k, 1000)) {
+  n = add(n, divide(k, 3));
+  fl = add(fl, divide(1.0, 4.0));
+  k = add(k, 1);
+}
+print(n); print(" "); print(fl); print("\n");
+print(divide(7, 0)); print(" "); print(add(int(2.7), 1)); print(" "); print(greaterOrEqual(2.5, 2.5)); print("\n");
@@ -5,9 +5,14 @@
 #include "Ast.hpp"
 #include "AstWalker.hpp"
 #include "ByteCode.hpp"
+#include "TypeAnalyzer.hpp"
 
 namespace compiler {
 
+// part of the compilation cache key, bump it whenever the same source would
+// compile to different bytecode
+constexpr std::uint32_t compilerVersion = 12;
+
 class AstCompiler {
 private:
 
@@ -23,8 +23,11 @@ enum class ByteCodeInstruction {
   LoadBooleanFalseConstant,
   LoadLocal,
   SetLocal,
+  LoadGlobal,
+  SetGlobal,
   Return,
   Invoke,
+  CallKnown, // invokes functions[parameter] directly, argument count fixed at compile time
   NoOp,
   MakeFn,
   MakeObj,
@@ -48,11 +51,33 @@ enum class ByteCodeInstruction {
   GetEnv, // 1 arg, returns string
   LoadClosure,
   Pop,
+  Snapshot, // no args, returns undefined
+
+  // quickened forms, emitted by the compiler when type inference proves the
+  // operands or produced by the runtime once an instruction has only seen
+  // operands of one numeric type, they fall back to the generic instruction
+  // when their guard fails
+  AddIntInt,
+  AddFloatFloat,
+  SubtractIntInt,
+  SubtractFloatFloat,
+  MultiplyIntInt,
+  MultiplyFloatFloat,
+  DivideIntInt,
+  DivideFloatFloat,
+  LessIntInt,
+  LessFloatFloat,
+  LessOrEqualIntInt,
+  LessOrEqualFloatFloat,
+  GreaterIntInt,
+  GreaterFloatFloat,
+  GreaterOrEqualIntInt,
+  GreaterOrEqualFloatFloat,
 };
 
 struct ByteCode {
-  const ByteCodeInstruction instruction;
-  const std::size_t parameter;
+  ByteCodeInstruction instruction;
+  std::size_t parameter;
 
   explicit ByteCode(
     ByteCodeInstruction instruction,
@@ -108,6 +133,7 @@ struct ObjectConstructor {
 struct CompiledFile {
 
   const Function entrypoint;
+  const std::size_t globalsCount;
   const std::vector<Function> functions;
   const std::vector<ObjectConstructor> objects;
   const std::vector<std::int64_t> intConstants;
@@ -116,6 +142,7 @@ struct CompiledFile {
 
   explicit CompiledFile(
     Function entrypoint,
+    std::size_t globalsCount,
     std::vector<Function> functions,
     std::vector<ObjectConstructor> objects,
     std::vector<std::int64_t> intConstants,
@@ -123,6 +150,7 @@ struct CompiledFile {
     std::vector<std::string> stringConstants
   ) noexcept
   : entrypoint{std::move(entrypoint)}
+  , globalsCount{globalsCount}
   , functions{std::move(functions)}
   , objects{std::move(objects)}
   , intConstants{std::move(intConstants)}
@@ -132,6 +160,32 @@ struct CompiledFile {
 
 };
 
+class StackEffect {
+public:
+  std::size_t pops;
+  std::size_t pushes;
+};
+
+// values an instruction takes from and leaves on the op stack of its own frame,
+// Invoke and CallKnown count the returned value as pushed
+StackEffect stackEffect(
+  const ByteCode& bc,
+  const std::vector<Function>& functions,
+  const std::vector<ObjectConstructor>& objects) noexcept;
+
+// op stack depth before every instruction, nullopt for unreachable ones. fails
+// when two paths disagree or a jump leaves the function
+std::optional<std::vector<std::optional<std::size_t>>> stackDepths(
+  const std::vector<ByteCode>& byteCode,
+  const std::vector<Function>& functions,
+  const std::vector<ObjectConstructor>& objects) noexcept;
+
+// instruction name with its parameter, nullopt for an unknown instruction
+std::optional<std::string> byteCodeToString(const ByteCode& bc) noexcept;
+
+// FNV-1a over everything the compiler emitted, equal for equal scripts
+std::uint64_t hashCompiledFile(const CompiledFile& file) noexcept;
+
 }
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef BYTECODE_FILE_HPP
+#define BYTECODE_FILE_HPP
+
+#include "lib.hpp"
+#include "ByteCode.hpp"
+
+namespace bytecode {
+
+// Versioned binary form of a compiled file, written by flang --compile. All
+// fields are 64 bit words in host byte order:
+//   "FLANGBC\0", version << 32 | instruction count, byte order mark,
+//   globals count, entrypoint, functions, objects, int, float and string constants
+// a function is its argument and locals count, its closures and its bytecode,
+// lists start with their length and strings are padded to a whole word
+constexpr std::uint32_t byteCodeFileVersion = 1;
+
+// word level encoding of the format, also used by runtime snapshots
+class ByteCodeWriter {
+private:
+  std::ostream & out;
+
+public:
+  explicit ByteCodeWriter(std::ostream & out) noexcept;
+
+  void word(std::uint64_t value);
+
+  void string(const std::string & value);
+
+  void function(const Function& fn);
+};
+
+// every read is bounds checked, a truncated or corrupt file just fails to load
+class ByteCodeReader {
+private:
+  const std::uint8_t* position;
+  const std::uint8_t* end;
+
+public:
+  explicit ByteCodeReader(const std::uint8_t* data, std::size_t size) noexcept;
+
+  bool isAtEnd() const;
+
+  bool word(std::uint64_t& value);
+
+  bool length(std::uint64_t& value, std::size_t elementSize);
+
+  bool variableCount(std::uint64_t& value);
+
+  bool string(std::string& value);
+
+  // everything not read yet
+  std::string rest();
+
+  std::optional<Function> function();
+};
+
+void writeCompiledFile(const CompiledFile& file, std::ostream & out);
+
+// reads the whole file and decodes it into owned vectors, nullptr when the
+// file cannot be read or was written by a different version
+std::shared_ptr<CompiledFile> loadCompiledFile(const std::string & path);
+
+// the same for a file that is already in memory
+std::shared_ptr<CompiledFile> decodeCompiledFile(const std::uint8_t* data, std::size_t size);
+
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef CGENERATOR_HPP
+#define CGENERATOR_HPP
+
+#include "lib.hpp"
+#include "ByteCode.hpp"
+
+namespace compiler {
+
+// translates a compiled file to C source for the interface in flang_aot.h,
+// linked against the flang runtime library it becomes a native executable
+class CGenerator {
+private:
+
+public:
+
+  void generate(const bytecode::CompiledFile& file, std::ostream & out) noexcept;
+
+};
+
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef COMPILE_QUEUE_HPP
+#define COMPILE_QUEUE_HPP
+
+#include "lib.hpp"
+#include "Jit.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace jit {
+
+// output of one compilation, entries are only filled in by the optimizing tier
+struct CompileResult {
+  std::unique_ptr<NativeCode> code;
+  std::vector<bool> entries;
+};
+
+// key identifies the function to whoever submitted the task
+struct CompileTask {
+  std::size_t key;
+  bool isOptimizing;
+  std::function<CompileResult()> compile;
+  std::chrono::steady_clock::time_point submittedAt;
+  CompileResult result;
+};
+
+// install time runs from submitting a task until its code is taken at a safe point
+struct CompileStatistics {
+  std::size_t submitted;
+  std::size_t installed;
+  std::size_t peakQueueLength;
+  std::chrono::nanoseconds totalInstallTime;
+  std::chrono::nanoseconds maxInstallTime;
+};
+
+// runs compilations on a background thread so the interpreter keeps going in
+// the meantime. finished code waits until the interpreter reaches a safe point
+// and takes it, compile functions must not touch anything the interpreter
+// mutates
+class CompileQueue {
+private:
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::deque<CompileTask> pending;
+  std::vector<CompileTask> finished;
+  std::atomic<bool> hasFinishedTasks;
+  bool isStopping;
+  CompileStatistics statistics;
+  std::thread worker;
+
+public:
+  explicit CompileQueue();
+
+  CompileQueue(const CompileQueue&) = delete;
+
+  CompileQueue& operator=(const CompileQueue&) = delete;
+
+  // waits for the task being compiled, anything still queued is dropped
+  virtual ~CompileQueue() noexcept;
+
+  void submit(std::size_t key, bool isOptimizing, std::function<CompileResult()> compile);
+
+  // a relaxed load, cheap enough to check on every instruction
+  bool hasFinished() const noexcept {
+    return this->hasFinishedTasks.load(std::memory_order_relaxed);
+  }
+
+  // hands over every finished task and counts it as installed
+  std::vector<CompileTask> takeFinished();
+
+  std::size_t queueLength();
+
+  CompileStatistics getStatistics();
+
+private:
+  void work();
+};
+
+};
+
+#endif
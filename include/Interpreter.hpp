@@ -10,23 +10,74 @@
 #include "Parser.hpp"
 #include "SemanticAnalyzer.hpp"
 #include "AstCompiler.hpp"
+#include "PassManager.hpp"
+#include "Ir.hpp"
+#include "CGenerator.hpp"
+#include "ByteCodeFile.hpp"
 #include "Runtime.hpp"
 
 namespace interpreter {
 
+class Options {
+public:
+  // translate bytecode functions to native code when they are first run
+  bool isJitEnabled = false;
+  jit::Backend jitBackend = jit::Backend::Template;
+  // print the compile queue counters once the script has finished
+  bool isJitStatisticsEnabled = false;
+  // type feedback and hotness are preloaded from this file and written back at exit
+  std::optional<std::string> profilePath = std::nullopt;
+  // compiled scripts are kept here keyed by a hash of their source, a hit
+  // skips the frontend entirely
+  std::optional<std::string> cacheDirectory = std::nullopt;
+  // the script stops at snapshot() after writing its state to this file
+  std::optional<std::string> snapshotPath = std::nullopt;
+  // picks which passes run over the compiled bytecode
+  compiler::OptimizationLevel optimizationLevel = compiler::OptimizationLevel::O1;
+  // print how long every pass took once the script is compiled
+  bool isPassTimingEnabled = false;
+  // largest function, in instructions, inlined into its callers at -O2
+  std::size_t inlineBudget = compiler::defaultInlineBudget;
+};
+
 class Interpreter {
 private:
   std::ostream & out;
   std::istream & in;
+  const Options options;
+
+  void RunCompiledFile(
+    std::shared_ptr<bytecode::CompiledFile> compiledFile,
+    std::optional<std::string> snapshotState = std::nullopt);
+
+  std::shared_ptr<bytecode::CompiledFile> Compile(const std::string & data);
+
+  std::shared_ptr<bytecode::CompiledFile> CompileCached(const std::string & data);
 
 public:
 
-  explicit Interpreter(std::ostream & out, std::istream & in) noexcept
+  explicit Interpreter(std::ostream & out, std::istream & in, Options options) noexcept
   : out{out}
   , in{in}
+  , options{options}
   {}
 
   void Run(const std::string & data);
+
+  // runs a file written by CompileToByteCode, skipping the frontend entirely
+  void RunByteCode(const std::string & path);
+
+  // continues a script from the snapshot() it was stopped at
+  void RunSnapshot(const std::string & path);
+
+  // writes the compiled script in the binary bytecode format
+  void CompileToByteCode(const std::string & data, std::ostream & out);
+
+  // writes C source that runs the script when linked with the runtime library
+  void CompileToC(const std::string & data, std::ostream & c);
+
+  // prints the SSA form of every function after the selected passes have run
+  void DumpIr(const std::string & data, std::ostream & ir);
 };
 
 };
@@ -0,0 +1,163 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include "lib.hpp"
+#include "ByteCode.hpp"
+#include "PassManager.hpp"
+
+namespace ir {
+
+using ValueId = std::size_t;
+using BlockId = std::size_t;
+
+enum class InstructionKind {
+  // value of an argument on entry
+  Parameter,
+  // operands follow the predecessor order of the block
+  Phi,
+  // one bytecode instruction, operands in the order they were pushed
+  Operation,
+  // taken out by a pass, ids are never reused
+  Removed,
+};
+
+class Instruction {
+public:
+  InstructionKind kind;
+  bytecode::ByteCodeInstruction op;
+  // bytecode parameter, or the argument index of a Parameter
+  std::size_t parameter;
+  std::vector<ValueId> operands;
+  bool hasResult;
+  BlockId block;
+};
+
+enum class TerminatorKind {
+  Jump,
+  // falls to successors[0] and jumps to successors[1] when value is false, like JumpIfFalse
+  Branch,
+  Return,
+  Halt,
+};
+
+class Terminator {
+public:
+  TerminatorKind kind;
+  std::optional<ValueId> value;
+  std::vector<BlockId> successors;
+};
+
+class Block {
+public:
+  // phis come first
+  std::vector<ValueId> instructions;
+  Terminator terminator;
+  std::vector<BlockId> predecessors;
+};
+
+// SSA form of one bytecode function. locals a nested function reads stay in
+// their slots and are accessed with LoadLocal and SetLocal operations, every
+// other local and the op stack are turned into values. block 0 is the entry
+// and holds nothing but the initial values of the locals
+class Function {
+public:
+  std::size_t argumentCount;
+  std::size_t localsCount;
+  std::vector<bytecode::ClosureContext> closures;
+  std::vector<bool> isCaptured;
+  // script scope, its variables are globals
+  bool isEntrypoint;
+  std::vector<Instruction> values;
+  std::vector<Block> blocks;
+
+  ValueId add(BlockId block, Instruction instruction);
+
+  ValueId insert(BlockId block, std::size_t index, Instruction instruction);
+
+  void remove(ValueId value);
+
+  void replaceAllUses(ValueId from, ValueId to);
+
+  // where the edge leaving block through its successor-th successor sits in
+  // the predecessors of the block it enters, and so in the operands of its phis
+  std::size_t predecessorIndex(BlockId block, std::size_t successor) const;
+
+  // drops the edge along with the phi operands it carried
+  void removeEdge(BlockId block, std::size_t successor);
+
+  // renumbers the blocks into the given order, blocks left out must have no
+  // edges into the ones that stay, their instructions are removed
+  void reorder(const std::vector<BlockId>& order);
+
+  // blocks reachable from block 0, each after all of its forward predecessors
+  std::vector<BlockId> reversePostOrder() const;
+
+  // idom[block] is the closest block every path from block 0 to block passes
+  // through, block 0 and unreachable blocks are their own
+  std::vector<BlockId> immediateDominators() const;
+
+  static bool dominates(const std::vector<BlockId>& idom, BlockId a, BlockId b);
+
+  // phi operands and terminators count as uses
+  std::vector<std::size_t> useCounts() const;
+};
+
+// state an instruction reads or writes besides its operands and result
+enum class Memory {
+  None,
+  Global,
+  // locals of the running frame, kept in slots because a closure reads them
+  Local,
+  // locals of the frames a function closes over
+  Closure,
+  // object properties
+  Object,
+  Everything,
+};
+
+// what running an instruction does beyond computing its result, builtins
+// never fail so an instruction without effects can be moved or dropped freely
+class Effects {
+public:
+  Memory reads;
+  Memory writes;
+  // output, input, control flow or anything else that has to happen in order
+  bool isObservable;
+  // makes a new object or function every time it runs
+  bool allocates;
+
+  // true when write can change what read loads, globals and locals are told
+  // apart by their slot
+  static bool clobbers(const Instruction& write, const Instruction& read);
+};
+
+Effects effectsOf(bytecode::ByteCodeInstruction op);
+
+// true for instructions that have to run even when their result is unused
+bool hasSideEffects(bytecode::ByteCodeInstruction op);
+
+// locals of every function that nested functions read, in forEachFunction order
+std::vector<std::vector<bool>> capturedLocals(const compiler::Program& program);
+
+// nullopt for bytecode the builder does not understand, such as a jump out of
+// the function or paths that disagree on the op stack depth
+std::optional<Function> build(
+  const compiler::FunctionBody& fn,
+  const compiler::Program& program,
+  std::vector<bool> isCaptured);
+
+// values used once right where the stack has them stay on the op stack, the
+// rest get a local slot of their own. constants are loaded again at every use
+bytecode::Function lower(const Function& fn);
+
+void dump(const Function& fn, std::ostream & os);
+
+void dump(const compiler::Program& program, std::ostream & os);
+
+// runs transform on the IR of every function and lowers the ones it changed
+// back to bytecode, functions the builder rejects are left alone
+bool transform(compiler::Program& program, const std::function<bool(Function&)>& transform);
+
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "lib.hpp"
+
+#include <cstdint>
+
+namespace jit {
+
+// true when this build can emit and execute x86-64 machine code
+bool isSupported() noexcept;
+
+// true when this build was linked against LLVM
+bool isLlvmSupported() noexcept;
+
+// which compiler turns hot functions into native code
+enum class Backend {
+  // the template and speculative tiers built on Assembler
+  Template,
+  // a single optimizing tier built on LLVM ORC
+  Llvm,
+};
+
+enum class Register : std::uint8_t {
+  rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+  r8, r9, r10, r11, r12, r13, r14, r15,
+};
+
+enum class Condition : std::uint8_t {
+  Equal = 0x4,
+  NotEqual = 0x5,
+  Less = 0xC,
+  GreaterOrEqual = 0xD,
+  LessOrEqual = 0xE,
+  Greater = 0xF,
+};
+
+Condition negate(Condition condition) noexcept;
+
+// native code for one bytecode function, it can be entered at the start of
+// any of its entry labels
+class NativeCode {
+public:
+  virtual ~NativeCode() noexcept = default;
+
+  // runs until the generated code returns control to the interpreter, the
+  // arguments end up in the registers described by Assembler::prologue
+  virtual void enter(std::size_t label, void* context, void* arg1, void* arg2, void* arg3) const = 0;
+};
+
+// output of Assembler living in executable memory
+class AssembledCode : public NativeCode {
+private:
+  void* memory;
+  std::size_t size;
+  std::vector<std::size_t> offsets;
+
+public:
+  explicit AssembledCode(void* memory, std::size_t size, std::vector<std::size_t> offsets) noexcept
+  : memory{memory}
+  , size{size}
+  , offsets{std::move(offsets)}
+  {}
+
+  AssembledCode(const AssembledCode&) = delete;
+
+  AssembledCode& operator=(const AssembledCode&) = delete;
+
+  ~AssembledCode() noexcept override;
+
+  void enter(std::size_t label, void* context, void* arg1, void* arg2, void* arg3) const override;
+
+  std::size_t codeSize() const noexcept {
+    return this->size;
+  }
+};
+
+// emits x86-64 machine code. labels 0 to labelCount - 1 are the entry points
+// of the generated function, further labels can be created for internal use
+//
+// generated code is entered through prologue, which keeps the context in rbx,
+// arg1 to arg3 in r12 to r14 and reserves spill space below rbp
+class Assembler {
+private:
+  std::vector<std::uint8_t> code;
+  std::vector<std::size_t> labels;
+  std::size_t entryLabelCount;
+  std::vector<std::pair<std::size_t, std::size_t>> labelFixups;
+
+public:
+  explicit Assembler(std::size_t entryLabelCount) noexcept;
+
+  virtual ~Assembler() noexcept = default;
+
+  void prologue(std::int32_t spillBytes);
+
+  // restores the registers saved by prologue and returns to the caller of enter
+  void exit();
+
+  std::size_t createLabel();
+
+  void bind(std::size_t label);
+
+  // calls helper(context), any arguments past the first must already be set
+  void call(std::uintptr_t helper);
+
+  // calls helper(context) and jumps to label when it returns true
+  void callAndBranch(std::uintptr_t helper, std::size_t label);
+
+  void jump(std::size_t label);
+
+  void jumpIf(Condition condition, std::size_t label);
+
+  // mov dst, src
+  void move(Register dst, Register src);
+
+  // mov dst, imm64
+  void moveImmediate(Register dst, std::uint64_t value);
+
+  // mov dst, qword [base + disp]
+  void load(Register dst, Register base, std::int32_t disp);
+
+  // mov qword [base + disp], src
+  void store(Register base, std::int32_t disp, Register src);
+
+  // mov dword [base + disp], imm32
+  void storeImmediate32(Register base, std::int32_t disp, std::int32_t value);
+
+  // lea dst, [base + disp]
+  void loadAddress(Register dst, Register base, std::int32_t disp);
+
+  // cmp dword [base + disp], imm32
+  void compareImmediate32(Register base, std::int32_t disp, std::int32_t value);
+
+  // cmp byte [base + disp], imm8
+  void compareImmediate8(Register base, std::int32_t disp, std::int8_t value);
+
+  // cmp dst, imm32
+  void compareImmediate(Register dst, std::int32_t value);
+
+  // dst op= src
+  void add(Register dst, Register src);
+
+  void subtract(Register dst, Register src);
+
+  void multiply(Register dst, Register src);
+
+  void compare(Register dst, Register src);
+
+  void test(Register dst, Register src);
+
+  // rax = rax / src, clobbers rdx
+  void divide(Register src);
+
+  // dst = condition ? 1 : 0 using the flags of the last comparison, dst must be rax to rbx
+  void setIf(Condition condition, Register dst);
+
+  // copies the code into executable memory, nullptr when that is not possible
+  std::unique_ptr<NativeCode> finalize();
+
+private:
+  void emitByte(std::uint8_t byte);
+
+  void emitInt32(std::int32_t value);
+
+  void emitUInt64(std::uint64_t value);
+
+  void emitLabelReference(std::size_t label);
+
+  void emitRex(bool wide, Register reg, Register base);
+
+  void emitRegisterOperand(Register reg, Register rm);
+
+  void emitMemoryOperand(Register reg, Register base, std::int32_t disp);
+
+  void emitAlu(std::uint8_t opcode, Register dst, Register src);
+};
+
+};
+
+#endif
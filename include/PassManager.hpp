@@ -0,0 +1,140 @@
+#ifndef PASS_MANAGER_HPP
+#define PASS_MANAGER_HPP
+
+#include "lib.hpp"
+#include "ByteCode.hpp"
+
+#include <chrono>
+#include <functional>
+
+namespace compiler {
+
+enum class OptimizationLevel {
+  O0,
+  O1,
+  O2,
+};
+
+// callees of at most this many instructions are inlined at -O2
+constexpr std::size_t defaultInlineBudget = 40;
+
+// mutable copy of a bytecode::Function for passes to rewrite in place
+class FunctionBody {
+public:
+  std::size_t argumentCount;
+  std::size_t localsCount;
+  std::vector<bytecode::ClosureContext> closures;
+  std::vector<bytecode::ByteCode> byteCode;
+
+  explicit FunctionBody(const bytecode::Function& fn) noexcept;
+
+  bytecode::Function toFunction() const noexcept;
+};
+
+// mutable copy of a compiled file, functions keep their indices so MakeFn and
+// CallKnown parameters stay valid across passes
+class Program {
+public:
+  FunctionBody entrypoint;
+  std::size_t globalsCount;
+  std::vector<FunctionBody> functions;
+  std::vector<bytecode::ObjectConstructor> objects;
+  std::vector<std::int64_t> intConstants;
+  std::vector<double> floatConstants;
+  std::vector<std::string> stringConstants;
+
+  explicit Program(const bytecode::CompiledFile& file) noexcept;
+
+  std::shared_ptr<bytecode::CompiledFile> toCompiledFile() const noexcept;
+
+  // index of the value in its pool, added to the end when it is not there yet
+  std::size_t intConstant(std::int64_t value);
+  std::size_t floatConstant(double value);
+  std::size_t stringConstant(const std::string& value);
+
+  // the entrypoint first, then every function in index order
+  void forEachFunction(const std::function<void(FunctionBody&)>& visit);
+};
+
+// drops the marked instructions, jumps to a dropped instruction land on the
+// next instruction that is kept
+void removeInstructions(FunctionBody& fn, const std::vector<bool>& isRemoved) noexcept;
+
+// a pass returns true when it changed the program
+class Pass {
+public:
+  std::string name;
+  OptimizationLevel minimumLevel;
+  std::function<bool(Program&)> run;
+};
+
+class PassTiming {
+public:
+  std::string name;
+  std::chrono::nanoseconds time;
+  bool changed;
+};
+
+// runs every registered pass whose minimum level is at or below the selected
+// level, in registration order
+class PassManager {
+private:
+  OptimizationLevel level;
+  std::vector<Pass> passes;
+  std::vector<PassTiming> timings;
+
+public:
+  explicit PassManager(OptimizationLevel level) noexcept
+  : level{level}
+  {}
+
+  void add(Pass pass);
+
+  std::shared_ptr<bytecode::CompiledFile> run(std::shared_ptr<bytecode::CompiledFile> file);
+
+  const std::vector<PassTiming>& getTimings() const noexcept {
+    return this->timings;
+  }
+
+  void printTimings(std::ostream & os) const;
+
+  // the standard pipeline for a level
+  static PassManager withDefaultPasses(OptimizationLevel level, std::size_t inlineBudget = defaultInlineBudget);
+};
+
+// passes, see PassManager.cpp for the order they run in
+
+// removes instructions no path from the function start reaches
+bool eliminateUnreachableCode(Program& program);
+
+// replaces CallKnown of small functions that can not reach themselves and
+// whose frame no closure reads with the body of the function
+bool inlineFunctions(Program& program, std::size_t budget);
+
+// objects only ever read through constant keys, length or type never escape,
+// those reads become the values the object was built from and MakeObj goes
+bool replaceObjects(Program& program);
+
+// evaluates builtins whose operands are constants, including locals and script
+// globals that only ever hold one constant, and stores the results in the pools
+bool foldConstants(Program& program);
+
+// reuses a value computed earlier on every path instead of computing it
+// again, memory reads only until a store or call may have changed them
+bool numberValues(Program& program);
+
+// moves computations whose operands do not change inside a loop and whose
+// effects allow it to the block before the loop
+bool hoistLoopInvariants(Program& program);
+
+// folds branches on constants, threads jumps through empty blocks, merges
+// straight-line blocks and lays blocks out so jumps fall through
+bool simplifyControlFlow(Program& program);
+
+// removes values nothing reads that have no side effects, stores to globals
+// that are never loaded, and shrinks frames to the locals still in use
+bool eliminateDeadCode(Program& program);
+
+};
+
+#endif
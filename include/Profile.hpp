@@ -0,0 +1,51 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "lib.hpp"
+
+#include <cstdint>
+
+namespace runtime {
+
+// operand types seen by a binary arithmetic or comparison instruction,
+// only ever moves from None towards Polymorphic
+enum class OperandFeedback : std::uint8_t {
+  None,
+  Integer,
+  Float,
+  Polymorphic,
+};
+
+// the callee an Invoke has seen, an index into the compiled file's functions
+// until a second callee shows up. only ever moves from noCallTarget towards
+// polymorphicCallTarget
+using CallTarget = std::uint32_t;
+
+constexpr CallTarget noCallTarget = 0xffffffff;
+constexpr CallTarget polymorphicCallTarget = 0xfffffffe;
+
+// what one run learned about a function, feedback and callTargets hold one
+// entry per instruction
+struct FunctionProfile {
+  std::uint32_t entryCount;
+  std::uint32_t backEdgeCount;
+  std::vector<OperandFeedback> feedback;
+  std::vector<CallTarget> callTargets;
+};
+
+// written when a script finishes or panics and preloaded by the next run of the same
+// compiled file, so short lived scripts start out warm. functions are indexed
+// like the compiled file's functions followed by the entrypoint
+struct Profile {
+  std::uint64_t fileHash;
+  std::vector<FunctionProfile> functions;
+};
+
+// nullopt when the input is not a profile this version wrote
+std::optional<Profile> readProfile(std::istream & in);
+
+void writeProfile(std::ostream & out, const Profile& profile);
+
+}
+
+#endif
@@ -3,20 +3,96 @@
 
 #include "lib.hpp"
 #include "ByteCode.hpp"
+#include "Jit.hpp"
+#include "CompileQueue.hpp"
+#include "Profile.hpp"
 
 namespace runtime {
 
 struct StackFrame;
 
-struct Variable;
+struct Object;
 
-struct ClosureContext;
+class VirtualMachine;
 
-struct Function;
+enum class VariableType {
+  Undefined,
+  Integer,
+  Boolean,
+  Float,
+  String,
+  Object,
+  Function,
+};
 
-struct Object;
+// a function is compiled to native code once either counter reaches its threshold
+constexpr std::uint32_t hotEntryThreshold = 32;
+constexpr std::uint32_t hotBackEdgeThreshold = 32;
+
+// and recompiled by the optimizing tier once it has stayed hot for longer
+constexpr std::uint32_t optimizeEntryThreshold = 256;
+constexpr std::uint32_t optimizeBackEdgeThreshold = 256;
+
+// per VM copy of a bytecode function which the interpreter rewrites in place
+struct CodeBlock {
+  const bytecode::Function* fn;
+  std::vector<bytecode::ByteCode> byteCode;
+  std::vector<OperandFeedback> feedback;
+  // callee of every Invoke, noCallTarget everywhere else
+  std::vector<CallTarget> callTargets;
+  // generated once the JIT has compiled this function, it can only be
+  // entered where isNativeEntry is set and is recompiled once stale
+  std::unique_ptr<jit::NativeCode> native;
+  std::vector<bool> isNativeEntry;
+  bool isNativeUnavailable;
+  bool isNativeStale;
+  // hotness, calls into the function and jumps backwards within it
+  std::uint32_t entryCount;
+  std::uint32_t backEdgeCount;
+  // speculative code from the optimizing tier, it can only be entered where
+  // isOptimizedEntry is set and is thrown away for good after a deopt
+  std::unique_ptr<jit::NativeCode> optimized;
+  std::vector<bool> isOptimizedEntry;
+  bool isOptimizedUnavailable;
+  bool isDeoptimized;
+};
 
-class VirtualMachine;
+struct ClosureContext {
+  const StackFrame* stackFrame;
+  std::size_t scopeIndex;
+};
+
+struct Function {
+  std::vector<runtime::ClosureContext> captures;
+  std::shared_ptr<StackFrame> scopeOuter;
+  const bytecode::Function* fn;
+  CodeBlock* code;
+};
+
+struct Variable {
+  VariableType type;
+
+  union {
+    std::int64_t integerValue;
+    double doubleValue;
+    bool boolValue;
+    Object* objectValue;
+    Function* functionValue;
+    const std::string* stringValue;
+  };
+};
+
+struct Object {
+  std::unordered_map<std::string, Variable> properties;
+};
+
+struct StackFrame {
+  std::size_t programCounter;
+  std::vector<Variable> locals;
+  const runtime::Function* function;
+  std::shared_ptr<StackFrame> outer;
+  std::vector<Variable> opStack;
+};
 
 class Heap {
 private:
@@ -42,38 +118,129 @@ public:
 
 };
 
+// a script stopped at snapshot(), state is only meaningful to a VM running file
+struct SnapshotFile {
+  std::shared_ptr<bytecode::CompiledFile> file;
+  std::string state;
+};
+
+// nullopt unless data is a snapshot written by this version
+std::optional<SnapshotFile> readSnapshot(const std::string & data);
+
 class VirtualMachine {
 private:
   const std::shared_ptr<const bytecode::CompiledFile> file;
   std::shared_ptr<StackFrame> stackFrame;
 
+  // script scope variables, indexed by LoadGlobal and SetGlobal
+  std::vector<Variable> globals;
+
+  // one per function followed by the entrypoint
+  std::vector<CodeBlock> codeBlocks;
+
+  // capture free instances used as the callee of CallKnown, created on first call
+  std::vector<runtime::Function*> knownFunctions;
+
   Heap heap;
 
   std::ostream & out;
   std::istream & in;
   bool isPanicing;
   bool isDebug;
+  bool isJitEnabled;
+  jit::Backend backend;
+
+  // compiles hot functions off the interpreter thread, only set when the JIT is enabled
+  std::unique_ptr<jit::CompileQueue> compileQueue;
+
+public:
+  // a function compiled ahead of time, it resumes at pc and returns once the
+  // current stack frame changes
+  using AotFunction = void (*)(VirtualMachine* vm, std::size_t pc);
+
+private:
+  // one per code block when the script was compiled ahead of time
+  std::vector<AotFunction> aotCode;
+
+  // from an earlier run, applied to the code blocks when run() creates them
+  std::optional<Profile> preloadedProfile;
+
+  // where saveProfile() writes the profile, it is a no-op without one
+  std::optional<std::string> profilePath;
+
+  // snapshot() writes the state here and stops the script, it is a no-op without one
+  std::ostream* snapshotOut;
+  bool isSnapshotWritten;
+
+  // run() resumes from this instead of starting at the entrypoint
+  std::optional<std::string> snapshotState;
 
 public:
   explicit VirtualMachine(
     bool isDebug,
+    bool isJitEnabled,
+    jit::Backend backend,
     std::ostream & out,
     std::istream & in,
     std::shared_ptr<const bytecode::CompiledFile> file
   ) noexcept
   : file{std::move(file)}
   , stackFrame{nullptr}
+  , globals{}
+  , codeBlocks{}
+  , knownFunctions{}
   , heap{this}
   , out{out}
   , in{in}
   , isPanicing{false}
   , isDebug{isDebug}
+  // without LLVM the interpreter runs everything
+  , isJitEnabled{isJitEnabled && !isDebug && (backend == jit::Backend::Llvm ? jit::isLlvmSupported() : jit::isSupported())}
+  , backend{backend}
+  , compileQueue{this->isJitEnabled ? std::make_unique<jit::CompileQueue>() : nullptr}
+  , aotCode{}
+  , preloadedProfile{std::nullopt}
+  , profilePath{std::nullopt}
+  , snapshotOut{nullptr}
+  , isSnapshotWritten{false}
+  , snapshotState{std::nullopt}
   {}
 
   virtual ~VirtualMachine() = default;
 
   void run() noexcept;
 
+  // compile queue counters, nothing is printed when the JIT is disabled
+  void printJitStatistics(std::ostream & os);
+
+  // replaces interpretation with code compiled ahead of time, one function
+  // per bytecode function followed by the entrypoint
+  void setAotCode(std::vector<AotFunction> code);
+
+  // ignored unless it was collected from the same compiled file
+  void setProfile(Profile profile);
+
+  // feedback and hotness of every code block, for the next run to preload
+  Profile collectProfile() const;
+
+  void setProfileOutput(std::string path);
+
+  // writes collectProfile() to the profile output, called once the script
+  // finishes and by panic() so a failing run keeps what it learned
+  void saveProfile();
+
+  void setSnapshotOutput(std::ostream* out);
+
+  bool hasWrittenSnapshot() const;
+
+  // the state of a SnapshotFile whose file this VM was created with
+  void setSnapshot(std::string state);
+
+  // helpers shared by the JIT and code compiled ahead of time
+  static std::uintptr_t nativeHelper(bytecode::ByteCodeInstruction instruction);
+
+  static bool nativeJumpIfFalse(VirtualMachine* vm);
+
 private:
   void pushStackFrame(const runtime::Function* function);
 
@@ -120,10 +287,16 @@ private:
 
   void SetLocal();
 
+  void LoadGlobal();
+
+  void SetGlobal();
+
   void Return();
 
   void Invoke();
 
+  void CallKnown();
+
   void MakeFn();
 
   void MakeObj();
@@ -166,6 +339,51 @@ private:
 
   void Pop();
 
+  // true once the snapshot is written and the script has to stop
+  bool Snapshot();
+
+  void AddIntInt();
+
+  void AddFloatFloat();
+
+  void SubtractIntInt();
+
+  void SubtractFloatFloat();
+
+  void MultiplyIntInt();
+
+  void MultiplyFloatFloat();
+
+  void DivideIntInt();
+
+  void DivideFloatFloat();
+
+  void LessIntInt();
+
+  void LessFloatFloat();
+
+  void LessOrEqualIntInt();
+
+  void LessOrEqualFloatFloat();
+
+  void GreaterIntInt();
+
+  void GreaterFloatFloat();
+
+  void GreaterOrEqualIntInt();
+
+  void GreaterOrEqualFloatFloat();
+
+  void quicken(
+    Variable first,
+    Variable second,
+    bytecode::ByteCodeInstruction integerInstruction,
+    bytecode::ByteCodeInstruction floatInstruction);
+
+  bool quickenedOperands(VariableType type, Variable** first, Variable** second);
+
+  void dequicken(bytecode::ByteCodeInstruction generic);
+
   bool protectDifferentTypes(Variable v1, Variable v2);
 
   void pushUndefined();
@@ -201,6 +419,62 @@ private:
   runtime::ClosureContext loadClosure(const bytecode::ClosureContext& closure);
 
   runtime::Variable loadClosureValue(const runtime::Function* fn, std::size_t index);
+
+  const runtime::Function* knownFunction(std::size_t index);
+
+  // call target feedback of the Invoke at the program counter
+  void recordCallTarget(const runtime::Function* callee);
+
+  static jit::CompileResult compileNative(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode);
+
+  static jit::CompileResult compileOptimized(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode,
+    const std::vector<CallTarget>& callTargets);
+
+  // lowers to LLVM IR and optimizes it, on builds without LLVM there is never a result
+  static jit::CompileResult compileLlvm(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode);
+
+  void applyProfile(const Profile& profile);
+
+  void writeSnapshot(std::ostream & out);
+
+  void restoreSnapshot(const std::string & state);
+
+  void promoteIfHot(CodeBlock* code);
+
+  void submitCompilation(CodeBlock* code, bool isOptimizing);
+
+  void installCompiledCode();
+
+  bool enterNativeCode(CodeBlock* code);
+
+  template<void (VirtualMachine::*handler)()>
+  static void nativeCall(VirtualMachine* vm);
+
+  template<void (VirtualMachine::*quickened)(), void (VirtualMachine::*generic)()>
+  static void nativeCallQuickened(VirtualMachine* vm);
+
+  static bool nativeJump(VirtualMachine* vm);
+
+  static bool changesStackFrame(bytecode::ByteCodeInstruction instruction);
+
+  static bool isInterpreterOnly(bytecode::ByteCodeInstruction instruction);
+
+  static void nativePushOperand(VirtualMachine* vm, const Variable* value);
+
+  static void nativePopOperand(VirtualMachine* vm, Variable* value);
+
+  static void nativeDeoptimize(VirtualMachine* vm);
+
+  static bool nativeInvokeTarget(VirtualMachine* vm, std::size_t target);
 };
 
 }
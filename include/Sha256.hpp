@@ -0,0 +1,18 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include "lib.hpp"
+
+#include <cstdint>
+
+namespace interpreter {
+
+using Sha256Digest = std::array<std::uint8_t, 32>;
+
+// FIPS 180-4 SHA-256, used where two inputs must not be mistaken for each
+// other and a 64 bit hash could collide
+Sha256Digest sha256(const std::string & data);
+
+}
+
+#endif
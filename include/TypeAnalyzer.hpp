@@ -0,0 +1,32 @@
+#ifndef TYPE_ANALYZER_HPP
+#define TYPE_ANALYZER_HPP
+
+#include "lib.hpp"
+#include "Ast.hpp"
+#include "Error.hpp"
+#include "AstWalker.hpp"
+
+// Unknown is only seen while inferring, Any means the type could not be proven
+enum class InferredType {
+  Unknown,
+  Undefined,
+  Integer,
+  Boolean,
+  Float,
+  String,
+  Object,
+  Function,
+  Any,
+};
+
+class TypeAnalyzer {
+public:
+  explicit TypeAnalyzer() noexcept = default;
+
+  virtual ~TypeAnalyzer() = default;
+
+  // expects a script that passed semantic analysis
+  std::unordered_map<const ExpressionAstNode*, InferredType> infer(const std::shared_ptr<ScriptAstNode>& script) noexcept;
+};
+
+#endif // TYPE_ANALYZER_HPP
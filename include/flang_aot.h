@@ -0,0 +1,86 @@
+#ifndef FLANG_AOT_H
+#define FLANG_AOT_H
+
+/*
+ * C interface between scripts compiled ahead of time by `flang --aot` and
+ * the flang runtime library. The generated source describes the compiled
+ * file with the tables below and provides one function per bytecode
+ * function, the runtime calls into those instead of interpreting.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* one past the last bytecode::ByteCodeInstruction */
+#define FLANG_AOT_INSTRUCTION_COUNT 62
+
+typedef struct flang_vm flang_vm;
+
+/* runs the instruction at the program counter of the current frame */
+typedef void (*flang_op)(flang_vm* vm);
+
+/* resumes a function at pc and returns once its stack frame is no longer current */
+typedef void (*flang_aot_function)(flang_vm* vm, size_t pc);
+
+typedef struct {
+  uint32_t instruction;
+  size_t parameter;
+} flang_bytecode;
+
+typedef struct {
+  size_t scopeOffsets;
+  size_t localIndex;
+} flang_closure;
+
+typedef struct {
+  size_t argumentCount;
+  size_t localsCount;
+  const flang_closure* closures;
+  size_t closureCount;
+  const flang_bytecode* byteCode;
+  size_t byteCodeCount;
+} flang_function;
+
+typedef struct {
+  const char* data;
+  size_t size;
+} flang_string;
+
+typedef struct {
+  const flang_string* keys;
+  size_t keyCount;
+} flang_object;
+
+typedef struct {
+  flang_function entrypoint;
+  size_t globalsCount;
+  const flang_function* functions;
+  size_t functionCount;
+  const flang_object* objects;
+  size_t objectCount;
+  const int64_t* intConstants;
+  size_t intConstantCount;
+  const double* floatConstants;
+  size_t floatConstantCount;
+  const flang_string* stringConstants;
+  size_t stringConstantCount;
+} flang_compiled_file;
+
+/* NULL for instructions the generated code handles itself */
+flang_op flang_aot_op(uint32_t instruction);
+
+/* runs JumpIfFalse, non zero when the jump is taken */
+int flang_aot_jump_if_false(flang_vm* vm);
+
+/* code holds one function per entry of file->functions followed by the entrypoint */
+int flang_aot_run(const flang_compiled_file* file, const flang_aot_function* code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -15,5 +15,6 @@
 #include <list>
 #include <unordered_map>
 #include <cstdlib>
+#include <algorithm>
 
 #endif // LIB_HPP
\ No newline at end of file
@@ -0,0 +1,9 @@
+#!/bin/bash -xe
+
+# usage: ./scripts/aot.sh <script.f> <output executable>, needs a build of the flang_runtime target
+script=$1
+output=$2
+
+./build/flang --aot "$output.c" "$script"
+
+cc -O2 -I./include "$output.c" -L./build $(cat ./build/flang_runtime_libraries.txt) -o "$output"
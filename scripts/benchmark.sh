@@ -10,6 +10,9 @@ function run () {
 run "Flang Iterative Fib (50)" "./build/flang ./data/test/performance/iterative_fib.f"
 run "Flang Recursive Fib (50)" "./build/flang ./data/test/performance/recursive_fib.f"
 
+run "Flang JIT Iterative Fib (50)" "./build/flang --jit ./data/test/performance/iterative_fib.f"
+run "Flang JIT Recursive Fib (50)" "./build/flang --jit ./data/test/performance/recursive_fib.f"
+
 run "Python3 Iterative Fib (50)" "python3 ./data/test/performance/iterative_fib.py"
 run "Python3 Recursive Fib (50)" "python3 ./data/test/performance/recursive_fib.py"
 
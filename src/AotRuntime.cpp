@@ -0,0 +1,101 @@
+#include "Runtime.hpp"
+#include "flang_aot.h"
+
+static_assert(
+  static_cast<std::size_t>(bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat) + 1 == FLANG_AOT_INSTRUCTION_COUNT,
+  "FLANG_AOT_INSTRUCTION_COUNT is out of date");
+
+static runtime::VirtualMachine* toVirtualMachine(flang_vm* vm) {
+  return reinterpret_cast<runtime::VirtualMachine*>(vm);
+}
+
+static std::string toString(const flang_string& string) {
+  return std::string{string.data, string.size};
+}
+
+static bytecode::Function toFunction(const flang_function& function) {
+  std::vector<bytecode::ClosureContext> closures;
+  closures.reserve(function.closureCount);
+
+  for (std::size_t i = 0; i < function.closureCount; i++) {
+    closures.emplace_back(function.closures[i].scopeOffsets, function.closures[i].localIndex);
+  }
+
+  std::vector<bytecode::ByteCode> byteCode;
+  byteCode.reserve(function.byteCodeCount);
+
+  for (std::size_t i = 0; i < function.byteCodeCount; i++) {
+    byteCode.emplace_back(
+      static_cast<bytecode::ByteCodeInstruction>(function.byteCode[i].instruction),
+      function.byteCode[i].parameter);
+  }
+
+  return bytecode::Function{function.argumentCount, function.localsCount, std::move(closures), std::move(byteCode)};
+}
+
+static std::shared_ptr<bytecode::CompiledFile> toCompiledFile(const flang_compiled_file& file) {
+  std::vector<bytecode::Function> functions;
+  functions.reserve(file.functionCount);
+
+  for (std::size_t i = 0; i < file.functionCount; i++) {
+    functions.push_back(toFunction(file.functions[i]));
+  }
+
+  std::vector<bytecode::ObjectConstructor> objects;
+  objects.reserve(file.objectCount);
+
+  for (std::size_t i = 0; i < file.objectCount; i++) {
+    std::vector<std::string> keys;
+
+    for (std::size_t j = 0; j < file.objects[i].keyCount; j++) {
+      keys.push_back(toString(file.objects[i].keys[j]));
+    }
+
+    objects.emplace_back(std::move(keys));
+  }
+
+  std::vector<std::string> stringConstants;
+  stringConstants.reserve(file.stringConstantCount);
+
+  for (std::size_t i = 0; i < file.stringConstantCount; i++) {
+    stringConstants.push_back(toString(file.stringConstants[i]));
+  }
+
+  return std::make_shared<bytecode::CompiledFile>(
+    toFunction(file.entrypoint),
+    file.globalsCount,
+    std::move(functions),
+    std::move(objects),
+    std::vector<std::int64_t>{file.intConstants, file.intConstants + file.intConstantCount},
+    std::vector<double>{file.floatConstants, file.floatConstants + file.floatConstantCount},
+    std::move(stringConstants));
+}
+
+extern "C" flang_op flang_aot_op(uint32_t instruction) {
+  if (instruction >= FLANG_AOT_INSTRUCTION_COUNT) {
+    return nullptr;
+  }
+
+  std::uintptr_t helper = runtime::VirtualMachine::nativeHelper(static_cast<bytecode::ByteCodeInstruction>(instruction));
+
+  return reinterpret_cast<flang_op>(helper);
+}
+
+extern "C" int flang_aot_jump_if_false(flang_vm* vm) {
+  return runtime::VirtualMachine::nativeJumpIfFalse(toVirtualMachine(vm)) ? 1 : 0;
+}
+
+extern "C" int flang_aot_run(const flang_compiled_file* file, const flang_aot_function* code) {
+  std::vector<runtime::VirtualMachine::AotFunction> aotCode;
+  aotCode.reserve(file->functionCount + 1);
+
+  for (std::size_t i = 0; i < file->functionCount + 1; i++) {
+    aotCode.push_back(reinterpret_cast<runtime::VirtualMachine::AotFunction>(code[i]));
+  }
+
+  auto vm = std::make_shared<runtime::VirtualMachine>(false, false, jit::Backend::Template, std::cout, std::cin, toCompiledFile(*file));
+  vm->setAotCode(std::move(aotCode));
+  vm->run();
+
+  return 0;
+}
@@ -13,6 +13,26 @@ class VariableDeclaration {
 public:
   std::string value;
   bool isFullyBound;
+  // set when the variable is bound once to a self contained function and never reassigned
+  std::optional<std::size_t> knownFunctionIndex;
+};
+
+class KnownCall {
+public:
+  std::size_t functionIndex;
+  std::size_t argumentCount;
+  bool isSelfCall;
+};
+
+// collects every identifier that is the target of an assign statement, any
+// declaration sharing one of these names is treated as possibly reassigned
+class AssignedIdentifierCollector : public AstWalker {
+public:
+  std::unordered_map<std::string, bool> assigned;
+
+  void onEnterAssignStatementAstNode(AssignStatementAstNode* node) noexcept override {
+    this->assigned[node->identifier->value] = true;
+  }
 };
 
 class EmissionContext {
@@ -32,6 +52,16 @@ public:
   std::vector<std::size_t> ifConditionEvalJumpIndices;
   std::vector<std::size_t> elseStatementStartIndex;
 
+  // true when this function, or a function nested within it, reads a variable
+  // declared outside of this function
+  bool capturesOuterScope = false;
+
+  // name of the declaration this function is being bound to, calls to it from
+  // within the function body are emitted as CallKnown
+  std::optional<std::string> selfBinding;
+  std::size_t selfArgumentCount = 0;
+  std::vector<std::size_t> selfCallIndices;
+
   explicit EmissionContext(
     std::shared_ptr<EmissionContext> outerContext
   ) noexcept
@@ -58,6 +88,7 @@ public:
     VariableDeclaration vd;
     vd.value = var;
     vd.isFullyBound = false;
+    vd.knownFunctionIndex = std::nullopt;
 
     if (this->firstFreeVariablesIndex < this->variables.size()) {
       this->variables.at(this->firstFreeVariablesIndex) = vd;
@@ -110,6 +141,12 @@ public:
 
     std::shared_ptr<compiler::EmissionContext> ec;
 
+    std::unordered_map<std::string, bool> assignedIdentifiers;
+    std::unordered_map<const ExpressionAstNode*, InferredType> expressionTypes;
+    std::unordered_map<FunctionDeclarationExpressionAstNode*, std::size_t> selfContainedFunctions;
+    DeclareStatementAstNode* pendingFunctionDeclaration = nullptr;
+    std::vector<std::optional<KnownCall>> knownCalls;
+
     std::unordered_map<std::string, bytecode::ByteCodeInstruction> builtInFunctionLookup{{
       {"add",            bytecode::ByteCodeInstruction::Add},
       {"subtract",       bytecode::ByteCodeInstruction::Subtract},
@@ -134,18 +171,38 @@ public:
       {"float",          bytecode::ByteCodeInstruction::CastToFloat},
       {"length",         bytecode::ByteCodeInstruction::Length},
       {"charAt",         bytecode::ByteCodeInstruction::ChatAt},
-      {"append",         bytecode::ByteCodeInstruction::StringAppend}
+      {"append",         bytecode::ByteCodeInstruction::StringAppend},
+      {"snapshot",       bytecode::ByteCodeInstruction::Snapshot}
     }};
 
-  explicit CompilerAstWalker() noexcept
+    // built ins with a form for when both operands are proven integers or proven floats
+    std::unordered_map<std::string, std::pair<bytecode::ByteCodeInstruction, bytecode::ByteCodeInstruction>> specializedBuiltInLookup{{
+      {"add",            {bytecode::ByteCodeInstruction::AddIntInt, bytecode::ByteCodeInstruction::AddFloatFloat}},
+      {"subtract",       {bytecode::ByteCodeInstruction::SubtractIntInt, bytecode::ByteCodeInstruction::SubtractFloatFloat}},
+      {"multiply",       {bytecode::ByteCodeInstruction::MultiplyIntInt, bytecode::ByteCodeInstruction::MultiplyFloatFloat}},
+      {"divide",         {bytecode::ByteCodeInstruction::DivideIntInt, bytecode::ByteCodeInstruction::DivideFloatFloat}},
+      {"less",           {bytecode::ByteCodeInstruction::LessIntInt, bytecode::ByteCodeInstruction::LessFloatFloat}},
+      {"lessOrEqual",    {bytecode::ByteCodeInstruction::LessOrEqualIntInt, bytecode::ByteCodeInstruction::LessOrEqualFloatFloat}},
+      {"greater",        {bytecode::ByteCodeInstruction::GreaterIntInt, bytecode::ByteCodeInstruction::GreaterFloatFloat}},
+      {"greaterOrEqual", {bytecode::ByteCodeInstruction::GreaterOrEqualIntInt, bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat}}
+    }};
+
+  explicit CompilerAstWalker(
+    std::unordered_map<std::string, bool> assignedIdentifiers,
+    std::unordered_map<const ExpressionAstNode*, InferredType> expressionTypes
+  ) noexcept
   : ec{std::make_shared<EmissionContext>(nullptr)}
+  , assignedIdentifiers{std::move(assignedIdentifiers)}
+  , expressionTypes{std::move(expressionTypes)}
   {}
 
   virtual ~CompilerAstWalker() noexcept = default;
 
   std::shared_ptr<bytecode::CompiledFile> ConstructCompiledFile() noexcept {
+    // every script scope variable lives in the global slot table
     return std::make_shared<bytecode::CompiledFile>(
-      bytecode::Function{ 0, this->ec->variables.size(), {}, this->ec->byteCode },
+      bytecode::Function{ 0, 0, {}, this->ec->byteCode },
+      this->ec->variables.size(),
       this->functions,
       this->objects,
       this->intConstants,
@@ -233,6 +290,51 @@ public:
     this->onExitIfStatementAstNode(node);
   }
 
+  // and and or only evaluate their right side when the left one does not
+  // decide the result already, either way the result is a boolean
+  void visitBuiltInFunctionInvocationExpressionAstNode(BuiltInFunctionInvocationExpressionAstNode* node) noexcept override {
+    const auto& name = node->identifier->value;
+
+    if ((name != "and" && name != "or") || node->expressions.size() != 2) {
+      AstWalker::visitBuiltInFunctionInvocationExpressionAstNode(node);
+      return;
+    }
+
+    bool isAnd = name == "and";
+    std::vector<std::size_t> toFalse;
+    std::vector<std::size_t> toEnd;
+
+    this->visitExpressionAstNode(node->expressions.at(0).get());
+    std::size_t leftJumpIndex = this->ec->byteCode.size();
+    this->emit(bytecode::ByteCodeInstruction::JumpIfFalse);
+
+    if (isAnd) {
+      toFalse.push_back(leftJumpIndex);
+    } else {
+      this->emit(bytecode::ByteCodeInstruction::LoadBooleanTrueConstant);
+      toEnd.push_back(this->ec->byteCode.size());
+      this->emit(bytecode::ByteCodeInstruction::Jump);
+      this->ec->UpdateParameterAtIndex(leftJumpIndex, this->ec->byteCode.size());
+    }
+
+    this->visitExpressionAstNode(node->expressions.at(1).get());
+    toFalse.push_back(this->ec->byteCode.size());
+    this->emit(bytecode::ByteCodeInstruction::JumpIfFalse);
+    this->emit(bytecode::ByteCodeInstruction::LoadBooleanTrueConstant);
+    toEnd.push_back(this->ec->byteCode.size());
+    this->emit(bytecode::ByteCodeInstruction::Jump);
+
+    for (auto index : toFalse) {
+      this->ec->UpdateParameterAtIndex(index, this->ec->byteCode.size());
+    }
+
+    this->emit(bytecode::ByteCodeInstruction::LoadBooleanFalseConstant);
+
+    for (auto index : toEnd) {
+      this->ec->UpdateParameterAtIndex(index, this->ec->byteCode.size());
+    }
+  }
+
   void onEnterBlockStatementAstNode(BlockStatementAstNode*  /*node*/) noexcept override {
     this->ec->PushScope();
   }
@@ -283,11 +385,31 @@ public:
     }
   }
 
+  bool isScriptScope(const std::shared_ptr<EmissionContext>& ec) noexcept {
+    return ec->outerContext == nullptr;
+  }
+
+  void emitLoadSlot(std::size_t index) noexcept {
+    if (this->isScriptScope(this->ec)) {
+      this->emit(bytecode::ByteCodeInstruction::LoadGlobal, index);
+    } else {
+      this->emit(bytecode::ByteCodeInstruction::LoadLocal, index);
+    }
+  }
+
+  void emitSetSlot(std::size_t index) noexcept {
+    if (this->isScriptScope(this->ec)) {
+      this->emit(bytecode::ByteCodeInstruction::SetGlobal, index);
+    } else {
+      this->emit(bytecode::ByteCodeInstruction::SetLocal, index);
+    }
+  }
+
   void loadVariable(const std::string& str) noexcept {
     std::size_t index;
     if (this->ec->GetDeclarationIndex(str, index, false)) {
-      // it's a local
-      this->emit(bytecode::ByteCodeInstruction::LoadLocal, index);
+      // it's a local, or a global when compiling script scope
+      this->emitLoadSlot(index);
     } else {
       // it's a closure
       std::size_t i = 0;
@@ -306,12 +428,19 @@ public:
         Error::assertWithPanic(ec != nullptr, "Emission context was nullptr when we expected one in resolving closure");
         std::size_t index;
         if (ec->GetDeclarationIndex(str, index, true)) {
+          if (this->isScriptScope(ec)) {
+            // globals are read directly, there is nothing to capture
+            this->emit(bytecode::ByteCodeInstruction::LoadGlobal, index);
+            return;
+          }
+
           ClosureContext cc;
           cc.value = str;
           cc.outerScopeCount = localOffsets;
           cc.localScopeIndex = index;
           std::size_t closureIndex = this->ec->closures.size();
           this->ec->closures.push_back(cc);
+          this->markCapturesOuterScope(localOffsets);
           this->emit(bytecode::ByteCodeInstruction::LoadClosure, closureIndex);
           return;
         }
@@ -321,17 +450,77 @@ public:
     }
   }
 
+  // the current function and every function between it and the scope a
+  // closure resolves to now depend on their outer scope
+  void markCapturesOuterScope(std::size_t localOffsets) noexcept {
+    auto ec = this->ec;
+    for (std::size_t i = 0; i < localOffsets && ec != nullptr; i++) {
+      ec->capturesOuterScope = true;
+      ec = ec->outerContext;
+    }
+  }
+
+  bool isReassigned(const std::string& str) noexcept {
+    return this->assignedIdentifiers.find(str) != this->assignedIdentifiers.end();
+  }
+
+  // resolves str the same way loadVariable does and returns a KnownCall if it
+  // names a function that can be invoked without loading it
+  std::optional<KnownCall> resolveKnownCall(const std::string& str) noexcept {
+    std::size_t index;
+    if (this->ec->GetDeclarationIndex(str, index, false)) {
+      const auto& vd = this->ec->variables.at(index);
+      if (!vd.knownFunctionIndex) {
+        return std::nullopt;
+      }
+      std::size_t fnIndex = vd.knownFunctionIndex.value();
+      return KnownCall{fnIndex, this->functions.at(fnIndex).argumentCount, false};
+    }
+
+    if (this->ec->selfBinding && this->ec->selfBinding.value() == str) {
+      return KnownCall{0, this->ec->selfArgumentCount, true};
+    }
+
+    auto ec = this->ec->outerContext;
+
+    while (ec != nullptr) {
+      if (ec->GetDeclarationIndex(str, index, true)) {
+        const auto& vd = ec->variables.at(index);
+        if (!vd.knownFunctionIndex) {
+          return std::nullopt;
+        }
+        std::size_t fnIndex = vd.knownFunctionIndex.value();
+        return KnownCall{fnIndex, this->functions.at(fnIndex).argumentCount, false};
+      }
+      ec = ec->outerContext;
+    }
+
+    return std::nullopt;
+  }
+
   void onEnterIdentifierExpressionAstNode(IdentifierExpressionAstNode* node) noexcept override {
     this->loadVariable(node->token->value);
   }
 
   void onEnterFunctionInvocationExpressionAstNode(FunctionInvocationExpressionAstNode* node) noexcept override {
-    this->loadVariable(node->identifier->value);
+    auto knownCall = this->resolveKnownCall(node->identifier->value);
+    this->knownCalls.push_back(knownCall);
+
+    if (!knownCall) {
+      this->loadVariable(node->identifier->value);
+    }
   }
 
   void onEnterFunctionDeclarationExpressionAstNode(FunctionDeclarationExpressionAstNode* node) noexcept override {
     auto ec = std::make_shared<compiler::EmissionContext>(this->ec);
 
+    auto pending = this->pendingFunctionDeclaration;
+    if (pending != nullptr && pending->expression.get() == node) {
+      ec->selfBinding = pending->identifier->value;
+      ec->selfArgumentCount = node->parameters.size();
+    }
+    this->pendingFunctionDeclaration = nullptr;
+
     for (const auto& var : node->parameters) {
       ec->Declare(var->value);
       // immediately fully bind all parameters as are never half-declared
@@ -348,21 +537,33 @@ public:
 
   void onEnterDeclareStatementAstNode(DeclareStatementAstNode* node) noexcept override {
     this->ec->Declare(node->identifier->value);
+
+    if (!this->isReassigned(node->identifier->value)) {
+      this->pendingFunctionDeclaration = node;
+    }
   }
 
   void onExitDeclareStatementAstNode(DeclareStatementAstNode* node) noexcept override {
-    std::size_t index;
+    std::size_t index = 0;
     bool find = this->ec->GetDeclarationIndex(node->identifier->value, index, true);
     Error::assertWithPanic(find, "Could not find local declaration for declare statement");
     this->ec->FullyBind(index);
-    this->emit(bytecode::ByteCodeInstruction::SetLocal, index);
+
+    auto fnDefine = dynamic_cast<FunctionDeclarationExpressionAstNode*>(node->expression.get());
+    if (fnDefine != nullptr && !this->isReassigned(node->identifier->value)) {
+      auto selfContained = this->selfContainedFunctions.find(fnDefine);
+      if (selfContained != this->selfContainedFunctions.end()) {
+        this->ec->variables.at(index).knownFunctionIndex = selfContained->second;
+      }
+    }
+    this->emitSetSlot(index);
   }
 
   void onExitAssignStatementAstNode(AssignStatementAstNode* node) noexcept override {
-    std::size_t index;
+    std::size_t index = 0;
     bool find = this->ec->GetDeclarationIndex(node->identifier->value, index, false);
     Error::assertWithPanic(find, "Could not find local declaration for assign statement");
-    this->emit(bytecode::ByteCodeInstruction::SetLocal, index);
+    this->emitSetSlot(index);
   }
 
   void onExitIfStatementAstNode(IfStatementAstNode* node) noexcept override {
@@ -440,7 +641,32 @@ public:
   }
 
   void onExitFunctionInvocationExpressionAstNode(FunctionInvocationExpressionAstNode* node) noexcept override {
-    this->emit(bytecode::ByteCodeInstruction::Invoke, node->expressions.size());
+    Error::assertWithPanic(!this->knownCalls.empty(),
+      "onExitFunctionInvocationExpressionAstNode encountered invocation exit but knownCalls is empty");
+
+    auto knownCall = this->knownCalls.at(this->knownCalls.size() - 1);
+    this->knownCalls.pop_back();
+
+    if (!knownCall) {
+      this->emit(bytecode::ByteCodeInstruction::Invoke, node->expressions.size());
+      return;
+    }
+
+    // match the callee's parameter count here so the runtime can copy arguments unchecked
+    for (std::size_t i = knownCall->argumentCount; i < node->expressions.size(); i++) {
+      this->emit(bytecode::ByteCodeInstruction::Pop);
+    }
+
+    for (std::size_t i = node->expressions.size(); i < knownCall->argumentCount; i++) {
+      this->emit(bytecode::ByteCodeInstruction::LoadUndefinedConstant);
+    }
+
+    if (knownCall->isSelfCall) {
+      // the function index is only known once the body is compiled
+      this->ec->selfCallIndices.push_back(this->ec->byteCode.size());
+    }
+
+    this->emit(bytecode::ByteCodeInstruction::CallKnown, knownCall->functionIndex);
   }
 
   void onExitBuiltInFunctionInvocationExpressionAstNode(BuiltInFunctionInvocationExpressionAstNode* node) noexcept override {
@@ -450,7 +676,42 @@ public:
       find != this->builtInFunctionLookup.end(),
       "onExitBuiltInFunctionInvocationExpressionAstNode found a built in function it does not know about");
 
-    this->emit(find->second);
+    this->emit(this->specializeBuiltIn(node, find->second));
+  }
+
+  InferredType inferredTypeOf(const std::shared_ptr<ExpressionAstNode>& expression) noexcept {
+    auto find = this->expressionTypes.find(expression.get());
+
+    if (find == this->expressionTypes.end()) {
+      return InferredType::Any;
+    }
+
+    return find->second;
+  }
+
+  // picks the quickened form up front when type inference proved both operands
+  bytecode::ByteCodeInstruction specializeBuiltIn(
+    BuiltInFunctionInvocationExpressionAstNode* node,
+    bytecode::ByteCodeInstruction generic
+  ) noexcept {
+    auto find = this->specializedBuiltInLookup.find(node->identifier->value);
+
+    if (find == this->specializedBuiltInLookup.end() || node->expressions.size() != 2) {
+      return generic;
+    }
+
+    InferredType first = this->inferredTypeOf(node->expressions.at(0));
+    InferredType second = this->inferredTypeOf(node->expressions.at(1));
+
+    if (first == InferredType::Integer && second == InferredType::Integer) {
+      return find->second.first;
+    }
+
+    if (first == InferredType::Float && second == InferredType::Float) {
+      return find->second.second;
+    }
+
+    return generic;
   }
 
   void onExitFunctionDeclarationExpressionAstNode(FunctionDeclarationExpressionAstNode* node) noexcept override {
@@ -466,6 +727,14 @@ public:
       closures.emplace_back(cc.outerScopeCount, cc.localScopeIndex);
     }
 
+    for (const auto selfCallIndex : this->ec->selfCallIndices) {
+      this->ec->UpdateParameterAtIndex(selfCallIndex, fnIndex);
+    }
+
+    if (!this->ec->capturesOuterScope) {
+      this->selfContainedFunctions.insert(std::make_pair(node, fnIndex));
+    }
+
     this->functions.emplace_back(bytecode::Function{
       node->parameters.size(),
       this->ec->variables.size(),
@@ -501,7 +770,16 @@ public:
 };
 
 std::shared_ptr<bytecode::CompiledFile> compiler::AstCompiler::compile(std::shared_ptr<ScriptAstNode> file) noexcept {
-  CompilerAstWalker astWalker;
+  AssignedIdentifierCollector assignedIdentifierCollector;
+
+  assignedIdentifierCollector.visitScriptAstNode(file.get());
+
+  TypeAnalyzer typeAnalyzer;
+
+  CompilerAstWalker astWalker{
+    std::move(assignedIdentifierCollector.assigned),
+    typeAnalyzer.infer(file)
+  };
 
   astWalker.visitScriptAstNode(file.get());
 
@@ -0,0 +1,281 @@
+#include "ByteCode.hpp"
+
+#include <cstring>
+
+namespace bytecode {
+
+StackEffect stackEffect(
+  const ByteCode& bc,
+  const std::vector<Function>& functions,
+  const std::vector<ObjectConstructor>& objects
+) noexcept {
+  switch (bc.instruction) {
+    case ByteCodeInstruction::Halt:
+    case ByteCodeInstruction::Jump:
+    case ByteCodeInstruction::NoOp:
+      return StackEffect{0, 0};
+
+    case ByteCodeInstruction::Read:
+    case ByteCodeInstruction::LoadIntegerConstant:
+    case ByteCodeInstruction::LoadFloatConstant:
+    case ByteCodeInstruction::LoadStringConstant:
+    case ByteCodeInstruction::LoadUndefinedConstant:
+    case ByteCodeInstruction::LoadBooleanTrueConstant:
+    case ByteCodeInstruction::LoadBooleanFalseConstant:
+    case ByteCodeInstruction::LoadLocal:
+    case ByteCodeInstruction::LoadGlobal:
+    case ByteCodeInstruction::LoadClosure:
+    case ByteCodeInstruction::MakeFn:
+    case ByteCodeInstruction::Snapshot:
+      return StackEffect{0, 1};
+
+    case ByteCodeInstruction::JumpIfFalse:
+    case ByteCodeInstruction::SetLocal:
+    case ByteCodeInstruction::SetGlobal:
+    case ByteCodeInstruction::Return:
+    case ByteCodeInstruction::Pop:
+      return StackEffect{1, 0};
+
+    case ByteCodeInstruction::Print:
+    case ByteCodeInstruction::Not:
+    case ByteCodeInstruction::GetType:
+    case ByteCodeInstruction::CastToInt:
+    case ByteCodeInstruction::CastToFloat:
+    case ByteCodeInstruction::Length:
+    case ByteCodeInstruction::GetEnv:
+      return StackEffect{1, 1};
+
+    case ByteCodeInstruction::ObjectSet:
+      return StackEffect{3, 1};
+
+    case ByteCodeInstruction::Invoke:
+      return StackEffect{bc.parameter + 1, 1};
+
+    case ByteCodeInstruction::CallKnown:
+      return StackEffect{bc.parameter < functions.size() ? functions.at(bc.parameter).argumentCount : 0, 1};
+
+    case ByteCodeInstruction::MakeObj:
+      return StackEffect{bc.parameter < objects.size() ? objects.at(bc.parameter).keys.size() : 0, 1};
+
+    default:
+      // every remaining instruction is a binary operator
+      return StackEffect{2, 1};
+  }
+}
+
+std::optional<std::vector<std::optional<std::size_t>>> stackDepths(
+  const std::vector<ByteCode>& byteCode,
+  const std::vector<Function>& functions,
+  const std::vector<ObjectConstructor>& objects
+) noexcept {
+  std::size_t size = byteCode.size();
+  std::vector<std::optional<std::size_t>> depths(size);
+  std::vector<std::size_t> work;
+
+  auto reach = [&depths, &work, size](std::size_t target, std::size_t depth) {
+    if (target >= size) {
+      return false;
+    }
+
+    if (!depths.at(target)) {
+      depths.at(target) = depth;
+      work.push_back(target);
+      return true;
+    }
+
+    return depths.at(target).value() == depth;
+  };
+
+  if (size == 0 || !reach(0, 0)) {
+    return std::nullopt;
+  }
+
+  while (!work.empty()) {
+    std::size_t pc = work.back();
+    work.pop_back();
+
+    const auto& bc = byteCode.at(pc);
+    std::size_t depth = depths.at(pc).value();
+    auto effect = stackEffect(bc, functions, objects);
+
+    if (effect.pops > depth) {
+      return std::nullopt;
+    }
+
+    std::size_t next = depth - effect.pops + effect.pushes;
+    bool isConsistent = true;
+
+    switch (bc.instruction) {
+      case ByteCodeInstruction::Halt:
+      case ByteCodeInstruction::Return:
+        break;
+
+      case ByteCodeInstruction::Jump:
+        isConsistent = reach(bc.parameter, next);
+        break;
+
+      case ByteCodeInstruction::JumpIfFalse:
+        isConsistent = reach(bc.parameter, next) && reach(pc + 1, next);
+        break;
+
+      default:
+        isConsistent = reach(pc + 1, next);
+        break;
+    }
+
+    if (!isConsistent) {
+      return std::nullopt;
+    }
+  }
+
+  return depths;
+}
+
+std::optional<std::string> byteCodeToString(const ByteCode& bc) noexcept {
+
+  #define PARAM "(" + std::to_string(bc.parameter) + ")"
+
+  switch (bc.instruction) {
+    case ByteCodeInstruction::Halt: return "Halt";
+    case ByteCodeInstruction::Add: return "Add";
+    case ByteCodeInstruction::Subtract: return "Subtract";
+    case ByteCodeInstruction::Multiply: return "Multiply";
+    case ByteCodeInstruction::Divide: return "Divide";
+    case ByteCodeInstruction::Print: return "Print";
+    case ByteCodeInstruction::Read: return "Read";
+    case ByteCodeInstruction::Jump: return "Jump" PARAM;
+    case ByteCodeInstruction::JumpIfFalse: return "JumpIfFalse" PARAM;
+    case ByteCodeInstruction::LoadIntegerConstant: return "LoadIntegerConstant" PARAM;
+    case ByteCodeInstruction::LoadFloatConstant: return "LoadFloatConstant" PARAM;
+    case ByteCodeInstruction::LoadStringConstant: return "LoadStringConstant" PARAM;
+    case ByteCodeInstruction::LoadUndefinedConstant: return "LoadUndefinedConstant";
+    case ByteCodeInstruction::LoadBooleanTrueConstant: return "LoadBooleanTrueConstant";
+    case ByteCodeInstruction::LoadBooleanFalseConstant: return "LoadBooleanFalseConstant";
+    case ByteCodeInstruction::LoadLocal: return "LoadLocal" PARAM;
+    case ByteCodeInstruction::SetLocal: return "SetLocal" PARAM;
+    case ByteCodeInstruction::LoadGlobal: return "LoadGlobal" PARAM;
+    case ByteCodeInstruction::SetGlobal: return "SetGlobal" PARAM;
+    case ByteCodeInstruction::Return: return "Return";
+    case ByteCodeInstruction::Invoke: return "Invoke" PARAM;
+    case ByteCodeInstruction::CallKnown: return "CallKnown" PARAM;
+    case ByteCodeInstruction::NoOp: return "NoOp";
+    case ByteCodeInstruction::MakeFn: return "MakeFn" PARAM;
+    case ByteCodeInstruction::MakeObj: return "MakeObj" PARAM;
+    case ByteCodeInstruction::Less: return "Less";
+    case ByteCodeInstruction::LessOrEqual: return "LessOrEqual";
+    case ByteCodeInstruction::Greater: return "Greater";
+    case ByteCodeInstruction::GreaterOrEqual: return "GreaterOrEqual";
+    case ByteCodeInstruction::Not: return "Not";
+    case ByteCodeInstruction::Equal: return "Equal";
+    case ByteCodeInstruction::NotEqual: return "NotEqual";
+    case ByteCodeInstruction::And: return "And";
+    case ByteCodeInstruction::Or: return "Or";
+    case ByteCodeInstruction::GetType: return "GetType";
+    case ByteCodeInstruction::CastToInt: return "CastToInt";
+    case ByteCodeInstruction::CastToFloat: return "CastToFloat";
+    case ByteCodeInstruction::Length: return "Length";
+    case ByteCodeInstruction::ChatAt: return "ChatAt";
+    case ByteCodeInstruction::StringAppend: return "StringAppend";
+    case ByteCodeInstruction::ObjectGet: return "ObjectGet";
+    case ByteCodeInstruction::ObjectSet: return "ObjectSet";
+    case ByteCodeInstruction::GetEnv: return "GetEnv";
+    case ByteCodeInstruction::LoadClosure: return "LoadClosure" PARAM;
+    case ByteCodeInstruction::Pop: return "Pop";
+    case ByteCodeInstruction::Snapshot: return "Snapshot";
+    case ByteCodeInstruction::AddIntInt: return "AddIntInt";
+    case ByteCodeInstruction::AddFloatFloat: return "AddFloatFloat";
+    case ByteCodeInstruction::SubtractIntInt: return "SubtractIntInt";
+    case ByteCodeInstruction::SubtractFloatFloat: return "SubtractFloatFloat";
+    case ByteCodeInstruction::MultiplyIntInt: return "MultiplyIntInt";
+    case ByteCodeInstruction::MultiplyFloatFloat: return "MultiplyFloatFloat";
+    case ByteCodeInstruction::DivideIntInt: return "DivideIntInt";
+    case ByteCodeInstruction::DivideFloatFloat: return "DivideFloatFloat";
+    case ByteCodeInstruction::LessIntInt: return "LessIntInt";
+    case ByteCodeInstruction::LessFloatFloat: return "LessFloatFloat";
+    case ByteCodeInstruction::LessOrEqualIntInt: return "LessOrEqualIntInt";
+    case ByteCodeInstruction::LessOrEqualFloatFloat: return "LessOrEqualFloatFloat";
+    case ByteCodeInstruction::GreaterIntInt: return "GreaterIntInt";
+    case ByteCodeInstruction::GreaterFloatFloat: return "GreaterFloatFloat";
+    case ByteCodeInstruction::GreaterOrEqualIntInt: return "GreaterOrEqualIntInt";
+    case ByteCodeInstruction::GreaterOrEqualFloatFloat: return "GreaterOrEqualFloatFloat";
+    default: return std::nullopt;
+  }
+
+  #undef PARAM
+}
+
+class FileHasher {
+public:
+  std::uint64_t hash = 14695981039346656037ull;
+
+  void add(std::uint64_t value) {
+    for (std::size_t i = 0; i < sizeof(value); i++) {
+      this->hash ^= (value >> (8 * i)) & 0xff;
+      this->hash *= 1099511628211ull;
+    }
+  }
+
+  void add(const std::string & value) {
+    this->add(value.size());
+    for (char c : value) {
+      this->hash ^= static_cast<unsigned char>(c);
+      this->hash *= 1099511628211ull;
+    }
+  }
+
+  void add(const Function& fn) {
+    this->add(fn.argumentCount);
+    this->add(fn.localsCount);
+    this->add(fn.closures.size());
+    for (const auto& closure : fn.closures) {
+      this->add(closure.scopeOffsets);
+      this->add(closure.localIndex);
+    }
+    this->add(fn.byteCode.size());
+    for (const auto& bc : fn.byteCode) {
+      this->add(static_cast<std::uint64_t>(bc.instruction));
+      this->add(bc.parameter);
+    }
+  }
+};
+
+std::uint64_t hashCompiledFile(const CompiledFile& file) noexcept {
+  FileHasher hasher;
+
+  hasher.add(file.entrypoint);
+  hasher.add(file.globalsCount);
+
+  hasher.add(file.functions.size());
+  for (const auto& fn : file.functions) {
+    hasher.add(fn);
+  }
+
+  hasher.add(file.objects.size());
+  for (const auto& object : file.objects) {
+    hasher.add(object.keys.size());
+    for (const auto& key : object.keys) {
+      hasher.add(key);
+    }
+  }
+
+  hasher.add(file.intConstants.size());
+  for (auto value : file.intConstants) {
+    hasher.add(static_cast<std::uint64_t>(value));
+  }
+
+  hasher.add(file.floatConstants.size());
+  for (auto value : file.floatConstants) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    hasher.add(bits);
+  }
+
+  hasher.add(file.stringConstants.size());
+  for (const auto& value : file.stringConstants) {
+    hasher.add(value);
+  }
+
+  return hasher.hash;
+}
+
+}
@@ -0,0 +1,314 @@
+#include "ByteCodeFile.hpp"
+
+#include <cstring>
+
+namespace bytecode {
+
+static const char byteCodeFileMagic[8] = {'F', 'L', 'A', 'N', 'G', 'B', 'C', '\0'};
+static constexpr std::uint64_t byteOrderMark = 0x0102030405060708ull;
+static constexpr std::uint64_t maxVariableCount = 1 << 24;
+static constexpr std::uint64_t instructionCount = static_cast<std::uint64_t>(ByteCodeInstruction::GreaterOrEqualFloatFloat) + 1;
+
+ByteCodeWriter::ByteCodeWriter(std::ostream & out) noexcept
+: out{out}
+{}
+
+void ByteCodeWriter::word(std::uint64_t value) {
+  this->out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void ByteCodeWriter::string(const std::string & value) {
+  static const char padding[8] = {};
+
+  this->word(value.size());
+  this->out.write(value.data(), static_cast<std::streamsize>(value.size()));
+  this->out.write(padding, static_cast<std::streamsize>((8 - value.size() % 8) % 8));
+}
+
+void ByteCodeWriter::function(const Function& fn) {
+  this->word(fn.argumentCount);
+  this->word(fn.localsCount);
+
+  this->word(fn.closures.size());
+  for (const auto& closure : fn.closures) {
+    this->word(closure.scopeOffsets);
+    this->word(closure.localIndex);
+  }
+
+  this->word(fn.byteCode.size());
+  for (const auto& bc : fn.byteCode) {
+    this->word(static_cast<std::uint64_t>(bc.instruction));
+    this->word(bc.parameter);
+  }
+}
+
+ByteCodeReader::ByteCodeReader(const std::uint8_t* data, std::size_t size) noexcept
+: position{data}
+, end{data + size}
+{}
+
+bool ByteCodeReader::isAtEnd() const {
+  return this->position == this->end;
+}
+
+bool ByteCodeReader::word(std::uint64_t& value) {
+  if (static_cast<std::size_t>(this->end - this->position) < sizeof(value)) {
+    return false;
+  }
+
+  std::memcpy(&value, this->position, sizeof(value));
+  this->position += sizeof(value);
+  return true;
+}
+
+// a length has to fit in what is left of the file, so a corrupt one can't
+// make the loader reserve huge amounts of memory
+bool ByteCodeReader::length(std::uint64_t& value, std::size_t elementSize) {
+  return this->word(value) && value <= static_cast<std::size_t>(this->end - this->position) / elementSize;
+}
+
+// the VM allocates this many variables up front, anything beyond the limit
+// comes from a corrupt file
+bool ByteCodeReader::variableCount(std::uint64_t& value) {
+  return this->word(value) && value <= maxVariableCount;
+}
+
+bool ByteCodeReader::string(std::string& value) {
+  std::uint64_t size;
+
+  if (!this->length(size, 1)) {
+    return false;
+  }
+
+  std::size_t padded = size + (8 - size % 8) % 8;
+
+  if (padded > static_cast<std::size_t>(this->end - this->position)) {
+    return false;
+  }
+
+  value.assign(reinterpret_cast<const char*>(this->position), size);
+  this->position += padded;
+  return true;
+}
+
+std::string ByteCodeReader::rest() {
+  std::string value{reinterpret_cast<const char*>(this->position), static_cast<std::size_t>(this->end - this->position)};
+  this->position = this->end;
+  return value;
+}
+
+std::optional<Function> ByteCodeReader::function() {
+  std::uint64_t argumentCount, localsCount, closureCount, byteCodeCount;
+
+  if (!this->variableCount(argumentCount)
+    || !this->variableCount(localsCount)
+    || argumentCount > localsCount
+    || !this->length(closureCount, 16)) {
+    return std::nullopt;
+  }
+
+  std::vector<ClosureContext> closures;
+  closures.reserve(closureCount);
+
+  for (std::uint64_t i = 0; i < closureCount; i++) {
+    std::uint64_t scopeOffsets, localIndex;
+
+    if (!this->word(scopeOffsets) || !this->word(localIndex)) {
+      return std::nullopt;
+    }
+
+    closures.emplace_back(scopeOffsets, localIndex);
+  }
+
+  if (!this->length(byteCodeCount, 16)) {
+    return std::nullopt;
+  }
+
+  std::vector<ByteCode> byteCode;
+  byteCode.reserve(byteCodeCount);
+
+  for (std::uint64_t i = 0; i < byteCodeCount; i++) {
+    std::uint64_t instruction, parameter;
+
+    if (!this->word(instruction) || !this->word(parameter) || instruction >= instructionCount) {
+      return std::nullopt;
+    }
+
+    byteCode.emplace_back(static_cast<ByteCodeInstruction>(instruction), parameter);
+  }
+
+  return Function{argumentCount, localsCount, std::move(closures), std::move(byteCode)};
+}
+
+void writeCompiledFile(const CompiledFile& file, std::ostream & out) {
+  ByteCodeWriter writer{out};
+
+  out.write(byteCodeFileMagic, sizeof(byteCodeFileMagic));
+  writer.word(static_cast<std::uint64_t>(byteCodeFileVersion) << 32 | instructionCount);
+  writer.word(byteOrderMark);
+
+  writer.word(file.globalsCount);
+  writer.function(file.entrypoint);
+
+  writer.word(file.functions.size());
+  for (const auto& fn : file.functions) {
+    writer.function(fn);
+  }
+
+  writer.word(file.objects.size());
+  for (const auto& object : file.objects) {
+    writer.word(object.keys.size());
+    for (const auto& key : object.keys) {
+      writer.string(key);
+    }
+  }
+
+  writer.word(file.intConstants.size());
+  for (auto value : file.intConstants) {
+    writer.word(static_cast<std::uint64_t>(value));
+  }
+
+  writer.word(file.floatConstants.size());
+  for (auto value : file.floatConstants) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writer.word(bits);
+  }
+
+  writer.word(file.stringConstants.size());
+  for (const auto& value : file.stringConstants) {
+    writer.string(value);
+  }
+}
+
+std::shared_ptr<CompiledFile> decodeCompiledFile(const std::uint8_t* data, std::size_t size) {
+  if (size < sizeof(byteCodeFileMagic) || std::memcmp(data, byteCodeFileMagic, sizeof(byteCodeFileMagic)) != 0) {
+    return nullptr;
+  }
+
+  ByteCodeReader reader{data + sizeof(byteCodeFileMagic), size - sizeof(byteCodeFileMagic)};
+  std::uint64_t version, mark, globalsCount, count;
+
+  if (!reader.word(version)
+    || version != (static_cast<std::uint64_t>(byteCodeFileVersion) << 32 | instructionCount)
+    || !reader.word(mark)
+    || mark != byteOrderMark
+    || !reader.variableCount(globalsCount)) {
+    return nullptr;
+  }
+
+  auto entrypoint = reader.function();
+
+  if (!entrypoint || !reader.length(count, 32)) {
+    return nullptr;
+  }
+
+  std::vector<Function> functions;
+  functions.reserve(count);
+
+  for (std::uint64_t i = 0; i < count; i++) {
+    auto fn = reader.function();
+
+    if (!fn) {
+      return nullptr;
+    }
+
+    functions.push_back(std::move(fn.value()));
+  }
+
+  if (!reader.length(count, 8)) {
+    return nullptr;
+  }
+
+  std::vector<ObjectConstructor> objects;
+  objects.reserve(count);
+
+  for (std::uint64_t i = 0; i < count; i++) {
+    std::uint64_t keyCount;
+
+    if (!reader.length(keyCount, 8)) {
+      return nullptr;
+    }
+
+    std::vector<std::string> keys(keyCount);
+
+    for (auto& key : keys) {
+      if (!reader.string(key)) {
+        return nullptr;
+      }
+    }
+
+    objects.emplace_back(std::move(keys));
+  }
+
+  if (!reader.length(count, 8)) {
+    return nullptr;
+  }
+
+  std::vector<std::int64_t> intConstants(count);
+
+  for (auto& value : intConstants) {
+    std::uint64_t bits = 0;
+
+    if (!reader.word(bits)) {
+      return nullptr;
+    }
+
+    value = static_cast<std::int64_t>(bits);
+  }
+
+  if (!reader.length(count, 8)) {
+    return nullptr;
+  }
+
+  std::vector<double> floatConstants(count);
+
+  for (auto& value : floatConstants) {
+    std::uint64_t bits = 0;
+
+    if (!reader.word(bits)) {
+      return nullptr;
+    }
+
+    std::memcpy(&value, &bits, sizeof(value));
+  }
+
+  if (!reader.length(count, 8)) {
+    return nullptr;
+  }
+
+  std::vector<std::string> stringConstants(count);
+
+  for (auto& value : stringConstants) {
+    if (!reader.string(value)) {
+      return nullptr;
+    }
+  }
+
+  if (!reader.isAtEnd()) {
+    return nullptr;
+  }
+
+  return std::make_shared<CompiledFile>(
+    std::move(entrypoint.value()),
+    globalsCount,
+    std::move(functions),
+    std::move(objects),
+    std::move(intConstants),
+    std::move(floatConstants),
+    std::move(stringConstants));
+}
+
+std::shared_ptr<CompiledFile> loadCompiledFile(const std::string & path) {
+  std::ifstream in{path, std::ios::binary};
+
+  if (in.fail()) {
+    return nullptr;
+  }
+
+  std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+  return decodeCompiledFile(reinterpret_cast<const std::uint8_t*>(data.data()), data.size());
+}
+
+}
@@ -0,0 +1,245 @@
+#include "CGenerator.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+static std::string functionName(std::size_t index, std::size_t functionCount) {
+  return index == functionCount ? "fn_entrypoint" : "fn_" + std::to_string(index);
+}
+
+static void writeString(std::ostream & out, const std::string & value) {
+  out << "{\"";
+
+  // octal escapes always take three digits so they never run into the next character
+  for (char c : value) {
+    auto byte = static_cast<unsigned char>(c);
+
+    if (std::isalnum(byte) || c == ' ' || c == '_' || c == '.' || c == ',' || c == ':') {
+      out << c;
+    } else {
+      out << '\\'
+        << static_cast<char>('0' + ((byte >> 6) & 7))
+        << static_cast<char>('0' + ((byte >> 3) & 7))
+        << static_cast<char>('0' + (byte & 7));
+    }
+  }
+
+  out << "\", " << value.size() << "u}";
+}
+
+static void writeInteger(std::ostream & out, std::int64_t value) {
+  if (value == std::numeric_limits<std::int64_t>::min()) {
+    out << "(-INT64_C(9223372036854775807) - 1)";
+  } else {
+    out << "INT64_C(" << value << ")";
+  }
+}
+
+static void writeFloat(std::ostream & out, double value) {
+  if (std::isnan(value)) {
+    out << "NAN";
+  } else if (std::isinf(value)) {
+    out << (value < 0 ? "-HUGE_VAL" : "HUGE_VAL");
+  } else {
+    out << std::hexfloat << value << std::defaultfloat;
+  }
+}
+
+// a NULL pointer stands in for empty arrays, which C does not allow
+static std::string arrayOrNull(const std::string & name, std::size_t size) {
+  return size == 0 ? "NULL" : name;
+}
+
+static void writeFunctionData(std::ostream & out, const bytecode::Function& fn, const std::string & name) {
+  if (!fn.closures.empty()) {
+    out << "static const flang_closure " << name << "_closures[] = {\n";
+    for (const auto& closure : fn.closures) {
+      out << "  {" << closure.scopeOffsets << "u, " << closure.localIndex << "u},\n";
+    }
+    out << "};\n\n";
+  }
+
+  if (!fn.byteCode.empty()) {
+    out << "static const flang_bytecode " << name << "_bytecode[] = {\n";
+    for (const auto& bc : fn.byteCode) {
+      out << "  {" << static_cast<std::uint32_t>(bc.instruction) << "u, " << bc.parameter << "u},\n";
+    }
+    out << "};\n\n";
+  }
+}
+
+static void writeFunctionDescriptor(std::ostream & out, const bytecode::Function& fn, const std::string & name) {
+  out << "{"
+    << fn.argumentCount << "u, "
+    << fn.localsCount << "u, "
+    << arrayOrNull(name + "_closures", fn.closures.size()) << ", "
+    << fn.closures.size() << "u, "
+    << arrayOrNull(name + "_bytecode", fn.byteCode.size()) << ", "
+    << fn.byteCode.size() << "u}";
+}
+
+// every instruction becomes a call to the runtime helper the JIT uses,
+// branches become gotos and the function returns to the runtime whenever
+// the current stack frame changes
+static void writeFunctionCode(std::ostream & out, const bytecode::Function& fn, const std::string & name) {
+  std::size_t size = fn.byteCode.size();
+
+  out << "static void " << name << "(flang_vm* vm, size_t pc) {\n";
+  out << "  switch (pc) {\n";
+  for (std::size_t pc = 0; pc < size; pc++) {
+    out << "    case " << pc << "u: goto pc_" << pc << ";\n";
+  }
+  out << "    default: goto pc_end;\n";
+  out << "  }\n\n";
+
+  for (std::size_t pc = 0; pc < size; pc++) {
+    const auto& bc = fn.byteCode[pc];
+    auto instruction = static_cast<std::uint32_t>(bc.instruction);
+    std::string target = bc.parameter < size ? "pc_" + std::to_string(bc.parameter) : "pc_end";
+
+    out << "pc_" << pc << ":\n";
+
+    switch (bc.instruction) {
+      case bytecode::ByteCodeInstruction::Jump:
+        out << "  op[" << instruction << "](vm);\n";
+        out << "  goto " << target << ";\n";
+        break;
+
+      case bytecode::ByteCodeInstruction::JumpIfFalse:
+        out << "  if (flang_aot_jump_if_false(vm)) goto " << target << ";\n";
+        break;
+
+      case bytecode::ByteCodeInstruction::Return:
+      case bytecode::ByteCodeInstruction::Invoke:
+      case bytecode::ByteCodeInstruction::CallKnown:
+        out << "  op[" << instruction << "](vm);\n";
+        out << "  return;\n";
+        break;
+
+      case bytecode::ByteCodeInstruction::Halt:
+      case bytecode::ByteCodeInstruction::NoOp:
+      case bytecode::ByteCodeInstruction::Snapshot:
+        // left to the runtime
+        out << "  return;\n";
+        break;
+
+      default:
+        out << "  op[" << instruction << "](vm);\n";
+        break;
+    }
+  }
+
+  out << "pc_end:\n";
+  out << "  return;\n";
+  out << "}\n\n";
+}
+
+void compiler::CGenerator::generate(const bytecode::CompiledFile& file, std::ostream & out) noexcept {
+  std::size_t functionCount = file.functions.size();
+
+  out << "/* generated by flang --aot, link with the flang runtime library */\n";
+  out << "#include <math.h>\n";
+  out << "#include \"flang_aot.h\"\n\n";
+
+  out << "static flang_op op[FLANG_AOT_INSTRUCTION_COUNT];\n\n";
+
+  for (std::size_t i = 0; i < functionCount; i++) {
+    writeFunctionData(out, file.functions[i], functionName(i, functionCount));
+  }
+  writeFunctionData(out, file.entrypoint, functionName(functionCount, functionCount));
+
+  if (!file.functions.empty()) {
+    out << "static const flang_function functions[] = {\n";
+    for (std::size_t i = 0; i < functionCount; i++) {
+      out << "  ";
+      writeFunctionDescriptor(out, file.functions[i], functionName(i, functionCount));
+      out << ",\n";
+    }
+    out << "};\n\n";
+  }
+
+  for (std::size_t i = 0; i < file.objects.size(); i++) {
+    if (file.objects[i].keys.empty()) {
+      continue;
+    }
+
+    out << "static const flang_string object_" << i << "_keys[] = {\n";
+    for (const auto& key : file.objects[i].keys) {
+      out << "  ";
+      writeString(out, key);
+      out << ",\n";
+    }
+    out << "};\n\n";
+  }
+
+  if (!file.objects.empty()) {
+    out << "static const flang_object objects[] = {\n";
+    for (std::size_t i = 0; i < file.objects.size(); i++) {
+      out << "  {" << arrayOrNull("object_" + std::to_string(i) + "_keys", file.objects[i].keys.size())
+        << ", " << file.objects[i].keys.size() << "u},\n";
+    }
+    out << "};\n\n";
+  }
+
+  if (!file.intConstants.empty()) {
+    out << "static const int64_t int_constants[] = {\n";
+    for (auto value : file.intConstants) {
+      out << "  ";
+      writeInteger(out, value);
+      out << ",\n";
+    }
+    out << "};\n\n";
+  }
+
+  if (!file.floatConstants.empty()) {
+    out << "static const double float_constants[] = {\n";
+    for (auto value : file.floatConstants) {
+      out << "  ";
+      writeFloat(out, value);
+      out << ",\n";
+    }
+    out << "};\n\n";
+  }
+
+  if (!file.stringConstants.empty()) {
+    out << "static const flang_string string_constants[] = {\n";
+    for (const auto& value : file.stringConstants) {
+      out << "  ";
+      writeString(out, value);
+      out << ",\n";
+    }
+    out << "};\n\n";
+  }
+
+  out << "static const flang_compiled_file file = {\n";
+  out << "  ";
+  writeFunctionDescriptor(out, file.entrypoint, functionName(functionCount, functionCount));
+  out << ",\n";
+  out << "  " << file.globalsCount << "u,\n";
+  out << "  " << arrayOrNull("functions", functionCount) << ", " << functionCount << "u,\n";
+  out << "  " << arrayOrNull("objects", file.objects.size()) << ", " << file.objects.size() << "u,\n";
+  out << "  " << arrayOrNull("int_constants", file.intConstants.size()) << ", " << file.intConstants.size() << "u,\n";
+  out << "  " << arrayOrNull("float_constants", file.floatConstants.size()) << ", " << file.floatConstants.size() << "u,\n";
+  out << "  " << arrayOrNull("string_constants", file.stringConstants.size()) << ", " << file.stringConstants.size() << "u,\n";
+  out << "};\n\n";
+
+  for (std::size_t i = 0; i < functionCount; i++) {
+    writeFunctionCode(out, file.functions[i], functionName(i, functionCount));
+  }
+  writeFunctionCode(out, file.entrypoint, functionName(functionCount, functionCount));
+
+  out << "static const flang_aot_function code[] = {\n";
+  for (std::size_t i = 0; i <= functionCount; i++) {
+    out << "  " << functionName(i, functionCount) << ",\n";
+  }
+  out << "};\n\n";
+
+  out << "int main(void) {\n";
+  out << "  for (uint32_t i = 0; i < FLANG_AOT_INSTRUCTION_COUNT; i++) {\n";
+  out << "    op[i] = flang_aot_op(i);\n";
+  out << "  }\n\n";
+  out << "  return flang_aot_run(&file, code);\n";
+  out << "}\n";
+}
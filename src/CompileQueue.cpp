@@ -0,0 +1,92 @@
+#include "CompileQueue.hpp"
+
+namespace jit {
+
+jit::CompileQueue::CompileQueue()
+: hasFinishedTasks{false}
+, isStopping{false}
+, statistics{0, 0, 0, std::chrono::nanoseconds{0}, std::chrono::nanoseconds{0}}
+, worker{&CompileQueue::work, this}
+{}
+
+jit::CompileQueue::~CompileQueue() noexcept {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->isStopping = true;
+  }
+
+  this->wakeUp.notify_one();
+  this->worker.join();
+}
+
+void jit::CompileQueue::submit(std::size_t key, bool isOptimizing, std::function<CompileResult()> compile) {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+
+    this->pending.push_back(CompileTask{
+      key,
+      isOptimizing,
+      std::move(compile),
+      std::chrono::steady_clock::now(),
+      CompileResult{nullptr, {}}
+    });
+
+    this->statistics.submitted++;
+    this->statistics.peakQueueLength = std::max(this->statistics.peakQueueLength, this->pending.size());
+  }
+
+  this->wakeUp.notify_one();
+}
+
+std::vector<CompileTask> jit::CompileQueue::takeFinished() {
+  std::vector<CompileTask> tasks;
+  auto now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock{this->mutex};
+  tasks.swap(this->finished);
+  this->hasFinishedTasks.store(false, std::memory_order_relaxed);
+
+  for (const auto& task : tasks) {
+    auto installTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now - task.submittedAt);
+
+    this->statistics.installed++;
+    this->statistics.totalInstallTime += installTime;
+    this->statistics.maxInstallTime = std::max(this->statistics.maxInstallTime, installTime);
+  }
+
+  return tasks;
+}
+
+std::size_t jit::CompileQueue::queueLength() {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  return this->pending.size();
+}
+
+CompileStatistics jit::CompileQueue::getStatistics() {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  return this->statistics;
+}
+
+void jit::CompileQueue::work() {
+  std::unique_lock<std::mutex> lock{this->mutex};
+
+  while (true) {
+    this->wakeUp.wait(lock, [this]() { return this->isStopping || !this->pending.empty(); });
+
+    if (this->isStopping) {
+      return;
+    }
+
+    CompileTask task = std::move(this->pending.front());
+    this->pending.pop_front();
+
+    lock.unlock();
+    task.result = task.compile();
+    lock.lock();
+
+    this->finished.push_back(std::move(task));
+    this->hasFinishedTasks.store(true, std::memory_order_relaxed);
+  }
+}
+
+};
@@ -0,0 +1,508 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+#include <cmath>
+#include <unordered_set>
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+enum class ConstantType {
+  Integer,
+  Float,
+  String,
+  Boolean,
+  Undefined,
+};
+
+class Constant {
+public:
+  ConstantType type;
+  std::int64_t integerValue = 0;
+  double floatValue = 0.0;
+  std::string stringValue;
+  bool booleanValue = false;
+};
+
+class ConstantFolder {
+private:
+  Program& program;
+  // globals written once, with a constant, before the script's first branch
+  std::unordered_map<std::size_t, Constant> constantGlobals;
+  std::unordered_set<std::size_t> scriptGlobals;
+  // the ones of those written before the first call, functions can rely on these
+  std::unordered_set<std::size_t> beforeCallGlobals;
+  std::vector<std::size_t> globalWrites;
+
+  std::optional<Constant> constantOf(const ir::Instruction& instruction) const {
+    if (instruction.kind != ir::InstructionKind::Operation) {
+      return std::nullopt;
+    }
+
+    Constant constant;
+
+    switch (instruction.op) {
+      case ByteCodeInstruction::LoadIntegerConstant:
+        constant.type = ConstantType::Integer;
+        constant.integerValue = this->program.intConstants.at(instruction.parameter);
+        return constant;
+
+      case ByteCodeInstruction::LoadFloatConstant:
+        constant.type = ConstantType::Float;
+        constant.floatValue = this->program.floatConstants.at(instruction.parameter);
+        return constant;
+
+      case ByteCodeInstruction::LoadStringConstant:
+        constant.type = ConstantType::String;
+        constant.stringValue = this->program.stringConstants.at(instruction.parameter);
+        return constant;
+
+      case ByteCodeInstruction::LoadBooleanTrueConstant:
+      case ByteCodeInstruction::LoadBooleanFalseConstant:
+        constant.type = ConstantType::Boolean;
+        constant.booleanValue = instruction.op == ByteCodeInstruction::LoadBooleanTrueConstant;
+        return constant;
+
+      case ByteCodeInstruction::LoadUndefinedConstant:
+        constant.type = ConstantType::Undefined;
+        return constant;
+
+      default:
+        return std::nullopt;
+    }
+  }
+
+  // turns the instruction into a load of the constant in place, so every use stays valid
+  void replaceWithConstant(ir::Instruction& instruction, const Constant& constant) {
+    instruction.operands.clear();
+    instruction.parameter = 0;
+
+    switch (constant.type) {
+      case ConstantType::Integer:
+        instruction.op = ByteCodeInstruction::LoadIntegerConstant;
+        instruction.parameter = this->program.intConstant(constant.integerValue);
+        break;
+
+      case ConstantType::Float:
+        instruction.op = ByteCodeInstruction::LoadFloatConstant;
+        instruction.parameter = this->program.floatConstant(constant.floatValue);
+        break;
+
+      case ConstantType::String:
+        instruction.op = ByteCodeInstruction::LoadStringConstant;
+        instruction.parameter = this->program.stringConstant(constant.stringValue);
+        break;
+
+      case ConstantType::Boolean:
+        instruction.op = constant.booleanValue
+          ? ByteCodeInstruction::LoadBooleanTrueConstant
+          : ByteCodeInstruction::LoadBooleanFalseConstant;
+        break;
+
+      case ConstantType::Undefined:
+        instruction.op = ByteCodeInstruction::LoadUndefinedConstant;
+        break;
+    }
+  }
+
+  static Constant undefined() {
+    Constant constant;
+    constant.type = ConstantType::Undefined;
+    return constant;
+  }
+
+  static Constant boolean(bool value) {
+    Constant constant;
+    constant.type = ConstantType::Boolean;
+    constant.booleanValue = value;
+    return constant;
+  }
+
+  static Constant integer(std::int64_t value) {
+    Constant constant;
+    constant.type = ConstantType::Integer;
+    constant.integerValue = value;
+    return constant;
+  }
+
+  static Constant string(std::string value) {
+    Constant constant;
+    constant.type = ConstantType::String;
+    constant.stringValue = std::move(value);
+    return constant;
+  }
+
+  // the same as booleanValueOfVariable in the runtime
+  static bool isTruthy(const Constant& constant) {
+    switch (constant.type) {
+      case ConstantType::Boolean: return constant.booleanValue;
+      case ConstantType::Undefined: return false;
+      default: return true;
+    }
+  }
+
+  static bool isEqual(const Constant& first, const Constant& second) {
+    if (first.type != second.type) {
+      return false;
+    }
+
+    switch (first.type) {
+      case ConstantType::Integer: return first.integerValue == second.integerValue;
+      case ConstantType::Float: return first.floatValue == second.floatValue;
+      case ConstantType::String: return first.stringValue == second.stringValue;
+      case ConstantType::Boolean: return first.booleanValue == second.booleanValue;
+      case ConstantType::Undefined: return true;
+    }
+
+    return false;
+  }
+
+  static std::string toString(const Constant& constant) {
+    switch (constant.type) {
+      case ConstantType::Integer: return std::to_string(constant.integerValue);
+      case ConstantType::Float: return std::to_string(constant.floatValue);
+      case ConstantType::String: return constant.stringValue;
+      case ConstantType::Boolean: return constant.booleanValue ? "true" : "false";
+      case ConstantType::Undefined: return "undefined";
+    }
+
+    return "";
+  }
+
+  static std::string typeName(const Constant& constant) {
+    switch (constant.type) {
+      case ConstantType::Integer: return "integer";
+      case ConstantType::Float: return "float";
+      case ConstantType::String: return "string";
+      case ConstantType::Boolean: return "boolean";
+      case ConstantType::Undefined: return "undefined";
+    }
+
+    return "";
+  }
+
+  // arithmetic wraps like the runtime's int64 operations do in practice
+  static std::optional<Constant> arithmetic(ByteCodeInstruction op, const Constant& first, const Constant& second) {
+    if (first.type != second.type) {
+      return undefined();
+    }
+
+    if (first.type == ConstantType::Integer) {
+      auto a = static_cast<std::uint64_t>(first.integerValue);
+      auto b = static_cast<std::uint64_t>(second.integerValue);
+
+      switch (op) {
+        case ByteCodeInstruction::Add: return integer(static_cast<std::int64_t>(a + b));
+        case ByteCodeInstruction::Subtract: return integer(static_cast<std::int64_t>(a - b));
+        case ByteCodeInstruction::Multiply: return integer(static_cast<std::int64_t>(a * b));
+        default:
+          if (second.integerValue == 0) {
+            return undefined();
+          }
+          // wraps around like the runtime does for the most negative number
+          if (second.integerValue == -1) {
+            return integer(static_cast<std::int64_t>(0 - a));
+          }
+          return integer(first.integerValue / second.integerValue);
+      }
+    }
+
+    if (first.type == ConstantType::Float) {
+      Constant constant;
+      constant.type = ConstantType::Float;
+
+      switch (op) {
+        case ByteCodeInstruction::Add: constant.floatValue = first.floatValue + second.floatValue; break;
+        case ByteCodeInstruction::Subtract: constant.floatValue = first.floatValue - second.floatValue; break;
+        case ByteCodeInstruction::Multiply: constant.floatValue = first.floatValue * second.floatValue; break;
+        default: constant.floatValue = first.floatValue / second.floatValue; break;
+      }
+
+      // the C backend can not spell infinities or NaN as constants
+      if (!std::isfinite(constant.floatValue)) {
+        return std::nullopt;
+      }
+
+      return constant;
+    }
+
+    return undefined();
+  }
+
+  static Constant comparison(ByteCodeInstruction op, const Constant& first, const Constant& second) {
+    if (first.type != second.type || (first.type != ConstantType::Integer && first.type != ConstantType::Float)) {
+      return undefined();
+    }
+
+    auto compare = [op](auto a, auto b) {
+      switch (op) {
+        case ByteCodeInstruction::Less: return a < b;
+        case ByteCodeInstruction::LessOrEqual: return a <= b;
+        case ByteCodeInstruction::Greater: return a > b;
+        default: return a >= b;
+      }
+    };
+
+    if (first.type == ConstantType::Integer) {
+      return boolean(compare(first.integerValue, second.integerValue));
+    }
+
+    return boolean(compare(first.floatValue, second.floatValue));
+  }
+
+  // quickened forms behave like the generic instruction once their guard is
+  // taken into account, so they fold the same way
+  static ByteCodeInstruction generic(ByteCodeInstruction op) {
+    switch (op) {
+      case ByteCodeInstruction::AddIntInt:
+      case ByteCodeInstruction::AddFloatFloat:
+        return ByteCodeInstruction::Add;
+      case ByteCodeInstruction::SubtractIntInt:
+      case ByteCodeInstruction::SubtractFloatFloat:
+        return ByteCodeInstruction::Subtract;
+      case ByteCodeInstruction::MultiplyIntInt:
+      case ByteCodeInstruction::MultiplyFloatFloat:
+        return ByteCodeInstruction::Multiply;
+      case ByteCodeInstruction::DivideIntInt:
+      case ByteCodeInstruction::DivideFloatFloat:
+        return ByteCodeInstruction::Divide;
+      case ByteCodeInstruction::LessIntInt:
+      case ByteCodeInstruction::LessFloatFloat:
+        return ByteCodeInstruction::Less;
+      case ByteCodeInstruction::LessOrEqualIntInt:
+      case ByteCodeInstruction::LessOrEqualFloatFloat:
+        return ByteCodeInstruction::LessOrEqual;
+      case ByteCodeInstruction::GreaterIntInt:
+      case ByteCodeInstruction::GreaterFloatFloat:
+        return ByteCodeInstruction::Greater;
+      case ByteCodeInstruction::GreaterOrEqualIntInt:
+      case ByteCodeInstruction::GreaterOrEqualFloatFloat:
+        return ByteCodeInstruction::GreaterOrEqual;
+      default:
+        return op;
+    }
+  }
+
+  static std::optional<Constant> evaluate(ByteCodeInstruction op, const std::vector<Constant>& operands) {
+    switch (generic(op)) {
+      case ByteCodeInstruction::Add:
+      case ByteCodeInstruction::Subtract:
+      case ByteCodeInstruction::Multiply:
+      case ByteCodeInstruction::Divide:
+        return arithmetic(generic(op), operands.at(0), operands.at(1));
+
+      case ByteCodeInstruction::Less:
+      case ByteCodeInstruction::LessOrEqual:
+      case ByteCodeInstruction::Greater:
+      case ByteCodeInstruction::GreaterOrEqual:
+        return comparison(generic(op), operands.at(0), operands.at(1));
+
+      case ByteCodeInstruction::Equal:
+        return boolean(isEqual(operands.at(0), operands.at(1)));
+
+      case ByteCodeInstruction::NotEqual:
+        return boolean(!isEqual(operands.at(0), operands.at(1)));
+
+      case ByteCodeInstruction::Not:
+        return boolean(!isTruthy(operands.at(0)));
+
+      case ByteCodeInstruction::And:
+        return boolean(isTruthy(operands.at(0)) && isTruthy(operands.at(1)));
+
+      case ByteCodeInstruction::Or:
+        return boolean(isTruthy(operands.at(0)) || isTruthy(operands.at(1)));
+
+      case ByteCodeInstruction::StringAppend:
+        return string(toString(operands.at(0)) + toString(operands.at(1)));
+
+      case ByteCodeInstruction::Length:
+        if (operands.at(0).type != ConstantType::String) {
+          return undefined();
+        }
+        return integer(static_cast<std::int64_t>(operands.at(0).stringValue.size()));
+
+      case ByteCodeInstruction::GetType:
+        return string(typeName(operands.at(0)));
+
+      default:
+        return std::nullopt;
+    }
+  }
+
+  bool foldInstruction(ir::Function& fn, ir::ValueId id, const std::unordered_set<std::size_t>& knownGlobals) {
+    auto& instruction = fn.values.at(id);
+
+    if (instruction.kind != ir::InstructionKind::Operation) {
+      return false;
+    }
+
+    if (instruction.op == ByteCodeInstruction::LoadGlobal) {
+      auto find = this->constantGlobals.find(instruction.parameter);
+
+      if (find == this->constantGlobals.end() || knownGlobals.count(instruction.parameter) == 0) {
+        return false;
+      }
+
+      this->replaceWithConstant(instruction, find->second);
+      return true;
+    }
+
+    std::vector<Constant> operands;
+
+    for (auto operand : instruction.operands) {
+      auto constant = this->constantOf(fn.values.at(operand));
+      if (!constant) {
+        return false;
+      }
+      operands.push_back(std::move(constant.value()));
+    }
+
+    if (operands.empty()) {
+      return false;
+    }
+
+    auto result = evaluate(instruction.op, operands);
+
+    if (!result) {
+      return false;
+    }
+
+    this->replaceWithConstant(instruction, result.value());
+    return true;
+  }
+
+  // a phi that merges the same constant from every side is that constant
+  bool foldPhi(ir::Function& fn, ir::BlockId block, std::size_t index) {
+    ir::ValueId id = fn.blocks.at(block).instructions.at(index);
+    const auto& operands = fn.values.at(id).operands;
+
+    if (operands.empty()) {
+      return false;
+    }
+
+    auto first = this->constantOf(fn.values.at(operands.at(0)));
+
+    for (auto operand : operands) {
+      auto constant = this->constantOf(fn.values.at(operand));
+      if (!first || !constant || constant->type != first->type || !isEqual(constant.value(), first.value())) {
+        return false;
+      }
+      // isEqual says 0.0 equals -0.0
+      if (first->type == ConstantType::Float && std::signbit(constant->floatValue) != std::signbit(first->floatValue)) {
+        return false;
+      }
+    }
+
+    std::size_t phiCount = 0;
+    for (auto instruction : fn.blocks.at(block).instructions) {
+      if (fn.values.at(instruction).kind != ir::InstructionKind::Phi) {
+        break;
+      }
+      phiCount++;
+    }
+
+    ir::ValueId constant = fn.insert(block, phiCount, ir::Instruction{
+      ir::InstructionKind::Operation, ByteCodeInstruction::NoOp, 0, {}, true, block});
+
+    this->replaceWithConstant(fn.values.at(constant), first.value());
+    fn.replaceAllUses(id, constant);
+    fn.remove(id);
+    return true;
+  }
+
+  // the first block of the script runs once, before anything else, so a
+  // global it stores a constant in that is never written again keeps it
+  void recordGlobal(ir::Function& fn, ir::ValueId id, std::unordered_set<std::size_t>& knownGlobals, bool& hasCalls) {
+    const auto& instruction = fn.values.at(id);
+
+    if (instruction.op == ByteCodeInstruction::Invoke || instruction.op == ByteCodeInstruction::CallKnown) {
+      hasCalls = true;
+      return;
+    }
+
+    if (instruction.op != ByteCodeInstruction::SetGlobal
+      || instruction.parameter >= this->globalWrites.size()
+      || this->globalWrites.at(instruction.parameter) != 1) {
+      return;
+    }
+
+    auto constant = this->constantOf(fn.values.at(instruction.operands.at(0)));
+
+    if (!constant) {
+      return;
+    }
+
+    this->constantGlobals.insert(std::make_pair(instruction.parameter, constant.value()));
+    this->scriptGlobals.insert(instruction.parameter);
+    knownGlobals.insert(instruction.parameter);
+
+    if (!hasCalls) {
+      this->beforeCallGlobals.insert(instruction.parameter);
+    }
+  }
+
+public:
+  explicit ConstantFolder(Program& program)
+  : program{program}
+  , globalWrites(program.globalsCount, 0)
+  {
+    program.forEachFunction([this](FunctionBody& fn) {
+      for (const auto& bc : fn.byteCode) {
+        if (bc.instruction == ByteCodeInstruction::SetGlobal && bc.parameter < this->globalWrites.size()) {
+          this->globalWrites.at(bc.parameter)++;
+        }
+      }
+    });
+  }
+
+  bool fold(ir::Function& fn) {
+    bool changed = false;
+    bool isFolding = true;
+
+    while (isFolding) {
+      isFolding = false;
+
+      for (ir::BlockId block = 0; block < fn.blocks.size(); block++) {
+        bool isFirstBlock = fn.isEntrypoint && block == 1 && fn.blocks.at(block).predecessors.size() == 1;
+        // the first block dominates the rest of the script, inside it only
+        // loads after the store see the constant
+        std::unordered_set<std::size_t> firstBlockGlobals;
+        bool hasCalls = false;
+        const auto& knownGlobals = isFirstBlock
+          ? firstBlockGlobals
+          : fn.isEntrypoint ? this->scriptGlobals : this->beforeCallGlobals;
+
+        for (std::size_t i = 0; i < fn.blocks.at(block).instructions.size(); i++) {
+          ir::ValueId id = fn.blocks.at(block).instructions.at(i);
+
+          if (fn.values.at(id).kind == ir::InstructionKind::Phi) {
+            isFolding = this->foldPhi(fn, block, i) || isFolding;
+            continue;
+          }
+
+          isFolding = this->foldInstruction(fn, id, knownGlobals) || isFolding;
+
+          if (isFirstBlock && fn.values.at(id).kind == ir::InstructionKind::Operation) {
+            this->recordGlobal(fn, id, firstBlockGlobals, hasCalls);
+          }
+        }
+      }
+
+      changed = changed || isFolding;
+    }
+
+    return changed;
+  }
+};
+
+bool foldConstants(Program& program) {
+  ConstantFolder folder{program};
+
+  // the entrypoint comes first, so functions see the globals it made constant
+  return ir::transform(program, [&folder](ir::Function& fn) {
+    return folder.fold(fn);
+  });
+}
+
+};
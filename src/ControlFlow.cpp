@@ -0,0 +1,309 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+class ControlFlowSimplifier {
+private:
+  ir::Function& fn;
+
+  bool hasPhis(ir::BlockId block) const {
+    const auto& instructions = this->fn.blocks.at(block).instructions;
+    return !instructions.empty() && this->fn.values.at(instructions.front()).kind == ir::InstructionKind::Phi;
+  }
+
+  // truthiness of a constant the way JumpIfFalse sees it
+  std::optional<bool> constantCondition(ir::ValueId value) const {
+    const auto& instruction = this->fn.values.at(value);
+
+    if (instruction.kind != ir::InstructionKind::Operation) {
+      return std::nullopt;
+    }
+
+    switch (instruction.op) {
+      case ByteCodeInstruction::LoadIntegerConstant:
+      case ByteCodeInstruction::LoadFloatConstant:
+      case ByteCodeInstruction::LoadStringConstant:
+      case ByteCodeInstruction::LoadBooleanTrueConstant:
+        return true;
+      case ByteCodeInstruction::LoadBooleanFalseConstant:
+      case ByteCodeInstruction::LoadUndefinedConstant:
+        return false;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  void jumpTo(ir::BlockId block, std::size_t successor) {
+    auto& terminator = this->fn.blocks.at(block).terminator;
+    this->fn.removeEdge(block, 1 - successor);
+    terminator.kind = ir::TerminatorKind::Jump;
+    terminator.value = std::nullopt;
+  }
+
+  bool foldBranches() {
+    bool changed = false;
+
+    for (ir::BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      const auto& terminator = this->fn.blocks.at(block).terminator;
+
+      if (terminator.kind != ir::TerminatorKind::Branch) {
+        continue;
+      }
+
+      auto condition = this->constantCondition(terminator.value.value());
+
+      if (condition) {
+        this->jumpTo(block, condition.value() ? 0 : 1);
+        changed = true;
+      } else if (terminator.successors.at(0) == terminator.successors.at(1)) {
+        // both ways lead to the same place
+        this->jumpTo(block, 0);
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+  std::vector<bool> reachable() const {
+    std::vector<bool> isReachable(this->fn.blocks.size(), false);
+    std::vector<ir::BlockId> work{0};
+    isReachable.at(0) = true;
+
+    while (!work.empty()) {
+      ir::BlockId block = work.back();
+      work.pop_back();
+
+      for (auto successor : this->fn.blocks.at(block).terminator.successors) {
+        if (!isReachable.at(successor)) {
+          isReachable.at(successor) = true;
+          work.push_back(successor);
+        }
+      }
+    }
+
+    return isReachable;
+  }
+
+  // a block whose only predecessor jumps straight to it becomes part of it
+  bool mergeBlocks() {
+    bool changed = false;
+
+    for (ir::BlockId block = 1; block < this->fn.blocks.size(); block++) {
+      auto& b = this->fn.blocks.at(block);
+
+      while (b.terminator.kind == ir::TerminatorKind::Jump) {
+        ir::BlockId successor = b.terminator.successors.at(0);
+        auto& s = this->fn.blocks.at(successor);
+
+        if (successor == block || successor == 0 || s.predecessors.size() != 1) {
+          break;
+        }
+
+        // phis with a single operand are that operand
+        while (this->hasPhis(successor)) {
+          ir::ValueId phi = s.instructions.front();
+          this->fn.replaceAllUses(phi, this->fn.values.at(phi).operands.at(0));
+          this->fn.remove(phi);
+        }
+
+        for (auto id : s.instructions) {
+          this->fn.values.at(id).block = block;
+          b.instructions.push_back(id);
+        }
+
+        for (auto next : s.terminator.successors) {
+          auto& predecessors = this->fn.blocks.at(next).predecessors;
+          std::replace(predecessors.begin(), predecessors.end(), successor, block);
+        }
+
+        b.terminator = std::move(s.terminator);
+        s.instructions.clear();
+        s.predecessors.clear();
+        s.terminator = ir::Terminator{ir::TerminatorKind::Halt, std::nullopt, {}};
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+  // edges into an empty block that just jumps on go to its target directly
+  bool threadJumps() {
+    bool changed = false;
+
+    for (ir::BlockId block = 1; block < this->fn.blocks.size(); block++) {
+      auto& b = this->fn.blocks.at(block);
+
+      if (!b.instructions.empty() || b.predecessors.empty()) {
+        continue;
+      }
+
+      if (b.terminator.kind == ir::TerminatorKind::Return || b.terminator.kind == ir::TerminatorKind::Halt) {
+        changed = this->duplicateExit(block) || changed;
+        continue;
+      }
+
+      if (b.terminator.kind != ir::TerminatorKind::Jump || b.terminator.successors.at(0) == block) {
+        continue;
+      }
+
+      ir::BlockId target = b.terminator.successors.at(0);
+      bool targetHasPhis = this->hasPhis(target);
+
+      for (std::size_t i = 0; i < b.predecessors.size();) {
+        ir::BlockId predecessor = b.predecessors.at(i);
+        auto& successors = this->fn.blocks.at(predecessor).terminator.successors;
+
+        // a second edge from one block into phis could need other operands
+        if (targetHasPhis && (std::count(successors.begin(), successors.end(), block) != 1
+          || std::find(successors.begin(), successors.end(), target) != successors.end())) {
+          i++;
+          continue;
+        }
+
+        std::size_t k = static_cast<std::size_t>(std::find(successors.begin(), successors.end(), block) - successors.begin());
+        std::size_t index = this->fn.predecessorIndex(block, 0);
+
+        // the value the phi gets from block was available in block's
+        // predecessor already, block defines nothing
+        for (auto id : this->fn.blocks.at(target).instructions) {
+          auto& phi = this->fn.values.at(id);
+          if (phi.kind != ir::InstructionKind::Phi) {
+            break;
+          }
+          phi.operands.push_back(phi.operands.at(index));
+        }
+
+        b.predecessors.erase(b.predecessors.begin() + static_cast<std::ptrdiff_t>(i));
+        this->fn.blocks.at(target).predecessors.push_back(predecessor);
+        successors.at(k) = target;
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+  // a jump to a block that only returns or halts returns or halts itself
+  bool duplicateExit(ir::BlockId block) {
+    auto& b = this->fn.blocks.at(block);
+    bool changed = false;
+
+    for (std::size_t i = 0; i < b.predecessors.size();) {
+      ir::BlockId predecessor = b.predecessors.at(i);
+      auto& terminator = this->fn.blocks.at(predecessor).terminator;
+
+      if (terminator.kind != ir::TerminatorKind::Jump) {
+        i++;
+        continue;
+      }
+
+      b.predecessors.erase(b.predecessors.begin() + static_cast<std::ptrdiff_t>(i));
+      terminator = b.terminator;
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  bool removeUnreachableBlocks() {
+    auto isReachable = this->reachable();
+
+    if (std::find(isReachable.begin(), isReachable.end(), false) == isReachable.end()) {
+      return false;
+    }
+
+    for (ir::BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      if (isReachable.at(block)) {
+        continue;
+      }
+
+      auto& successors = this->fn.blocks.at(block).terminator.successors;
+      while (!successors.empty()) {
+        this->fn.removeEdge(block, successors.size() - 1);
+      }
+    }
+
+    std::vector<ir::BlockId> order;
+    for (ir::BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      if (isReachable.at(block)) {
+        order.push_back(block);
+      }
+    }
+
+    this->fn.reorder(order);
+    return true;
+  }
+
+  // chains blocks so a jump's target and a branch's true side come right
+  // after it, where lowering lets them fall through
+  bool layout() {
+    std::size_t size = this->fn.blocks.size();
+    std::vector<bool> isPlaced(size, false);
+    std::vector<ir::BlockId> order;
+
+    for (ir::BlockId start = 0; start < size; start++) {
+      std::optional<ir::BlockId> block = start;
+
+      while (block && !isPlaced.at(block.value())) {
+        isPlaced.at(block.value()) = true;
+        order.push_back(block.value());
+
+        const auto& successors = this->fn.blocks.at(block.value()).terminator.successors;
+        block = std::nullopt;
+
+        for (auto successor : successors) {
+          if (!isPlaced.at(successor)) {
+            block = successor;
+            break;
+          }
+        }
+      }
+    }
+
+    bool isSorted = true;
+    for (ir::BlockId i = 0; i < order.size(); i++) {
+      isSorted = isSorted && order.at(i) == i;
+    }
+
+    if (isSorted) {
+      return false;
+    }
+
+    this->fn.reorder(order);
+    return true;
+  }
+
+public:
+  explicit ControlFlowSimplifier(ir::Function& fn)
+  : fn{fn}
+  {}
+
+  bool simplify() {
+    bool changed = false;
+    bool isSimplifying = true;
+
+    while (isSimplifying) {
+      isSimplifying = this->foldBranches();
+      isSimplifying = this->removeUnreachableBlocks() || isSimplifying;
+      isSimplifying = this->mergeBlocks() || isSimplifying;
+      isSimplifying = this->threadJumps() || isSimplifying;
+      changed = changed || isSimplifying;
+    }
+
+    this->removeUnreachableBlocks();
+    return this->layout() || changed;
+  }
+};
+
+bool simplifyControlFlow(Program& program) {
+  return ir::transform(program, [](ir::Function& fn) {
+    return ControlFlowSimplifier{fn}.simplify();
+  });
+}
+
+};
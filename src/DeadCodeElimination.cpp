@@ -0,0 +1,88 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+// a value is dead when nothing uses it and computing it has no effect, removing
+// one can make its operands dead too
+static bool removeDeadValues(ir::Function& fn, const std::vector<std::size_t>& globalLoads) {
+  auto uses = fn.useCounts();
+  std::vector<ir::ValueId> work;
+
+  auto isDead = [&fn, &uses, &globalLoads](ir::ValueId id) {
+    const auto& instruction = fn.values.at(id);
+
+    switch (instruction.kind) {
+      case ir::InstructionKind::Phi:
+        return uses.at(id) == 0;
+
+      case ir::InstructionKind::Operation:
+        // stores to a global nothing ever reads
+        if (instruction.op == ByteCodeInstruction::SetGlobal) {
+          return instruction.parameter < globalLoads.size() && globalLoads.at(instruction.parameter) == 0;
+        }
+        return uses.at(id) == 0 && !ir::hasSideEffects(instruction.op);
+
+      default:
+        return false;
+    }
+  };
+
+  for (ir::ValueId id = 0; id < fn.values.size(); id++) {
+    if (isDead(id)) {
+      work.push_back(id);
+    }
+  }
+
+  bool changed = false;
+
+  while (!work.empty()) {
+    ir::ValueId id = work.back();
+    work.pop_back();
+
+    if (fn.values.at(id).kind == ir::InstructionKind::Removed) {
+      continue;
+    }
+
+    auto operands = fn.values.at(id).operands;
+    fn.remove(id);
+    changed = true;
+
+    for (auto operand : operands) {
+      uses.at(operand)--;
+      if (isDead(operand)) {
+        work.push_back(operand);
+      }
+    }
+  }
+
+  return changed;
+}
+
+bool eliminateDeadCode(Program& program) {
+  std::vector<std::size_t> globalLoads(program.globalsCount, 0);
+
+  program.forEachFunction([&globalLoads](FunctionBody& fn) {
+    for (const auto& bc : fn.byteCode) {
+      if (bc.instruction == ByteCodeInstruction::LoadGlobal && bc.parameter < globalLoads.size()) {
+        globalLoads.at(bc.parameter)++;
+      }
+    }
+  });
+
+  return ir::transform(program, [&globalLoads](ir::Function& fn) {
+    bool changed = removeDeadValues(fn, globalLoads);
+
+    // lowering packs the slots it needs at the bottom of the frame, so a
+    // function with plain locals comes back with a smaller frame
+    for (std::size_t i = fn.argumentCount; i < fn.localsCount && !changed; i++) {
+      changed = !fn.isCaptured.at(i);
+    }
+
+    return changed;
+  });
+}
+
+};
@@ -0,0 +1,260 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+class Inliner {
+private:
+  Program& program;
+  std::size_t budget;
+  // a callee qualifies when it is small, can not reach itself through
+  // CallKnown, and keeps nothing in its frame a nested function reads
+  std::vector<bool> isInlinable;
+
+  // the CallKnown graph, function i calls every function in calls[i]
+  std::vector<std::vector<std::size_t>> callGraph() const {
+    std::vector<std::vector<std::size_t>> calls(this->program.functions.size());
+
+    for (std::size_t i = 0; i < this->program.functions.size(); i++) {
+      for (const auto& bc : this->program.functions.at(i).byteCode) {
+        if (bc.instruction == ByteCodeInstruction::CallKnown && bc.parameter < calls.size()) {
+          calls.at(i).push_back(bc.parameter);
+        }
+      }
+    }
+
+    return calls;
+  }
+
+  static bool isRecursive(const std::vector<std::vector<std::size_t>>& calls, std::size_t fn) {
+    std::vector<bool> isVisited(calls.size(), false);
+    std::vector<std::size_t> work{calls.at(fn)};
+
+    while (!work.empty()) {
+      std::size_t next = work.back();
+      work.pop_back();
+
+      if (next == fn) {
+        return true;
+      }
+
+      if (isVisited.at(next)) {
+        continue;
+      }
+
+      isVisited.at(next) = true;
+      work.insert(work.end(), calls.at(next).begin(), calls.at(next).end());
+    }
+
+    return false;
+  }
+
+  // moves everything after index into a new block that takes over the
+  // terminator and the outgoing edges of block
+  ir::BlockId splitAfter(ir::Function& fn, ir::BlockId block, std::size_t index) {
+    ir::BlockId rest = fn.blocks.size();
+    fn.blocks.emplace_back();
+
+    auto& b = fn.blocks.at(block);
+    auto& r = fn.blocks.at(rest);
+    auto split = b.instructions.begin() + static_cast<std::ptrdiff_t>(index + 1);
+
+    r.instructions.assign(split, b.instructions.end());
+    b.instructions.erase(split, b.instructions.end());
+
+    for (auto id : r.instructions) {
+      fn.values.at(id).block = rest;
+    }
+
+    r.terminator = std::move(b.terminator);
+    r.predecessors = {block};
+    b.terminator = ir::Terminator{ir::TerminatorKind::Jump, std::nullopt, {}};
+
+    for (auto successor : r.terminator.successors) {
+      auto& predecessors = fn.blocks.at(successor).predecessors;
+      std::replace(predecessors.begin(), predecessors.end(), block, rest);
+    }
+
+    return rest;
+  }
+
+  // replaces the call with a copy of the callee's blocks, every return jumps
+  // to the code that followed the call and the result becomes a phi there
+  bool inlineCall(ir::Function& fn, ir::ValueId call) {
+    const auto& body = this->program.functions.at(fn.values.at(call).parameter);
+
+    // the callee may have grown from inlining into it earlier in this run
+    if (body.byteCode.size() > this->budget) {
+      return false;
+    }
+
+    auto callee = ir::build(body, this->program, std::vector<bool>(body.localsCount, false));
+
+    if (!callee) {
+      return false;
+    }
+
+    bool hasReturn = false;
+    for (const auto& block : callee->blocks) {
+      if (block.terminator.kind == ir::TerminatorKind::Halt) {
+        return false;
+      }
+      hasReturn = hasReturn || block.terminator.kind == ir::TerminatorKind::Return;
+    }
+
+    if (!hasReturn) {
+      return false;
+    }
+
+    ir::BlockId block = fn.values.at(call).block;
+    const auto& instructions = fn.blocks.at(block).instructions;
+    std::size_t index = static_cast<std::size_t>(std::find(instructions.begin(), instructions.end(), call) - instructions.begin());
+    ir::BlockId rest = this->splitAfter(fn, block, index);
+    ir::BlockId base = fn.blocks.size();
+    auto arguments = fn.values.at(call).operands;
+
+    fn.blocks.resize(base + callee->blocks.size());
+
+    // ids first, phis can refer to values further down
+    std::vector<ir::ValueId> newId(callee->values.size());
+
+    for (ir::BlockId b = 0; b < callee->blocks.size(); b++) {
+      for (auto id : callee->blocks.at(b).instructions) {
+        const auto& instruction = callee->values.at(id);
+
+        if (instruction.kind == ir::InstructionKind::Parameter) {
+          newId.at(id) = arguments.at(instruction.parameter);
+        } else {
+          newId.at(id) = fn.add(base + b, instruction);
+        }
+      }
+    }
+
+    for (ir::BlockId b = 0; b < callee->blocks.size(); b++) {
+      const auto& from = callee->blocks.at(b);
+      auto& to = fn.blocks.at(base + b);
+
+      for (auto id : to.instructions) {
+        auto& operands = fn.values.at(id).operands;
+        std::transform(operands.begin(), operands.end(), operands.begin(), [&newId](ir::ValueId operand) {
+          return newId.at(operand);
+        });
+      }
+
+      for (auto predecessor : from.predecessors) {
+        to.predecessors.push_back(base + predecessor);
+      }
+
+      if (from.terminator.kind == ir::TerminatorKind::Return) {
+        to.terminator = ir::Terminator{ir::TerminatorKind::Jump, std::nullopt, {rest}};
+        continue;
+      }
+
+      to.terminator = from.terminator;
+      if (to.terminator.value) {
+        to.terminator.value = newId.at(to.terminator.value.value());
+      }
+      for (auto& successor : to.terminator.successors) {
+        successor += base;
+      }
+    }
+
+    fn.blocks.at(block).terminator.successors = {base};
+    fn.blocks.at(base).predecessors = {block};
+
+    // the block after the call is now entered from the returns
+    std::vector<ir::ValueId> results;
+    auto& r = fn.blocks.at(rest);
+    r.predecessors.clear();
+
+    for (ir::BlockId b = 0; b < callee->blocks.size(); b++) {
+      const auto& terminator = callee->blocks.at(b).terminator;
+      if (terminator.kind == ir::TerminatorKind::Return) {
+        r.predecessors.push_back(base + b);
+        results.push_back(newId.at(terminator.value.value()));
+      }
+    }
+
+    ir::ValueId result = results.front();
+
+    if (results.size() > 1) {
+      result = fn.insert(rest, 0, ir::Instruction{
+        ir::InstructionKind::Phi, ByteCodeInstruction::NoOp, 0, std::move(results), true, rest});
+    }
+
+    fn.replaceAllUses(call, result);
+    fn.remove(call);
+    return true;
+  }
+
+public:
+  Inliner(Program& program, std::size_t budget)
+  : program{program}
+  , budget{budget}
+  , isInlinable(program.functions.size(), false)
+  {
+    auto calls = this->callGraph();
+    auto captured = ir::capturedLocals(program);
+
+    for (std::size_t i = 0; i < program.functions.size(); i++) {
+      const auto& fn = program.functions.at(i);
+      const auto& isCaptured = captured.at(i + 1);
+
+      this->isInlinable.at(i) = fn.byteCode.size() <= budget
+        && fn.closures.empty()
+        && std::find(isCaptured.begin(), isCaptured.end(), true) == isCaptured.end()
+        && !isRecursive(calls, i);
+    }
+  }
+
+  bool inlineCalls(ir::Function& fn) {
+    // only the calls that were there to begin with, so inlining stays one
+    // level deep per run and a caller grows by at most budget per call
+    std::vector<ir::ValueId> calls;
+
+    for (const auto& block : fn.blocks) {
+      for (auto id : block.instructions) {
+        const auto& instruction = fn.values.at(id);
+        if (instruction.kind == ir::InstructionKind::Operation
+          && instruction.op == ByteCodeInstruction::CallKnown
+          && instruction.parameter < this->isInlinable.size()
+          && this->isInlinable.at(instruction.parameter)) {
+          calls.push_back(id);
+        }
+      }
+    }
+
+    bool changed = false;
+
+    for (auto call : calls) {
+      changed = this->inlineCall(fn, call) || changed;
+    }
+
+    return changed;
+  }
+};
+
+// calls that came in with an inlined body are inlined by the next round, so a
+// factory called from a small helper still ends up next to its caller's reads
+constexpr std::size_t inlineRounds = 3;
+
+bool inlineFunctions(Program& program, std::size_t budget) {
+  bool changed = false;
+  bool isInlining = true;
+
+  for (std::size_t round = 0; round < inlineRounds && isInlining; round++) {
+    Inliner inliner{program, budget};
+
+    isInlining = ir::transform(program, [&inliner](ir::Function& fn) {
+      return inliner.inlineCalls(fn);
+    });
+
+    changed = changed || isInlining;
+  }
+
+  return changed;
+}
+
+};
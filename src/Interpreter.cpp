@@ -1,4 +1,18 @@
 #include "Interpreter.hpp"
+#include "Sha256.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FLANG_GETPID_SUPPORTED 1
+#include <unistd.h>
+#else
+#define FLANG_GETPID_SUPPORTED 0
+#endif
 
 std::shared_ptr<ScriptAstNode> parseScript(std::ostream & out, const std::string & data) {
   auto reader = std::make_shared<StringReader>(data);
@@ -23,15 +37,258 @@ std::shared_ptr<ScriptAstNode> parseScript(std::ostream & out, const std::string
   return script;
 }
 
-std::shared_ptr<bytecode::CompiledFile> compile(std::shared_ptr<ScriptAstNode> script) {
+// parses, checks, compiles and optimizes a script
+std::shared_ptr<bytecode::CompiledFile> interpreter::Interpreter::Compile(const std::string & data) {
+  std::shared_ptr<ScriptAstNode> script = parseScript(this->out, data);
+
   auto compiler = std::make_shared<compiler::AstCompiler>();
-  return compiler->compile(std::move(script));
+  auto compiledFile = compiler->compile(std::move(script));
+
+  auto passManager = compiler::PassManager::withDefaultPasses(this->options.optimizationLevel, this->options.inlineBudget);
+  compiledFile = passManager.run(std::move(compiledFile));
+
+  if (this->options.isPassTimingEnabled) {
+    passManager.printTimings(std::cerr);
+  }
+
+  return compiledFile;
+}
+
+static const char cacheEntryMagic[8] = {'F', 'L', 'A', 'N', 'G', 'C', 'E', '\0'};
+
+// what a cache entry starts with, the bytecode file follows
+class CacheEntryHeader {
+public:
+  std::uint64_t sourceLength;
+  interpreter::Sha256Digest digest;
+};
+
+// SHA-256 over the compiler version, the pass options and the source
+static interpreter::Sha256Digest cacheDigest(const std::string & data, const interpreter::Options & options) {
+  std::string input;
+
+  for (std::size_t i = 0; i < sizeof(compiler::compilerVersion); i++) {
+    input.push_back(static_cast<char>(compiler::compilerVersion >> (8 * i)));
+  }
+
+  input.push_back(static_cast<char>(options.optimizationLevel));
+
+  for (std::size_t i = 0; i < sizeof(options.inlineBudget); i++) {
+    input.push_back(static_cast<char>(options.inlineBudget >> (8 * i)));
+  }
+
+  input += data;
+  return interpreter::sha256(input);
+}
+
+static std::string cacheKey(const interpreter::Sha256Digest & digest) {
+  std::ostringstream key;
+
+  for (auto byte : digest) {
+    key << std::hex << std::setw(2) << std::setfill('0') << static_cast<unsigned int>(byte);
+  }
+
+  return key.str();
+}
+
+// the entry only counts when it was written for the same source and
+// options, a file that merely has the right name is a miss
+static std::shared_ptr<bytecode::CompiledFile> loadCacheEntry(const std::string & path, const CacheEntryHeader & expected) {
+  std::ifstream in{path, std::ios::binary};
+
+  if (in.fail()) {
+    return nullptr;
+  }
+
+  std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  std::size_t headerSize = sizeof(cacheEntryMagic) + sizeof(expected.sourceLength) + expected.digest.size();
+
+  if (data.size() < headerSize || std::memcmp(data.data(), cacheEntryMagic, sizeof(cacheEntryMagic)) != 0) {
+    return nullptr;
+  }
+
+  CacheEntryHeader header{};
+  const char* position = data.data() + sizeof(cacheEntryMagic);
+  std::memcpy(&header.sourceLength, position, sizeof(header.sourceLength));
+  std::memcpy(header.digest.data(), position + sizeof(header.sourceLength), header.digest.size());
+
+  if (header.sourceLength != expected.sourceLength || header.digest != expected.digest) {
+    return nullptr;
+  }
+
+  return bytecode::decodeCompiledFile(reinterpret_cast<const std::uint8_t*>(data.data()) + headerSize, data.size() - headerSize);
+}
+
+static void writeCacheEntry(std::ostream & out, const CacheEntryHeader & header, const bytecode::CompiledFile & file) {
+  out.write(cacheEntryMagic, sizeof(cacheEntryMagic));
+  out.write(reinterpret_cast<const char*>(&header.sourceLength), sizeof(header.sourceLength));
+  out.write(reinterpret_cast<const char*>(header.digest.data()), static_cast<std::streamsize>(header.digest.size()));
+  bytecode::writeCompiledFile(file, out);
+}
+
+// tells the temporary files of concurrent runs apart
+static std::string temporarySuffix() {
+#if FLANG_GETPID_SUPPORTED
+  return std::to_string(getpid());
+#else
+  return std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
 }
 
 void interpreter::Interpreter::Run(const std::string & data) {
 
-  std::shared_ptr<ScriptAstNode> script = parseScript(this->out, data);
-  auto compiledFile = compile(script);
-  auto runtime = std::make_shared<runtime::VirtualMachine>(false, this->out, this->in, std::move(compiledFile));
+  if (this->options.cacheDirectory) {
+    this->RunCompiledFile(this->CompileCached(data));
+    return;
+  }
+
+  this->RunCompiledFile(this->Compile(data));
+}
+
+// an entry that fails to load, say from an older bytecode format or for a
+// different source, counts as a miss and is replaced. misses are written to a temporary file first and
+// renamed into place, so a concurrent run never sees half an entry
+std::shared_ptr<bytecode::CompiledFile> interpreter::Interpreter::CompileCached(const std::string & data) {
+
+  CacheEntryHeader header{data.size(), cacheDigest(data, this->options)};
+  std::filesystem::path directory{this->options.cacheDirectory.value()};
+  std::filesystem::path entry = directory / (cacheKey(header.digest) + ".fbc");
+
+  auto cached = loadCacheEntry(entry.string(), header);
+
+  if (cached != nullptr) {
+    return cached;
+  }
+
+  auto compiledFile = this->Compile(data);
+
+  // the cache is only an optimization, failing to fill it is not an error
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+
+  std::filesystem::path temporary = entry;
+  temporary += ".tmp" + temporarySuffix();
+
+  {
+    std::ofstream file{temporary, std::ios::binary};
+
+    if (file.fail()) {
+      return compiledFile;
+    }
+
+    writeCacheEntry(file, header, *compiledFile);
+    file.close();
+
+    // a short write, say on a full disk, must not become the entry
+    if (!file.good()) {
+      std::filesystem::remove(temporary, error);
+      return compiledFile;
+    }
+  }
+
+  std::filesystem::rename(temporary, entry, error);
+
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+
+  return compiledFile;
+}
+
+void interpreter::Interpreter::RunByteCode(const std::string & path) {
+
+  auto compiledFile = bytecode::loadCompiledFile(path);
+
+  if (compiledFile == nullptr) {
+    this->out << "Could not load bytecode file " << path << std::endl;
+    exit(1);
+  }
+
+  this->RunCompiledFile(std::move(compiledFile));
+}
+
+void interpreter::Interpreter::RunSnapshot(const std::string & path) {
+
+  std::ifstream file{path, std::ios::binary};
+  std::optional<runtime::SnapshotFile> snapshot = std::nullopt;
+
+  if (!file.fail()) {
+    snapshot = runtime::readSnapshot(std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()});
+  }
+
+  if (!snapshot) {
+    this->out << "Could not load snapshot " << path << std::endl;
+    exit(1);
+  }
+
+  this->RunCompiledFile(std::move(snapshot->file), std::move(snapshot->state));
+}
+
+void interpreter::Interpreter::RunCompiledFile(
+  std::shared_ptr<bytecode::CompiledFile> compiledFile,
+  std::optional<std::string> snapshotState
+) {
+
+  auto runtime = std::make_shared<runtime::VirtualMachine>(false, this->options.isJitEnabled, this->options.jitBackend, this->out, this->in, std::move(compiledFile));
+
+  if (snapshotState) {
+    runtime->setSnapshot(std::move(snapshotState.value()));
+  }
+
+  std::unique_ptr<std::ofstream> snapshotOut;
+
+  if (this->options.snapshotPath) {
+    snapshotOut = std::make_unique<std::ofstream>(this->options.snapshotPath.value(), std::ios::binary);
+
+    if (snapshotOut->fail()) {
+      this->out << "Could not open snapshot file " << this->options.snapshotPath.value() << std::endl;
+      exit(1);
+    }
+
+    runtime->setSnapshotOutput(snapshotOut.get());
+  }
+
+  // a missing or unreadable profile just means starting cold
+  if (this->options.profilePath) {
+    std::ifstream profileIn{this->options.profilePath.value()};
+    auto profile = profileIn.fail() ? std::nullopt : runtime::readProfile(profileIn);
+
+    if (profile) {
+      runtime->setProfile(std::move(profile.value()));
+    }
+
+    runtime->setProfileOutput(this->options.profilePath.value());
+  }
+
   runtime->run();
-}
\ No newline at end of file
+  runtime->saveProfile();
+
+  if (snapshotOut != nullptr && !runtime->hasWrittenSnapshot()) {
+    snapshotOut = nullptr;
+    std::remove(this->options.snapshotPath.value().c_str());
+    this->out << "The script finished without reaching snapshot(), no snapshot was written" << std::endl;
+    exit(1);
+  }
+
+  if (this->options.isJitStatisticsEnabled) {
+    runtime->printJitStatistics(std::cerr);
+  }
+}
+
+void interpreter::Interpreter::CompileToC(const std::string & data, std::ostream & c) {
+
+  auto compiledFile = this->Compile(data);
+  auto generator = std::make_shared<compiler::CGenerator>();
+  generator->generate(*compiledFile, c);
+}
+
+void interpreter::Interpreter::CompileToByteCode(const std::string & data, std::ostream & out) {
+
+  auto compiledFile = this->Compile(data);
+  bytecode::writeCompiledFile(*compiledFile, out);
+}
+void interpreter::Interpreter::DumpIr(const std::string & data, std::ostream & ir) {
+
+  auto compiledFile = this->Compile(data);
+  ir::dump(compiler::Program{*compiledFile}, ir);
+}
@@ -0,0 +1,1651 @@
+#include "Ir.hpp"
+#include "Error.hpp"
+
+#include <set>
+
+namespace ir {
+
+using bytecode::ByteCodeInstruction;
+
+ValueId Function::add(BlockId block, Instruction instruction) {
+  ValueId id = this->values.size();
+  instruction.block = block;
+  this->values.push_back(std::move(instruction));
+  this->blocks.at(block).instructions.push_back(id);
+  return id;
+}
+
+ValueId Function::insert(BlockId block, std::size_t index, Instruction instruction) {
+  ValueId id = this->values.size();
+  instruction.block = block;
+  this->values.push_back(std::move(instruction));
+
+  auto& instructions = this->blocks.at(block).instructions;
+  instructions.insert(instructions.begin() + static_cast<std::ptrdiff_t>(index), id);
+  return id;
+}
+
+void Function::remove(ValueId value) {
+  auto& instruction = this->values.at(value);
+  auto& instructions = this->blocks.at(instruction.block).instructions;
+
+  instructions.erase(std::find(instructions.begin(), instructions.end(), value));
+  instruction.kind = InstructionKind::Removed;
+  instruction.operands.clear();
+}
+
+void Function::replaceAllUses(ValueId from, ValueId to) {
+  for (auto& instruction : this->values) {
+    std::replace(instruction.operands.begin(), instruction.operands.end(), from, to);
+  }
+
+  for (auto& block : this->blocks) {
+    if (block.terminator.value == from) {
+      block.terminator.value = to;
+    }
+  }
+}
+
+std::size_t Function::predecessorIndex(BlockId block, std::size_t successor) const {
+  const auto& successors = this->blocks.at(block).terminator.successors;
+  BlockId target = successors.at(successor);
+  // a branch with both edges into one block appears there twice, in edge order
+  std::size_t occurrence = std::count(successors.begin(), successors.begin() + successor, target);
+
+  const auto& predecessors = this->blocks.at(target).predecessors;
+  for (std::size_t i = 0; i < predecessors.size(); i++) {
+    if (predecessors.at(i) == block && occurrence-- == 0) {
+      return i;
+    }
+  }
+
+  Error::assertWithPanic(false, "IR edge is missing from the predecessors of its successor");
+  return 0;
+}
+
+void Function::removeEdge(BlockId block, std::size_t successor) {
+  BlockId target = this->blocks.at(block).terminator.successors.at(successor);
+  std::size_t index = this->predecessorIndex(block, successor);
+  auto& predecessors = this->blocks.at(target).predecessors;
+
+  predecessors.erase(predecessors.begin() + static_cast<std::ptrdiff_t>(index));
+
+  for (auto id : this->blocks.at(target).instructions) {
+    auto& phi = this->values.at(id);
+    if (phi.kind != InstructionKind::Phi) {
+      break;
+    }
+    phi.operands.erase(phi.operands.begin() + static_cast<std::ptrdiff_t>(index));
+  }
+
+  auto& successors = this->blocks.at(block).terminator.successors;
+  successors.erase(successors.begin() + static_cast<std::ptrdiff_t>(successor));
+}
+
+void Function::reorder(const std::vector<BlockId>& order) {
+  std::vector<std::optional<BlockId>> newId(this->blocks.size());
+
+  for (BlockId i = 0; i < order.size(); i++) {
+    newId.at(order.at(i)) = i;
+  }
+
+  auto rename = [&newId](BlockId block) {
+    Error::assertWithPanic(newId.at(block).has_value(), "IR edge into a block that was dropped");
+    return newId.at(block).value();
+  };
+
+  std::vector<Block> blocks;
+  blocks.reserve(order.size());
+
+  for (BlockId block = 0; block < this->blocks.size(); block++) {
+    if (newId.at(block)) {
+      continue;
+    }
+
+    for (auto id : this->blocks.at(block).instructions) {
+      this->values.at(id).kind = InstructionKind::Removed;
+      this->values.at(id).operands.clear();
+    }
+  }
+
+  for (auto block : order) {
+    auto b = std::move(this->blocks.at(block));
+    std::transform(b.terminator.successors.begin(), b.terminator.successors.end(), b.terminator.successors.begin(), rename);
+    std::transform(b.predecessors.begin(), b.predecessors.end(), b.predecessors.begin(), rename);
+
+    for (auto id : b.instructions) {
+      this->values.at(id).block = newId.at(block).value();
+    }
+
+    blocks.push_back(std::move(b));
+  }
+
+  this->blocks = std::move(blocks);
+}
+
+std::vector<BlockId> Function::reversePostOrder() const {
+  std::vector<BlockId> order;
+  std::vector<bool> isVisited(this->blocks.size(), false);
+  std::vector<std::pair<BlockId, std::size_t>> work{{0, 0}};
+  isVisited.at(0) = true;
+
+  while (!work.empty()) {
+    auto& [block, next] = work.back();
+    const auto& successors = this->blocks.at(block).terminator.successors;
+
+    if (next < successors.size()) {
+      BlockId successor = successors.at(next++);
+      if (!isVisited.at(successor)) {
+        isVisited.at(successor) = true;
+        work.emplace_back(successor, 0);
+      }
+      continue;
+    }
+
+    order.push_back(block);
+    work.pop_back();
+  }
+
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder
+std::vector<BlockId> Function::immediateDominators() const {
+  auto order = this->reversePostOrder();
+  std::vector<std::size_t> position(this->blocks.size(), 0);
+  std::vector<std::optional<BlockId>> idom(this->blocks.size());
+
+  for (std::size_t i = 0; i < order.size(); i++) {
+    position.at(order.at(i)) = i;
+  }
+
+  auto intersect = [&position, &idom](BlockId a, BlockId b) {
+    while (a != b) {
+      while (position.at(a) > position.at(b)) {
+        a = idom.at(a).value();
+      }
+      while (position.at(b) > position.at(a)) {
+        b = idom.at(b).value();
+      }
+    }
+    return a;
+  };
+
+  idom.at(0) = 0;
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    for (std::size_t i = 1; i < order.size(); i++) {
+      BlockId block = order.at(i);
+      std::optional<BlockId> dominator;
+
+      for (auto predecessor : this->blocks.at(block).predecessors) {
+        if (!idom.at(predecessor)) {
+          continue;
+        }
+        dominator = dominator ? intersect(predecessor, dominator.value()) : predecessor;
+      }
+
+      if (dominator && idom.at(block) != dominator) {
+        idom.at(block) = dominator;
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<BlockId> result(this->blocks.size());
+  for (BlockId block = 0; block < this->blocks.size(); block++) {
+    result.at(block) = idom.at(block).value_or(block);
+  }
+
+  return result;
+}
+
+bool Function::dominates(const std::vector<BlockId>& idom, BlockId a, BlockId b) {
+  while (b != a && idom.at(b) != b) {
+    b = idom.at(b);
+  }
+  return a == b;
+}
+
+std::vector<std::size_t> Function::useCounts() const {
+  std::vector<std::size_t> uses(this->values.size(), 0);
+
+  for (const auto& instruction : this->values) {
+    for (auto operand : instruction.operands) {
+      uses.at(operand)++;
+    }
+  }
+
+  for (const auto& block : this->blocks) {
+    if (block.terminator.value) {
+      uses.at(block.terminator.value.value())++;
+    }
+  }
+
+  return uses;
+}
+
+static bool isConstantLoad(ByteCodeInstruction op) {
+  switch (op) {
+    case ByteCodeInstruction::LoadIntegerConstant:
+    case ByteCodeInstruction::LoadFloatConstant:
+    case ByteCodeInstruction::LoadStringConstant:
+    case ByteCodeInstruction::LoadUndefinedConstant:
+    case ByteCodeInstruction::LoadBooleanTrueConstant:
+    case ByteCodeInstruction::LoadBooleanFalseConstant:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Effects effectsOf(ByteCodeInstruction op) {
+  switch (op) {
+    case ByteCodeInstruction::LoadGlobal:
+      return Effects{Memory::Global, Memory::None, false, false};
+    case ByteCodeInstruction::LoadLocal:
+      return Effects{Memory::Local, Memory::None, false, false};
+    case ByteCodeInstruction::LoadClosure:
+      return Effects{Memory::Closure, Memory::None, false, false};
+    // the property count of an object
+    case ByteCodeInstruction::Length:
+    case ByteCodeInstruction::ObjectGet:
+      return Effects{Memory::Object, Memory::None, false, false};
+
+    case ByteCodeInstruction::SetGlobal:
+      return Effects{Memory::None, Memory::Global, false, false};
+    case ByteCodeInstruction::SetLocal:
+      return Effects{Memory::None, Memory::Local, false, false};
+    case ByteCodeInstruction::ObjectSet:
+      return Effects{Memory::Object, Memory::Object, false, false};
+
+    // a callee can do anything but assign the caller's locals
+    case ByteCodeInstruction::Invoke:
+    case ByteCodeInstruction::CallKnown:
+      return Effects{Memory::Everything, Memory::Everything, true, false};
+
+    case ByteCodeInstruction::Print:
+    case ByteCodeInstruction::Read:
+    case ByteCodeInstruction::GetEnv:
+    case ByteCodeInstruction::Snapshot:
+    case ByteCodeInstruction::Halt:
+    case ByteCodeInstruction::Return:
+    case ByteCodeInstruction::Jump:
+    case ByteCodeInstruction::JumpIfFalse:
+      return Effects{Memory::None, Memory::None, true, false};
+
+    case ByteCodeInstruction::MakeFn:
+    case ByteCodeInstruction::MakeObj:
+      return Effects{Memory::None, Memory::None, false, true};
+
+    default:
+      return Effects{Memory::None, Memory::None, false, false};
+  }
+}
+
+bool Effects::clobbers(const Instruction& write, const Instruction& read) {
+  auto writes = effectsOf(write.op).writes;
+  auto reads = effectsOf(read.op).reads;
+
+  if (writes == Memory::None || reads == Memory::None) {
+    return false;
+  }
+
+  if (writes == Memory::Everything) {
+    // nothing outside this frame can assign its locals
+    return reads != Memory::Local;
+  }
+
+  if (writes != reads) {
+    return false;
+  }
+
+  // a global or local slot is only clobbered by a store to the same slot
+  return writes == Memory::Object || write.parameter == read.parameter;
+}
+
+bool hasSideEffects(ByteCodeInstruction op) {
+  auto effects = effectsOf(op);
+  return effects.writes != Memory::None || effects.isObservable;
+}
+
+std::vector<std::vector<bool>> capturedLocals(const compiler::Program& program) {
+  // index 0 is the entrypoint, function i is at i + 1
+  std::vector<const compiler::FunctionBody*> bodies{&program.entrypoint};
+  for (const auto& fn : program.functions) {
+    bodies.push_back(&fn);
+  }
+
+  std::vector<std::vector<bool>> captured;
+  std::vector<std::optional<std::size_t>> parent(bodies.size());
+
+  for (std::size_t i = 0; i < bodies.size(); i++) {
+    captured.emplace_back(bodies.at(i)->localsCount, false);
+
+    for (const auto& bc : bodies.at(i)->byteCode) {
+      if (bc.instruction == ByteCodeInstruction::MakeFn && bc.parameter + 1 < bodies.size()) {
+        parent.at(bc.parameter + 1) = i;
+      }
+    }
+  }
+
+  // a closure with scope offset n reads a local of the function n levels up
+  // from the one it is made in
+  for (std::size_t i = 0; i < bodies.size(); i++) {
+    for (const auto& closure : bodies.at(i)->closures) {
+      std::optional<std::size_t> scope = i;
+
+      for (std::size_t level = 0; level < closure.scopeOffsets && scope; level++) {
+        scope = parent.at(scope.value());
+      }
+
+      if (scope && closure.localIndex < captured.at(scope.value()).size()) {
+        captured.at(scope.value()).at(closure.localIndex) = true;
+      }
+    }
+  }
+
+  return captured;
+}
+
+class VariableState {
+public:
+  std::vector<ValueId> locals;
+  std::vector<ValueId> stack;
+};
+
+class FunctionBuilder {
+private:
+  const compiler::FunctionBody& body;
+  const compiler::Program& program;
+  Function fn;
+
+  // bytecode range of every block but the entry
+  std::vector<std::pair<std::size_t, std::size_t>> ranges;
+  std::vector<std::optional<VariableState>> exitStates;
+  // the local, or op stack slot past localsCount, a phi was made for
+  std::unordered_map<ValueId, std::size_t> phiVariables;
+  std::vector<ValueId> initialUndefined;
+
+  std::optional<bytecode::StackEffect> effectOf(const bytecode::ByteCode& bc) {
+    switch (bc.instruction) {
+      case ByteCodeInstruction::CallKnown:
+        if (bc.parameter >= this->program.functions.size()) {
+          return std::nullopt;
+        }
+        return bytecode::StackEffect{this->program.functions.at(bc.parameter).argumentCount, 1};
+
+      case ByteCodeInstruction::MakeObj:
+        if (bc.parameter >= this->program.objects.size()) {
+          return std::nullopt;
+        }
+        break;
+
+      case ByteCodeInstruction::LoadLocal:
+      case ByteCodeInstruction::SetLocal:
+        if (bc.parameter >= this->body.localsCount) {
+          return std::nullopt;
+        }
+        break;
+
+      default:
+        if (!bytecode::byteCodeToString(bc)) {
+          return std::nullopt;
+        }
+        break;
+    }
+
+    return bytecode::stackEffect(bc, {}, this->program.objects);
+  }
+
+  ValueId addOperation(BlockId block, ByteCodeInstruction op, std::size_t parameter, std::vector<ValueId> operands, bool hasResult) {
+    return this->fn.add(block, Instruction{InstructionKind::Operation, op, parameter, std::move(operands), hasResult, block});
+  }
+
+  bool findBlocks() {
+    const auto& byteCode = this->body.byteCode;
+    std::size_t size = byteCode.size();
+    std::vector<bool> isLeader(size + 1, false);
+    isLeader.at(0) = true;
+
+    for (std::size_t pc = 0; pc < size; pc++) {
+      const auto& bc = byteCode.at(pc);
+
+      switch (bc.instruction) {
+        case ByteCodeInstruction::Jump:
+        case ByteCodeInstruction::JumpIfFalse:
+          if (bc.parameter >= size) {
+            return false;
+          }
+          isLeader.at(bc.parameter) = true;
+          isLeader.at(pc + 1) = true;
+          break;
+
+        case ByteCodeInstruction::Return:
+        case ByteCodeInstruction::Halt:
+          isLeader.at(pc + 1) = true;
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    std::size_t start = 0;
+    for (std::size_t pc = 1; pc <= size; pc++) {
+      if (isLeader.at(pc)) {
+        this->ranges.emplace_back(start, pc);
+        start = pc;
+      }
+    }
+
+    return true;
+  }
+
+  std::optional<std::vector<std::size_t>> rangeSuccessors(std::size_t range, const std::unordered_map<std::size_t, std::size_t>& rangeAt) {
+    auto [start, end] = this->ranges.at(range);
+    const auto& last = this->body.byteCode.at(end - 1);
+
+    auto at = [&rangeAt](std::size_t pc) -> std::optional<std::size_t> {
+      auto find = rangeAt.find(pc);
+      if (find == rangeAt.end()) {
+        return std::nullopt;
+      }
+      return find->second;
+    };
+
+    std::optional<std::size_t> next = at(end);
+
+    switch (last.instruction) {
+      case ByteCodeInstruction::Return:
+      case ByteCodeInstruction::Halt:
+        return std::vector<std::size_t>{};
+
+      case ByteCodeInstruction::Jump:
+        return std::vector<std::size_t>{at(last.parameter).value()};
+
+      case ByteCodeInstruction::JumpIfFalse:
+        if (!next) {
+          return std::nullopt;
+        }
+        return std::vector<std::size_t>{next.value(), at(last.parameter).value()};
+
+      default:
+        // running off the end of the function
+        if (!next) {
+          return std::nullopt;
+        }
+        return std::vector<std::size_t>{next.value()};
+    }
+  }
+
+  VariableState entryState() {
+    VariableState state;
+
+    for (std::size_t i = 0; i < this->fn.localsCount; i++) {
+      if (this->fn.isCaptured.at(i)) {
+        // never read, captured locals stay in their slots
+        state.locals.push_back(0);
+
+      } else if (i < this->fn.argumentCount) {
+        state.locals.push_back(this->fn.add(0, Instruction{InstructionKind::Parameter, ByteCodeInstruction::NoOp, i, {}, true, 0}));
+
+      } else {
+        ValueId undefined = this->addOperation(0, ByteCodeInstruction::LoadUndefinedConstant, 0, {}, true);
+        this->initialUndefined.push_back(undefined);
+        state.locals.push_back(undefined);
+      }
+    }
+
+    return state;
+  }
+
+  std::optional<VariableState> mergeState(BlockId block) {
+    std::optional<std::size_t> depth;
+
+    for (auto predecessor : this->fn.blocks.at(block).predecessors) {
+      if (this->exitStates.at(predecessor)) {
+        depth = this->exitStates.at(predecessor)->stack.size();
+        break;
+      }
+    }
+
+    if (!depth) {
+      return std::nullopt;
+    }
+
+    auto phi = [this, block](std::size_t variable) {
+      ValueId id = this->fn.add(block, Instruction{InstructionKind::Phi, ByteCodeInstruction::NoOp, 0, {}, true, block});
+      this->phiVariables.insert(std::make_pair(id, variable));
+      return id;
+    };
+
+    VariableState state;
+
+    for (std::size_t i = 0; i < this->fn.localsCount; i++) {
+      state.locals.push_back(this->fn.isCaptured.at(i) ? 0 : phi(i));
+    }
+
+    for (std::size_t i = 0; i < depth.value(); i++) {
+      state.stack.push_back(phi(this->fn.localsCount + i));
+    }
+
+    return state;
+  }
+
+  bool translate(BlockId block, std::size_t range, VariableState& state) {
+    auto [start, end] = this->ranges.at(range);
+    auto& terminator = this->fn.blocks.at(block).terminator;
+
+    auto pop = [&state]() {
+      ValueId value = state.stack.back();
+      state.stack.pop_back();
+      return value;
+    };
+
+    for (std::size_t pc = start; pc < end; pc++) {
+      const auto& bc = this->body.byteCode.at(pc);
+      auto effect = this->effectOf(bc);
+
+      if (!effect || effect->pops > state.stack.size()) {
+        return false;
+      }
+
+      switch (bc.instruction) {
+        case ByteCodeInstruction::NoOp:
+          break;
+
+        case ByteCodeInstruction::Pop:
+          pop();
+          break;
+
+        case ByteCodeInstruction::LoadLocal:
+          if (this->fn.isCaptured.at(bc.parameter)) {
+            state.stack.push_back(this->addOperation(block, bc.instruction, bc.parameter, {}, true));
+          } else {
+            state.stack.push_back(state.locals.at(bc.parameter));
+          }
+          break;
+
+        case ByteCodeInstruction::SetLocal:
+          if (this->fn.isCaptured.at(bc.parameter)) {
+            this->addOperation(block, bc.instruction, bc.parameter, {pop()}, false);
+          } else {
+            state.locals.at(bc.parameter) = pop();
+          }
+          break;
+
+        case ByteCodeInstruction::Jump:
+          terminator.kind = TerminatorKind::Jump;
+          break;
+
+        case ByteCodeInstruction::JumpIfFalse:
+          terminator.kind = TerminatorKind::Branch;
+          terminator.value = pop();
+          break;
+
+        case ByteCodeInstruction::Return:
+          terminator.kind = TerminatorKind::Return;
+          terminator.value = pop();
+          break;
+
+        case ByteCodeInstruction::Halt:
+          terminator.kind = TerminatorKind::Halt;
+          break;
+
+        default: {
+          std::vector<ValueId> operands{state.stack.end() - effect->pops, state.stack.end()};
+          state.stack.resize(state.stack.size() - effect->pops);
+
+          ValueId value = this->addOperation(block, bc.instruction, bc.parameter, std::move(operands), effect->pushes > 0);
+
+          if (effect->pushes > 0) {
+            state.stack.push_back(value);
+          }
+          break;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool fillPhis() {
+    for (BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      for (auto id : this->fn.blocks.at(block).instructions) {
+        auto& phi = this->fn.values.at(id);
+
+        if (phi.kind != InstructionKind::Phi) {
+          break;
+        }
+
+        std::size_t variable = this->phiVariables.at(id);
+
+        for (auto predecessor : this->fn.blocks.at(block).predecessors) {
+          const auto& exit = this->exitStates.at(predecessor).value();
+
+          if (variable < this->fn.localsCount) {
+            phi.operands.push_back(exit.locals.at(variable));
+          } else {
+            phi.operands.push_back(exit.stack.at(variable - this->fn.localsCount));
+          }
+        }
+      }
+    }
+
+    // every edge has to agree on the op stack depth
+    for (BlockId block = 1; block < this->fn.blocks.size(); block++) {
+      for (auto successor : this->fn.blocks.at(block).terminator.successors) {
+        const auto& predecessors = this->fn.blocks.at(successor).predecessors;
+
+        if (predecessors.size() < 2) {
+          continue;
+        }
+
+        std::size_t depth = this->exitStates.at(block)->stack.size();
+
+        for (auto other : predecessors) {
+          if (this->exitStates.at(other)->stack.size() != depth) {
+            return false;
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  void removeTrivialPhis() {
+    bool changed = true;
+
+    while (changed) {
+      changed = false;
+
+      for (auto& block : this->fn.blocks) {
+        std::vector<ValueId> phis;
+        for (auto id : block.instructions) {
+          if (this->fn.values.at(id).kind != InstructionKind::Phi) {
+            break;
+          }
+          phis.push_back(id);
+        }
+
+        for (auto id : phis) {
+          std::optional<ValueId> same;
+          bool isTrivial = true;
+
+          for (auto operand : this->fn.values.at(id).operands) {
+            if (operand == id || operand == same) {
+              continue;
+            }
+            if (same) {
+              isTrivial = false;
+              break;
+            }
+            same = operand;
+          }
+
+          if (isTrivial && same) {
+            this->fn.replaceAllUses(id, same.value());
+            this->fn.remove(id);
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  // phis only other phis use stand for locals that are dead past the merge
+  void removeDeadPhis() {
+    std::vector<bool> isLive(this->fn.values.size(), false);
+    std::vector<ValueId> work;
+
+    auto markLive = [this, &isLive, &work](ValueId value) {
+      if (this->fn.values.at(value).kind == InstructionKind::Phi && !isLive.at(value)) {
+        isLive.at(value) = true;
+        work.push_back(value);
+      }
+    };
+
+    for (const auto& instruction : this->fn.values) {
+      if (instruction.kind == InstructionKind::Operation) {
+        std::for_each(instruction.operands.begin(), instruction.operands.end(), markLive);
+      }
+    }
+
+    for (const auto& block : this->fn.blocks) {
+      if (block.terminator.value) {
+        markLive(block.terminator.value.value());
+      }
+    }
+
+    while (!work.empty()) {
+      ValueId phi = work.back();
+      work.pop_back();
+      auto operands = this->fn.values.at(phi).operands;
+      std::for_each(operands.begin(), operands.end(), markLive);
+    }
+
+    for (ValueId id = 0; id < this->fn.values.size(); id++) {
+      if (this->fn.values.at(id).kind == InstructionKind::Phi && !isLive.at(id)) {
+        this->fn.remove(id);
+      }
+    }
+
+    auto uses = this->fn.useCounts();
+
+    for (ValueId id = 0; id < this->fn.values.size(); id++) {
+      auto kind = this->fn.values.at(id).kind;
+      bool isInitial = kind == InstructionKind::Parameter
+        || std::find(this->initialUndefined.begin(), this->initialUndefined.end(), id) != this->initialUndefined.end();
+
+      if (kind != InstructionKind::Removed && isInitial && uses.at(id) == 0) {
+        this->fn.remove(id);
+      }
+    }
+  }
+
+public:
+  explicit FunctionBuilder(const compiler::FunctionBody& body, const compiler::Program& program, std::vector<bool> isCaptured)
+  : body{body}
+  , program{program}
+  , fn{body.argumentCount, body.localsCount, body.closures, std::move(isCaptured), &body == &program.entrypoint, {}, {}}
+  {}
+
+  std::optional<Function> build() {
+    if (this->body.byteCode.empty() || this->fn.isCaptured.size() != this->fn.localsCount || !this->findBlocks()) {
+      return std::nullopt;
+    }
+
+    std::unordered_map<std::size_t, std::size_t> rangeAt;
+    for (std::size_t i = 0; i < this->ranges.size(); i++) {
+      rangeAt.insert(std::make_pair(this->ranges.at(i).first, i));
+    }
+
+    std::vector<std::vector<std::size_t>> rangeSuccessors;
+    for (std::size_t i = 0; i < this->ranges.size(); i++) {
+      auto successors = this->rangeSuccessors(i, rangeAt);
+      if (!successors) {
+        return std::nullopt;
+      }
+      rangeSuccessors.push_back(std::move(successors.value()));
+    }
+
+    // only ranges reachable from the start become blocks, in bytecode order
+    std::vector<bool> isReachable(this->ranges.size(), false);
+    std::vector<std::size_t> work{0};
+    isReachable.at(0) = true;
+
+    while (!work.empty()) {
+      std::size_t range = work.back();
+      work.pop_back();
+
+      for (auto successor : rangeSuccessors.at(range)) {
+        if (!isReachable.at(successor)) {
+          isReachable.at(successor) = true;
+          work.push_back(successor);
+        }
+      }
+    }
+
+    std::vector<std::size_t> blockRange{0};
+    std::vector<BlockId> rangeBlock(this->ranges.size(), 0);
+
+    for (std::size_t i = 0; i < this->ranges.size(); i++) {
+      if (isReachable.at(i)) {
+        rangeBlock.at(i) = blockRange.size();
+        blockRange.push_back(i);
+      }
+    }
+
+    this->fn.blocks.resize(blockRange.size());
+    this->fn.blocks.at(0).terminator = Terminator{TerminatorKind::Jump, std::nullopt, {rangeBlock.at(0)}};
+
+    for (BlockId block = 1; block < blockRange.size(); block++) {
+      auto& terminator = this->fn.blocks.at(block).terminator;
+      terminator.kind = TerminatorKind::Jump;
+
+      for (auto successor : rangeSuccessors.at(blockRange.at(block))) {
+        terminator.successors.push_back(rangeBlock.at(successor));
+      }
+    }
+
+    for (BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      for (auto successor : this->fn.blocks.at(block).terminator.successors) {
+        this->fn.blocks.at(successor).predecessors.push_back(block);
+      }
+    }
+
+    this->exitStates.resize(this->fn.blocks.size());
+
+    for (auto block : this->fn.reversePostOrder()) {
+      std::optional<VariableState> state;
+      const auto& predecessors = this->fn.blocks.at(block).predecessors;
+
+      if (block == 0) {
+        state = this->entryState();
+      } else if (predecessors.size() == 1) {
+        state = this->exitStates.at(predecessors.at(0));
+      } else {
+        state = this->mergeState(block);
+      }
+
+      if (!state || (block != 0 && !this->translate(block, blockRange.at(block), state.value()))) {
+        return std::nullopt;
+      }
+
+      this->exitStates.at(block) = std::move(state);
+    }
+
+    if (!this->fillPhis()) {
+      return std::nullopt;
+    }
+
+    this->removeTrivialPhis();
+    this->removeDeadPhis();
+
+    return std::move(this->fn);
+  }
+};
+
+std::optional<Function> build(
+  const compiler::FunctionBody& fn,
+  const compiler::Program& program,
+  std::vector<bool> isCaptured
+) {
+  FunctionBuilder builder{fn, program, std::move(isCaptured)};
+  return builder.build();
+}
+
+class Lowering {
+private:
+  const Function& fn;
+  std::vector<std::size_t> uses;
+  std::vector<bool> isStacked;
+  std::vector<std::optional<std::size_t>> slots;
+  std::size_t localsCount;
+  std::vector<bytecode::ByteCode> byteCode;
+
+  class Preload {
+  public:
+    // position of the instruction in the block that takes the values, the
+    // block end is past the last one
+    std::size_t consumer;
+    std::vector<ValueId> values;
+  };
+
+  // loads emitted before an instruction, outermost consumer first
+  std::unordered_map<ValueId, std::vector<Preload>> preloads;
+
+  // jumps to patch once every block has a position, by block or by edge stub
+  std::vector<std::pair<std::size_t, BlockId>> blockJumps;
+  std::vector<std::pair<std::size_t, std::size_t>> stubJumps;
+  // false edges into blocks with phis get their copies in a stub at the end
+  std::vector<std::pair<BlockId, BlockId>> stubs;
+
+  bool isRematerialized(ValueId value) const {
+    const auto& instruction = this->fn.values.at(value);
+    return instruction.kind == InstructionKind::Parameter
+      || (instruction.kind == InstructionKind::Operation && isConstantLoad(instruction.op));
+  }
+
+  bool hasPhis(BlockId block) const {
+    const auto& instructions = this->fn.blocks.at(block).instructions;
+    return !instructions.empty() && this->fn.values.at(instructions.front()).kind == InstructionKind::Phi;
+  }
+
+  std::vector<ValueId> phiInputs(BlockId block, std::size_t k) const {
+    BlockId successor = this->fn.blocks.at(block).terminator.successors.at(k);
+    std::size_t index = this->fn.predecessorIndex(block, k);
+    std::vector<ValueId> inputs;
+
+    for (auto id : this->fn.blocks.at(successor).instructions) {
+      const auto& phi = this->fn.values.at(id);
+      if (phi.kind != InstructionKind::Phi) {
+        break;
+      }
+      inputs.push_back(phi.operands.at(index));
+    }
+
+    return inputs;
+  }
+
+  // a value can stay on the op stack when it has one use and that use is in
+  // its own block, phi inputs are used at the end of the predecessor
+  void findStackCandidates() {
+    std::vector<std::optional<BlockId>> useBlock(this->fn.values.size());
+
+    for (BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      const auto& b = this->fn.blocks.at(block);
+
+      for (auto id : b.instructions) {
+        const auto& instruction = this->fn.values.at(id);
+
+        if (instruction.kind != InstructionKind::Phi) {
+          for (auto operand : instruction.operands) {
+            useBlock.at(operand) = block;
+          }
+        }
+      }
+
+      if (b.terminator.value) {
+        useBlock.at(b.terminator.value.value()) = block;
+      }
+
+      if (b.terminator.kind == TerminatorKind::Jump) {
+        for (auto input : this->phiInputs(block, 0)) {
+          useBlock.at(input) = block;
+        }
+      }
+    }
+
+    for (ValueId id = 0; id < this->fn.values.size(); id++) {
+      const auto& instruction = this->fn.values.at(id);
+
+      this->isStacked.at(id) = instruction.kind == InstructionKind::Operation
+        && instruction.hasResult
+        && this->uses.at(id) == 1
+        && useBlock.at(id) == instruction.block;
+    }
+  }
+
+  bool isEmitted(ValueId value) const {
+    const auto& instruction = this->fn.values.at(value);
+    return instruction.kind == InstructionKind::Operation && (this->isStacked.at(value) || !this->isRematerialized(value));
+  }
+
+  // operands the block end consumes, phi inputs are only taken from the stack
+  // on a jump
+  std::vector<ValueId> terminatorOperands(BlockId block) const {
+    const auto& terminator = this->fn.blocks.at(block).terminator;
+
+    if (terminator.value) {
+      return {terminator.value.value()};
+    }
+
+    if (terminator.kind == TerminatorKind::Jump) {
+      return this->phiInputs(block, 0);
+    }
+
+    return {};
+  }
+
+  void demote(const std::vector<ValueId>& values) {
+    for (auto value : values) {
+      this->isStacked.at(value) = false;
+    }
+  }
+
+  // operands in front of a stacked operand were pushed before it in the
+  // original code, they are loaded right before the first instruction of the
+  // stacked operand's expression tree. fails after demoting values when the
+  // stack would not line up
+  bool plan(BlockId block) {
+    const auto& instructions = this->fn.blocks.at(block).instructions;
+    std::unordered_map<ValueId, std::size_t> position;
+    std::unordered_map<ValueId, std::size_t> treeStart;
+    std::unordered_map<ValueId, std::size_t> consumer;
+
+    for (std::size_t i = 0; i < instructions.size(); i++) {
+      position.insert(std::make_pair(instructions.at(i), i));
+    }
+
+    // loads read constants, arguments or slots written once at the definition
+    auto isAvailableAt = [this, block, &position](ValueId value, std::size_t start) {
+      return this->isRematerialized(value) || this->fn.values.at(value).block != block || position.at(value) < start;
+    };
+
+    auto planOperands = [&](std::size_t at, const std::vector<ValueId>& operands) {
+      std::vector<ValueId> pending;
+
+      for (auto operand : operands) {
+        if (!this->isStacked.at(operand)) {
+          pending.push_back(operand);
+          continue;
+        }
+
+        std::size_t start = treeStart.at(operand);
+        consumer.insert(std::make_pair(operand, at));
+
+        for (auto value : pending) {
+          if (!isAvailableAt(value, start)) {
+            this->demote({operand});
+            return false;
+          }
+        }
+
+        if (!pending.empty()) {
+          this->preloads[instructions.at(start)].push_back(Preload{at, std::move(pending)});
+          pending.clear();
+        }
+      }
+
+      return true;
+    };
+
+    for (std::size_t i = 0; i < instructions.size(); i++) {
+      ValueId id = instructions.at(i);
+
+      if (!this->isEmitted(id)) {
+        continue;
+      }
+
+      const auto& operands = this->fn.values.at(id).operands;
+      auto first = std::find_if(operands.begin(), operands.end(), [this](ValueId operand) {
+        return this->isStacked.at(operand);
+      });
+
+      treeStart.insert(std::make_pair(id, first == operands.end() ? i : treeStart.at(*first)));
+
+      if (!planOperands(i, operands)) {
+        return false;
+      }
+    }
+
+    if (!planOperands(instructions.size(), this->terminatorOperands(block))) {
+      return false;
+    }
+
+    // outer expressions load first
+    for (auto id : instructions) {
+      auto find = this->preloads.find(id);
+      if (find != this->preloads.end()) {
+        std::sort(find->second.begin(), find->second.end(), [](const Preload& a, const Preload& b) {
+          return a.consumer > b.consumer;
+        });
+      }
+    }
+
+    // every entry is a value and the position of the instruction that takes it
+    std::vector<std::pair<ValueId, std::size_t>> stack;
+
+    auto consume = [this, &stack](std::size_t at, const std::vector<ValueId>& operands) {
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < operands.size(); i++) {
+        if (this->isStacked.at(operands.at(i))) {
+          count = i + 1;
+        }
+      }
+
+      bool isValid = count <= stack.size();
+
+      for (std::size_t i = 0; isValid && i < count; i++) {
+        isValid = stack.at(stack.size() - count + i) == std::make_pair(operands.at(i), at);
+      }
+
+      if (!isValid) {
+        // operands buried under values of other instructions are the usual
+        // culprit, they get a slot and the rest is tried again
+        bool isDemoted = false;
+
+        for (std::size_t i = 0; i < count; i++) {
+          ValueId operand = operands.at(i);
+          auto find = std::find(stack.begin(), stack.end(), std::make_pair(operand, at));
+          bool isInPlace = count <= stack.size()
+            && find != stack.end()
+            && static_cast<std::size_t>(find - stack.begin()) == stack.size() - count + i;
+
+          if (this->isStacked.at(operand) && !isInPlace) {
+            this->isStacked.at(operand) = false;
+            isDemoted = true;
+          }
+        }
+
+        if (!isDemoted) {
+          for (const auto& entry : stack) {
+            this->isStacked.at(entry.first) = false;
+          }
+          this->demote(operands);
+        }
+
+        return false;
+      }
+
+      stack.resize(stack.size() - count);
+      return true;
+    };
+
+    for (std::size_t i = 0; i < instructions.size(); i++) {
+      ValueId id = instructions.at(i);
+
+      if (!this->isEmitted(id)) {
+        continue;
+      }
+
+      auto find = this->preloads.find(id);
+      if (find != this->preloads.end()) {
+        for (const auto& preload : find->second) {
+          for (auto value : preload.values) {
+            stack.emplace_back(value, preload.consumer);
+          }
+        }
+      }
+
+      if (!consume(i, this->fn.values.at(id).operands)) {
+        return false;
+      }
+
+      if (this->isStacked.at(id)) {
+        stack.emplace_back(id, consumer.at(id));
+      }
+    }
+
+    if (!consume(instructions.size(), this->terminatorOperands(block))) {
+      return false;
+    }
+
+    return true;
+  }
+
+  // values that live in a frame slot, arguments stay in the slot the caller
+  // put them in
+  bool holdsSlot(ValueId id) const {
+    const auto& instruction = this->fn.values.at(id);
+
+    switch (instruction.kind) {
+      case InstructionKind::Phi:
+        return true;
+      case InstructionKind::Parameter:
+        return this->uses.at(id) > 0;
+      case InstructionKind::Operation:
+        return instruction.hasResult && this->uses.at(id) > 0 && !this->isStacked.at(id) && !this->isRematerialized(id);
+      default:
+        return false;
+    }
+  }
+
+  // walks block backwards from the values live at its end to the ones live
+  // at its start. a block's phis are all written at its start, arguments
+  // hold their slot from the start of the frame
+  std::set<ValueId> liveBefore(BlockId block, std::set<ValueId> live, std::vector<std::set<ValueId>>* interference) const {
+    const auto& b = this->fn.blocks.at(block);
+
+    auto define = [&live, interference](ValueId id) {
+      if (interference) {
+        for (auto other : live) {
+          if (other != id) {
+            interference->at(id).insert(other);
+            interference->at(other).insert(id);
+          }
+        }
+      }
+    };
+
+    if (b.terminator.value && this->holdsSlot(b.terminator.value.value())) {
+      live.insert(b.terminator.value.value());
+    }
+
+    std::vector<ValueId> phis;
+
+    for (auto id = b.instructions.rbegin(); id != b.instructions.rend(); id++) {
+      const auto& instruction = this->fn.values.at(*id);
+
+      if (instruction.kind == InstructionKind::Phi) {
+        phis.push_back(*id);
+        continue;
+      }
+
+      if (this->holdsSlot(*id)) {
+        define(*id);
+        if (instruction.kind == InstructionKind::Parameter) {
+          live.insert(*id);
+        } else {
+          live.erase(*id);
+        }
+      }
+
+      for (auto operand : instruction.operands) {
+        if (this->holdsSlot(operand)) {
+          live.insert(operand);
+        }
+      }
+    }
+
+    live.insert(phis.begin(), phis.end());
+    for (auto phi : phis) {
+      define(phi);
+    }
+    for (auto phi : phis) {
+      live.erase(phi);
+    }
+
+    return live;
+  }
+
+  // phi inputs are read at the end of the predecessor, not in the phi's block
+  std::set<ValueId> liveAfter(BlockId block, const std::vector<std::set<ValueId>>& liveIn) const {
+    std::set<ValueId> live;
+    const auto& successors = this->fn.blocks.at(block).terminator.successors;
+
+    for (std::size_t k = 0; k < successors.size(); k++) {
+      live.insert(liveIn.at(successors.at(k)).begin(), liveIn.at(successors.at(k)).end());
+
+      for (auto input : this->phiInputs(block, k)) {
+        if (this->holdsSlot(input)) {
+          live.insert(input);
+        }
+      }
+    }
+
+    return live;
+  }
+
+  // two values share a slot unless one is live where the other is written.
+  // values are colored in reverse postorder, so every value that is live at a
+  // definition already has its slot, and a phi and its inputs get the same
+  // slot where they can so the copy between them goes away
+  void assignSlots() {
+    std::size_t size = this->fn.blocks.size();
+    std::vector<std::set<ValueId>> liveIn(size);
+
+    bool isStable = false;
+    while (!isStable) {
+      isStable = true;
+      for (BlockId block = size; block-- > 0;) {
+        auto live = this->liveBefore(block, this->liveAfter(block, liveIn), nullptr);
+        if (live != liveIn.at(block)) {
+          liveIn.at(block) = std::move(live);
+          isStable = false;
+        }
+      }
+    }
+
+    std::vector<std::set<ValueId>> interference(this->fn.values.size());
+    for (BlockId block = 0; block < size; block++) {
+      this->liveBefore(block, this->liveAfter(block, liveIn), &interference);
+    }
+
+    std::vector<std::vector<ValueId>> phiUses(this->fn.values.size());
+    std::vector<ValueId> order;
+
+    for (ValueId id = 0; id < this->fn.values.size(); id++) {
+      const auto& instruction = this->fn.values.at(id);
+
+      if (instruction.kind == InstructionKind::Phi) {
+        for (auto operand : instruction.operands) {
+          phiUses.at(operand).push_back(id);
+        }
+      } else if (instruction.kind == InstructionKind::Parameter && this->holdsSlot(id)) {
+        this->slots.at(id) = instruction.parameter;
+      }
+    }
+
+    auto blocks = this->fn.reversePostOrder();
+    std::vector<bool> isOrdered(size, false);
+    for (auto block : blocks) {
+      isOrdered.at(block) = true;
+    }
+    for (BlockId block = 0; block < size; block++) {
+      if (!isOrdered.at(block)) {
+        blocks.push_back(block);
+      }
+    }
+
+    this->localsCount = this->fn.argumentCount;
+
+    for (std::size_t i = 0; i < this->fn.localsCount; i++) {
+      if (this->fn.isCaptured.at(i)) {
+        this->localsCount = std::max(this->localsCount, i + 1);
+      }
+    }
+
+    for (auto block : blocks) {
+      for (auto id : this->fn.blocks.at(block).instructions) {
+        if (!this->holdsSlot(id) || this->slots.at(id)) {
+          continue;
+        }
+
+        std::set<std::size_t> taken;
+        for (auto other : interference.at(id)) {
+          if (this->slots.at(other)) {
+            taken.insert(this->slots.at(other).value());
+          }
+        }
+
+        std::vector<ValueId> related = phiUses.at(id);
+        if (this->fn.values.at(id).kind == InstructionKind::Phi) {
+          const auto& operands = this->fn.values.at(id).operands;
+          related.insert(related.end(), operands.begin(), operands.end());
+        }
+
+        std::optional<std::size_t> slot;
+        for (auto other : related) {
+          if (this->slots.at(other) && taken.count(this->slots.at(other).value()) == 0) {
+            slot = this->slots.at(other);
+            break;
+          }
+        }
+
+        if (!slot) {
+          slot = 0;
+          while (taken.count(slot.value()) > 0
+            || (slot.value() < this->fn.localsCount && this->fn.isCaptured.at(slot.value()))) {
+            slot = slot.value() + 1;
+          }
+        }
+
+        this->slots.at(id) = slot;
+        this->localsCount = std::max(this->localsCount, slot.value() + 1);
+      }
+    }
+  }
+
+  void emit(ByteCodeInstruction instruction, std::size_t parameter) {
+    this->byteCode.emplace_back(instruction, parameter);
+  }
+
+  void emitLoad(ValueId value) {
+    const auto& instruction = this->fn.values.at(value);
+
+    if (instruction.kind == InstructionKind::Parameter) {
+      this->emit(ByteCodeInstruction::LoadLocal, instruction.parameter);
+    } else if (this->isRematerialized(value)) {
+      this->emit(instruction.op, instruction.parameter);
+    } else {
+      this->emit(ByteCodeInstruction::LoadLocal, this->slots.at(value).value());
+    }
+  }
+
+  // everything up to the last stacked operand is on the stack already
+  void emitOperands(const std::vector<ValueId>& operands) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < operands.size(); i++) {
+      if (this->isStacked.at(operands.at(i))) {
+        count = i + 1;
+      }
+    }
+
+    for (std::size_t i = count; i < operands.size(); i++) {
+      this->emitLoad(operands.at(i));
+    }
+  }
+
+  // a parallel copy, every input is read before any phi slot is written.
+  // inputs loaded from the phi's own slot need no copy
+  void emitPhiCopies(BlockId block, std::size_t k) {
+    BlockId successor = this->fn.blocks.at(block).terminator.successors.at(k);
+    auto inputs = this->phiInputs(block, k);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+      if (this->isStacked.at(inputs.at(i))) {
+        count = i + 1;
+      }
+    }
+
+    const auto& instructions = this->fn.blocks.at(successor).instructions;
+    std::vector<ValueId> phis;
+
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+      ValueId phi = instructions.at(i);
+
+      if (i < count || this->slots.at(inputs.at(i)) != this->slots.at(phi)) {
+        if (i >= count) {
+          this->emitLoad(inputs.at(i));
+        }
+        phis.push_back(phi);
+      }
+    }
+
+    for (auto phi = phis.rbegin(); phi != phis.rend(); phi++) {
+      this->emit(ByteCodeInstruction::SetLocal, this->slots.at(*phi).value());
+    }
+  }
+
+  void emitJump(BlockId target, BlockId next) {
+    if (target != next) {
+      this->blockJumps.emplace_back(this->byteCode.size(), target);
+      this->emit(ByteCodeInstruction::Jump, 0);
+    }
+  }
+
+  void emitBlock(BlockId block) {
+    const auto& b = this->fn.blocks.at(block);
+    BlockId next = block + 1;
+
+    for (auto id : b.instructions) {
+      const auto& instruction = this->fn.values.at(id);
+
+      if (!this->isEmitted(id)) {
+        continue;
+      }
+
+      auto find = this->preloads.find(id);
+      if (find != this->preloads.end()) {
+        for (const auto& preload : find->second) {
+          std::for_each(preload.values.begin(), preload.values.end(), [this](ValueId value) {
+            this->emitLoad(value);
+          });
+        }
+      }
+
+      this->emitOperands(instruction.operands);
+      this->emit(instruction.op, instruction.parameter);
+
+      if (!instruction.hasResult || this->isStacked.at(id)) {
+        continue;
+      }
+
+      if (this->slots.at(id)) {
+        this->emit(ByteCodeInstruction::SetLocal, this->slots.at(id).value());
+      } else {
+        this->emit(ByteCodeInstruction::Pop, 0);
+      }
+    }
+
+    const auto& terminator = b.terminator;
+
+    switch (terminator.kind) {
+      case TerminatorKind::Jump:
+        this->emitPhiCopies(block, 0);
+        this->emitJump(terminator.successors.at(0), next);
+        break;
+
+      case TerminatorKind::Branch: {
+        this->emitOperands({terminator.value.value()});
+
+        BlockId whenFalse = terminator.successors.at(1);
+
+        if (this->hasPhis(whenFalse)) {
+          this->stubJumps.emplace_back(this->byteCode.size(), this->stubs.size());
+          this->stubs.emplace_back(block, whenFalse);
+        } else {
+          this->blockJumps.emplace_back(this->byteCode.size(), whenFalse);
+        }
+
+        this->emit(ByteCodeInstruction::JumpIfFalse, 0);
+        this->emitPhiCopies(block, 0);
+        this->emitJump(terminator.successors.at(0), next);
+        break;
+      }
+
+      case TerminatorKind::Return:
+        this->emitOperands({terminator.value.value()});
+        this->emit(ByteCodeInstruction::Return, 0);
+        break;
+
+      case TerminatorKind::Halt:
+        this->emit(ByteCodeInstruction::Halt, 0);
+        break;
+    }
+  }
+
+public:
+  explicit Lowering(const Function& fn)
+  : fn{fn}
+  , uses{fn.useCounts()}
+  , isStacked(fn.values.size(), false)
+  , slots(fn.values.size())
+  , localsCount{fn.localsCount}
+  {}
+
+  bytecode::Function lower() {
+    this->findStackCandidates();
+
+    // every failed plan demotes at least one value, so this ends
+    bool isStable = false;
+    while (!isStable) {
+      isStable = true;
+      this->preloads.clear();
+      for (BlockId block = 0; block < this->fn.blocks.size(); block++) {
+        isStable = this->plan(block) && isStable;
+      }
+    }
+
+    this->assignSlots();
+
+    std::vector<std::size_t> blockStart;
+
+    for (BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      blockStart.push_back(this->byteCode.size());
+      this->emitBlock(block);
+    }
+
+    std::vector<std::size_t> stubStart;
+
+    for (const auto& [block, whenFalse] : this->stubs) {
+      stubStart.push_back(this->byteCode.size());
+      const auto& successors = this->fn.blocks.at(block).terminator.successors;
+      this->emitPhiCopies(block, successors.size() - 1);
+      this->emitJump(whenFalse, this->fn.blocks.size());
+    }
+
+    for (const auto& [index, target] : this->blockJumps) {
+      this->byteCode.at(index).parameter = blockStart.at(target);
+    }
+
+    for (const auto& [index, stub] : this->stubJumps) {
+      this->byteCode.at(index).parameter = stubStart.at(stub);
+    }
+
+    return bytecode::Function{this->fn.argumentCount, this->localsCount, this->fn.closures, std::move(this->byteCode)};
+  }
+};
+
+bytecode::Function lower(const Function& fn) {
+  Lowering lowering{fn};
+  return lowering.lower();
+}
+
+static void dumpValue(ValueId value, std::ostream & os) {
+  os << " v" << value;
+}
+
+void dump(const Function& fn, std::ostream & os) {
+  os << "arguments " << fn.argumentCount << ", locals " << fn.localsCount;
+
+  std::string separator = ", captured";
+  for (std::size_t i = 0; i < fn.localsCount; i++) {
+    if (fn.isCaptured.at(i)) {
+      os << separator << ' ' << i;
+      separator = "";
+    }
+  }
+  os << '\n';
+
+  for (BlockId block = 0; block < fn.blocks.size(); block++) {
+    const auto& b = fn.blocks.at(block);
+    os << "block" << block << ':';
+
+    if (!b.predecessors.empty()) {
+      os << " ; preds";
+      for (auto predecessor : b.predecessors) {
+        os << " block" << predecessor;
+      }
+    }
+    os << '\n';
+
+    for (auto id : b.instructions) {
+      const auto& instruction = fn.values.at(id);
+      os << "  ";
+
+      if (instruction.hasResult) {
+        os << 'v' << id << " = ";
+      }
+
+      switch (instruction.kind) {
+        case InstructionKind::Parameter:
+          os << "parameter " << instruction.parameter;
+          break;
+        case InstructionKind::Phi:
+          os << "phi";
+          break;
+        case InstructionKind::Operation:
+          os << bytecode::byteCodeToString(bytecode::ByteCode{instruction.op, instruction.parameter}).value_or("<UNKNOWN>");
+          break;
+        case InstructionKind::Removed:
+          break;
+      }
+
+      std::for_each(instruction.operands.begin(), instruction.operands.end(), [&os](ValueId value) {
+        dumpValue(value, os);
+      });
+      os << '\n';
+    }
+
+    const auto& terminator = b.terminator;
+    os << "  ";
+
+    switch (terminator.kind) {
+      case TerminatorKind::Jump: os << "jump"; break;
+      case TerminatorKind::Branch: os << "branch"; break;
+      case TerminatorKind::Return: os << "return"; break;
+      case TerminatorKind::Halt: os << "halt"; break;
+    }
+
+    if (terminator.value) {
+      dumpValue(terminator.value.value(), os);
+    }
+
+    for (auto successor : terminator.successors) {
+      os << " block" << successor;
+    }
+    os << '\n';
+  }
+}
+
+void dump(const compiler::Program& program, std::ostream & os) {
+  auto captured = capturedLocals(program);
+
+  for (std::size_t i = 0; i <= program.functions.size(); i++) {
+    const auto& body = i == 0 ? program.entrypoint : program.functions.at(i - 1);
+
+    if (i == 0) {
+      os << "entrypoint, ";
+    } else {
+      os << "\nfunction " << (i - 1) << ", ";
+    }
+
+    auto fn = build(body, program, captured.at(i));
+
+    if (!fn) {
+      os << "not representable in SSA form\n";
+      continue;
+    }
+
+    dump(fn.value(), os);
+  }
+}
+
+bool transform(compiler::Program& program, const std::function<bool(Function&)>& transform) {
+  auto captured = capturedLocals(program);
+  bool changed = false;
+  std::size_t i = 0;
+
+  program.forEachFunction([&](compiler::FunctionBody& body) {
+    auto fn = build(body, program, captured.at(i++));
+
+    if (fn && transform(fn.value())) {
+      body = compiler::FunctionBody{lower(fn.value())};
+      changed = true;
+    }
+  });
+
+  return changed;
+}
+
+};
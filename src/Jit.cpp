@@ -0,0 +1,334 @@
+#include "Jit.hpp"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define FLANG_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <cstring>
+#else
+#define FLANG_JIT_SUPPORTED 0
+#endif
+
+namespace jit {
+
+bool isSupported() noexcept {
+  return FLANG_JIT_SUPPORTED != 0;
+}
+
+Condition negate(Condition condition) noexcept {
+  // x86 condition codes come in pairs that differ in the lowest bit
+  return static_cast<Condition>(static_cast<std::uint8_t>(condition) ^ 1);
+}
+
+static std::uint8_t low(Register r) {
+  return static_cast<std::uint8_t>(r) & 7;
+}
+
+static bool extended(Register r) {
+  return static_cast<std::uint8_t>(r) >= 8;
+}
+
+// the opcode extension used by the immediate and unary instruction groups
+static Register digit(std::uint8_t d) {
+  return static_cast<Register>(d);
+}
+
+jit::AssembledCode::~AssembledCode() noexcept {
+#if FLANG_JIT_SUPPORTED
+  munmap(this->memory, this->size);
+#endif
+}
+
+void jit::AssembledCode::enter(std::size_t label, void* context, void* arg1, void* arg2, void* arg3) const {
+  using Entry = void (*)(void*, const void*, void*, void*, void*);
+
+  auto base = static_cast<const std::uint8_t*>(this->memory);
+  auto entry = reinterpret_cast<Entry>(this->memory);
+
+  entry(context, base + this->offsets.at(label), arg1, arg2, arg3);
+}
+
+jit::Assembler::Assembler(std::size_t entryLabelCount) noexcept
+: labels(entryLabelCount, 0)
+, entryLabelCount{entryLabelCount}
+{}
+
+// the generated function always starts here, callee saved registers are
+// pushed so rsp stays 16 byte aligned for helper calls:
+//   push rbp / mov rbp, rsp / push rbx / push r12 / push r13 / push r14
+//   sub rsp, spillBytes
+//   mov rbx, rdi / mov r12, rdx / mov r13, rcx / mov r14, r8
+//   jmp rsi
+void jit::Assembler::prologue(std::int32_t spillBytes) {
+  this->emitByte(0x55);
+  this->move(Register::rbp, Register::rsp);
+  this->emitByte(0x53);
+  this->emitByte(0x41); this->emitByte(0x54);
+  this->emitByte(0x41); this->emitByte(0x55);
+  this->emitByte(0x41); this->emitByte(0x56);
+
+  if (spillBytes > 0) {
+    this->emitRex(true, digit(5), Register::rsp);
+    this->emitByte(0x81);
+    this->emitRegisterOperand(digit(5), Register::rsp);
+    this->emitInt32(spillBytes);
+  }
+
+  this->move(Register::rbx, Register::rdi);
+  this->move(Register::r12, Register::rdx);
+  this->move(Register::r13, Register::rcx);
+  this->move(Register::r14, Register::r8);
+
+  this->emitRex(false, digit(4), Register::rsi);
+  this->emitByte(0xFF);
+  this->emitRegisterOperand(digit(4), Register::rsi);
+}
+
+//   lea rsp, [rbp - 32]
+//   pop r14 / pop r13 / pop r12 / pop rbx / pop rbp
+//   ret
+void jit::Assembler::exit() {
+  this->loadAddress(Register::rsp, Register::rbp, -32);
+  this->emitByte(0x41); this->emitByte(0x5E);
+  this->emitByte(0x41); this->emitByte(0x5D);
+  this->emitByte(0x41); this->emitByte(0x5C);
+  this->emitByte(0x5B);
+  this->emitByte(0x5D);
+  this->emitByte(0xC3);
+}
+
+std::size_t jit::Assembler::createLabel() {
+  this->labels.push_back(0);
+  return this->labels.size() - 1;
+}
+
+void jit::Assembler::bind(std::size_t label) {
+  this->labels.at(label) = this->code.size();
+}
+
+// mov rdi, rbx
+// mov rax, helper
+// call rax
+void jit::Assembler::call(std::uintptr_t helper) {
+  this->move(Register::rdi, Register::rbx);
+  this->moveImmediate(Register::rax, helper);
+  this->emitByte(0xFF); this->emitByte(0xD0);
+}
+
+// test al, al
+// jnz label
+void jit::Assembler::callAndBranch(std::uintptr_t helper, std::size_t label) {
+  this->call(helper);
+  this->emitByte(0x84); this->emitByte(0xC0);
+  this->jumpIf(Condition::NotEqual, label);
+}
+
+// jmp rel32
+void jit::Assembler::jump(std::size_t label) {
+  this->emitByte(0xE9); this->emitLabelReference(label);
+}
+
+// jcc rel32
+void jit::Assembler::jumpIf(Condition condition, std::size_t label) {
+  this->emitByte(0x0F);
+  this->emitByte(static_cast<std::uint8_t>(0x80 | static_cast<std::uint8_t>(condition)));
+  this->emitLabelReference(label);
+}
+
+void jit::Assembler::move(Register dst, Register src) {
+  this->emitAlu(0x89, dst, src);
+}
+
+void jit::Assembler::moveImmediate(Register dst, std::uint64_t value) {
+  this->emitRex(true, digit(0), dst);
+  this->emitByte(static_cast<std::uint8_t>(0xB8 | low(dst)));
+  this->emitUInt64(value);
+}
+
+void jit::Assembler::load(Register dst, Register base, std::int32_t disp) {
+  this->emitRex(true, dst, base);
+  this->emitByte(0x8B);
+  this->emitMemoryOperand(dst, base, disp);
+}
+
+void jit::Assembler::store(Register base, std::int32_t disp, Register src) {
+  this->emitRex(true, src, base);
+  this->emitByte(0x89);
+  this->emitMemoryOperand(src, base, disp);
+}
+
+void jit::Assembler::storeImmediate32(Register base, std::int32_t disp, std::int32_t value) {
+  this->emitRex(false, digit(0), base);
+  this->emitByte(0xC7);
+  this->emitMemoryOperand(digit(0), base, disp);
+  this->emitInt32(value);
+}
+
+void jit::Assembler::loadAddress(Register dst, Register base, std::int32_t disp) {
+  this->emitRex(true, dst, base);
+  this->emitByte(0x8D);
+  this->emitMemoryOperand(dst, base, disp);
+}
+
+void jit::Assembler::compareImmediate32(Register base, std::int32_t disp, std::int32_t value) {
+  this->emitRex(false, digit(7), base);
+  this->emitByte(0x81);
+  this->emitMemoryOperand(digit(7), base, disp);
+  this->emitInt32(value);
+}
+
+void jit::Assembler::compareImmediate8(Register base, std::int32_t disp, std::int8_t value) {
+  this->emitRex(false, digit(7), base);
+  this->emitByte(0x80);
+  this->emitMemoryOperand(digit(7), base, disp);
+  this->emitByte(static_cast<std::uint8_t>(value));
+}
+
+void jit::Assembler::compareImmediate(Register dst, std::int32_t value) {
+  this->emitRex(true, digit(7), dst);
+  this->emitByte(0x81);
+  this->emitRegisterOperand(digit(7), dst);
+  this->emitInt32(value);
+}
+
+void jit::Assembler::add(Register dst, Register src) {
+  this->emitAlu(0x01, dst, src);
+}
+
+void jit::Assembler::subtract(Register dst, Register src) {
+  this->emitAlu(0x29, dst, src);
+}
+
+// imul dst, src
+void jit::Assembler::multiply(Register dst, Register src) {
+  this->emitRex(true, dst, src);
+  this->emitByte(0x0F); this->emitByte(0xAF);
+  this->emitRegisterOperand(dst, src);
+}
+
+void jit::Assembler::compare(Register dst, Register src) {
+  this->emitAlu(0x39, dst, src);
+}
+
+void jit::Assembler::test(Register dst, Register src) {
+  this->emitAlu(0x85, dst, src);
+}
+
+// cqo
+// idiv src
+void jit::Assembler::divide(Register src) {
+  this->emitByte(0x48); this->emitByte(0x99);
+  this->emitRex(true, digit(7), src);
+  this->emitByte(0xF7);
+  this->emitRegisterOperand(digit(7), src);
+}
+
+// setcc dst8
+// movzx dst32, dst8
+void jit::Assembler::setIf(Condition condition, Register dst) {
+  this->emitByte(0x0F);
+  this->emitByte(static_cast<std::uint8_t>(0x90 | static_cast<std::uint8_t>(condition)));
+  this->emitRegisterOperand(digit(0), dst);
+  this->emitByte(0x0F); this->emitByte(0xB6);
+  this->emitRegisterOperand(dst, dst);
+}
+
+std::unique_ptr<NativeCode> jit::Assembler::finalize() {
+  for (const auto& fixup : this->labelFixups) {
+    std::size_t next = fixup.first + 4;
+    auto displacement = static_cast<std::int64_t>(this->labels.at(fixup.second)) - static_cast<std::int64_t>(next);
+    auto rel32 = static_cast<std::uint32_t>(static_cast<std::int32_t>(displacement));
+
+    for (std::size_t i = 0; i < 4; i++) {
+      this->code.at(fixup.first + i) = static_cast<std::uint8_t>((rel32 >> (8 * i)) & 0xFF);
+    }
+  }
+
+#if FLANG_JIT_SUPPORTED
+  std::size_t size = this->code.size();
+
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::memcpy(memory, this->code.data(), size);
+
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+
+  std::vector<std::size_t> entries{this->labels.begin(), this->labels.begin() + this->entryLabelCount};
+
+  return std::make_unique<AssembledCode>(memory, size, std::move(entries));
+#else
+  return nullptr;
+#endif
+}
+
+void jit::Assembler::emitByte(std::uint8_t byte) {
+  this->code.push_back(byte);
+}
+
+void jit::Assembler::emitInt32(std::int32_t value) {
+  for (std::size_t i = 0; i < 4; i++) {
+    this->emitByte(static_cast<std::uint8_t>((static_cast<std::uint32_t>(value) >> (8 * i)) & 0xFF));
+  }
+}
+
+void jit::Assembler::emitUInt64(std::uint64_t value) {
+  for (std::size_t i = 0; i < 8; i++) {
+    this->emitByte(static_cast<std::uint8_t>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+void jit::Assembler::emitLabelReference(std::size_t label) {
+  this->labelFixups.emplace_back(this->code.size(), label);
+  this->emitInt32(0);
+}
+
+// only emitted when needed, byte sized registers are never used above bl
+void jit::Assembler::emitRex(bool wide, Register reg, Register base) {
+  std::uint8_t rex = 0x40;
+
+  if (wide) {
+    rex |= 0x08;
+  }
+
+  if (extended(reg)) {
+    rex |= 0x04;
+  }
+
+  if (extended(base)) {
+    rex |= 0x01;
+  }
+
+  if (rex != 0x40) {
+    this->emitByte(rex);
+  }
+}
+
+void jit::Assembler::emitRegisterOperand(Register reg, Register rm) {
+  this->emitByte(static_cast<std::uint8_t>(0xC0 | (low(reg) << 3) | low(rm)));
+}
+
+// always uses a 32 bit displacement, rsp and r12 as a base need a SIB byte
+void jit::Assembler::emitMemoryOperand(Register reg, Register base, std::int32_t disp) {
+  this->emitByte(static_cast<std::uint8_t>(0x80 | (low(reg) << 3) | low(base)));
+
+  if (low(base) == 4) {
+    this->emitByte(0x24);
+  }
+
+  this->emitInt32(disp);
+}
+
+// op r/m64, r64
+void jit::Assembler::emitAlu(std::uint8_t opcode, Register dst, Register src) {
+  this->emitRex(true, src, dst);
+  this->emitByte(opcode);
+  this->emitRegisterOperand(src, dst);
+}
+
+};
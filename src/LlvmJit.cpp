@@ -0,0 +1,714 @@
+#include "Runtime.hpp"
+
+#ifdef FLANG_LLVM
+
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstddef>
+#include <cstring>
+
+#endif
+
+namespace jit {
+
+bool isLlvmSupported() noexcept {
+#ifdef FLANG_LLVM
+  return true;
+#else
+  return false;
+#endif
+}
+
+};
+
+namespace runtime {
+
+#ifdef FLANG_LLVM
+
+static_assert(offsetof(Variable, type) == 0 && offsetof(Variable, integerValue) == 8, "Variable must match { i32, i64 }");
+
+// the process wide ORC instance, created by the compile thread on first use.
+// it is never destroyed since the process may exit while code from it is
+// still on the stack
+struct LlvmEnvironment {
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  std::unique_ptr<llvm::TargetMachine> targetMachine;
+  std::size_t functionCount;
+};
+
+static LlvmEnvironment* llvmEnvironment() {
+  static LlvmEnvironment* environment = []() -> LlvmEnvironment* {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    auto builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+    if (!builder) {
+      llvm::consumeError(builder.takeError());
+      return nullptr;
+    }
+
+    auto targetMachine = builder->createTargetMachine();
+
+    if (!targetMachine) {
+      llvm::consumeError(targetMachine.takeError());
+      return nullptr;
+    }
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*builder)).create();
+
+    if (!jit) {
+      llvm::consumeError(jit.takeError());
+      return nullptr;
+    }
+
+    return new LlvmEnvironment{std::move(*jit), std::move(*targetMachine), 0};
+  }();
+
+  return environment;
+}
+
+// a function compiled by ORC, removed from the JIT again when this is destroyed
+class LlvmCode : public jit::NativeCode {
+private:
+  using Entry = void (*)(void* vm, std::size_t entry, void* locals, void* globals, void* programCounter);
+
+  llvm::orc::ResourceTrackerSP tracker;
+  Entry entry;
+
+public:
+  explicit LlvmCode(llvm::orc::ResourceTrackerSP tracker, Entry entry) noexcept
+  : tracker{std::move(tracker)}
+  , entry{entry}
+  {}
+
+  ~LlvmCode() noexcept override {
+    llvm::consumeError(this->tracker->remove());
+  }
+
+  void enter(std::size_t label, void* context, void* arg1, void* arg2, void* arg3) const override {
+    this->entry(context, label, arg1, arg2, arg3);
+  }
+};
+
+struct LlvmHelpers {
+  std::uintptr_t (*generic)(bytecode::ByteCodeInstruction);
+  bool (*changesStackFrame)(bytecode::ByteCodeInstruction);
+  std::uintptr_t jumpIfFalse;
+  std::uintptr_t pushOperand;
+  std::uintptr_t popOperand;
+};
+
+// Lowers a bytecode function to a single LLVM function with the same calling
+// convention as the speculative tier, void(vm, entry pc, locals, globals,
+// &programCounter). Every op stack slot becomes a pair of allocas for its type
+// and payload, which LLVM promotes to registers. Quickened instructions get an
+// inline fast path guarded on the operand types and fall back to the runtime
+// helper, so the code never has to be thrown away. Before any helper call the
+// slots are pushed onto the real op stack so the VM sees exactly the state
+// the interpreter would have.
+class LlvmLowering {
+private:
+  const bytecode::CompiledFile& file;
+  const bytecode::Function& fn;
+  const std::vector<bytecode::ByteCode>& byteCode;
+  const LlvmHelpers& helpers;
+  llvm::LLVMContext& context;
+  llvm::Module& module;
+  llvm::IRBuilder<> builder;
+  std::size_t size;
+  std::vector<std::optional<std::size_t>> depths;
+  std::vector<bool> isJumpTarget;
+
+  llvm::Type* i8;
+  llvm::Type* i32;
+  llvm::Type* i64;
+  llvm::Type* f64;
+  llvm::StructType* variableType;
+
+  llvm::Function* function;
+  llvm::Value* vm;
+  llvm::Value* locals;
+  llvm::Value* globals;
+  llvm::Value* programCounter;
+  std::vector<llvm::AllocaInst*> types;
+  std::vector<llvm::AllocaInst*> values;
+  llvm::AllocaInst* scratch;
+  std::vector<llvm::BasicBlock*> blocks;
+
+public:
+  std::vector<bool> entries;
+
+  explicit LlvmLowering(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode,
+    const LlvmHelpers& helpers,
+    llvm::Module& module
+  ) noexcept
+  : file{file}
+  , fn{fn}
+  , byteCode{byteCode}
+  , helpers{helpers}
+  , context{module.getContext()}
+  , module{module}
+  , builder{module.getContext()}
+  , size{byteCode.size()}
+  , depths{}
+  , isJumpTarget(byteCode.size(), false)
+  , i8{llvm::Type::getInt8Ty(module.getContext())}
+  , i32{llvm::Type::getInt32Ty(module.getContext())}
+  , i64{llvm::Type::getInt64Ty(module.getContext())}
+  , f64{llvm::Type::getDoubleTy(module.getContext())}
+  , variableType{llvm::StructType::get(module.getContext(), {i32, i64})}
+  , function{nullptr}
+  , vm{nullptr}
+  , locals{nullptr}
+  , globals{nullptr}
+  , programCounter{nullptr}
+  , types{}
+  , values{}
+  , scratch{nullptr}
+  , blocks(byteCode.size(), nullptr)
+  , entries(byteCode.size(), false)
+  {}
+
+  bool lower(const std::string & name) {
+    auto depths = bytecode::stackDepths(this->byteCode, this->file.functions, this->file.objects);
+
+    if (!depths) {
+      return false;
+    }
+
+    this->depths = std::move(depths.value());
+
+    std::size_t maxDepth = 0;
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (!this->depths.at(pc)) {
+        continue;
+      }
+
+      const auto& bc = this->byteCode.at(pc);
+      auto effect = bytecode::stackEffect(bc, this->file.functions, this->file.objects);
+      std::size_t depth = this->depths.at(pc).value();
+
+      maxDepth = std::max(maxDepth, std::max(depth, depth - effect.pops + effect.pushes));
+
+      if (bc.instruction == bytecode::ByteCodeInstruction::Jump
+        || bc.instruction == bytecode::ByteCodeInstruction::JumpIfFalse) {
+        this->isJumpTarget.at(bc.parameter) = true;
+      }
+    }
+
+    auto pointer = llvm::Type::getInt8PtrTy(this->context);
+    auto functionType = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(this->context),
+      {pointer, this->i64, this->variableType->getPointerTo(), this->variableType->getPointerTo(), this->i64->getPointerTo()},
+      false);
+
+    this->function = llvm::Function::Create(functionType, llvm::Function::ExternalLinkage, name, this->module);
+    this->vm = this->function->getArg(0);
+    this->locals = this->function->getArg(2);
+    this->globals = this->function->getArg(3);
+    this->programCounter = this->function->getArg(4);
+
+    auto entryBlock = llvm::BasicBlock::Create(this->context, "entry", this->function);
+    auto exitBlock = llvm::BasicBlock::Create(this->context, "exit", this->function);
+    this->builder.SetInsertPoint(exitBlock);
+    this->builder.CreateRetVoid();
+
+    this->builder.SetInsertPoint(entryBlock);
+    for (std::size_t i = 0; i < maxDepth; i++) {
+      this->types.push_back(this->builder.CreateAlloca(this->i32));
+      this->values.push_back(this->builder.CreateAlloca(this->i64));
+    }
+    this->scratch = this->builder.CreateAlloca(this->variableType);
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (this->depths.at(pc)) {
+        this->blocks.at(pc) = llvm::BasicBlock::Create(this->context, "pc" + std::to_string(pc), this->function);
+      }
+    }
+
+    // entry points hold everything on the real op stack, the same places the
+    // speculative tier can be entered at
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (!this->depths.at(pc)) {
+        continue;
+      }
+
+      bool isAfterCall = pc > 0
+        && this->depths.at(pc - 1)
+        && this->helpers.changesStackFrame(this->byteCode.at(pc - 1).instruction);
+
+      this->entries.at(pc) = pc == 0 || this->isJumpTarget.at(pc) || isAfterCall;
+    }
+
+    auto dispatch = this->builder.CreateSwitch(this->function->getArg(1), exitBlock);
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (!this->entries.at(pc)) {
+        continue;
+      }
+
+      auto enter = llvm::BasicBlock::Create(this->context, "enter" + std::to_string(pc), this->function);
+      dispatch->addCase(llvm::ConstantInt::get(llvm::cast<llvm::IntegerType>(this->i64), pc), enter);
+
+      this->builder.SetInsertPoint(enter);
+      this->popAll(this->depths.at(pc).value());
+      this->builder.CreateBr(this->blocks.at(pc));
+    }
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (this->blocks.at(pc) != nullptr) {
+        this->builder.SetInsertPoint(this->blocks.at(pc));
+        this->lowerInstruction(pc, this->depths.at(pc).value());
+      }
+    }
+
+    return !llvm::verifyFunction(*this->function, nullptr);
+  }
+
+private:
+  llvm::Value* callHelper(
+    std::uintptr_t address,
+    llvm::Type* result,
+    llvm::ArrayRef<llvm::Type*> parameters,
+    llvm::ArrayRef<llvm::Value*> arguments
+  ) {
+    auto type = llvm::FunctionType::get(result, parameters, false);
+    auto callee = this->builder.CreateIntToPtr(this->builder.getInt64(address), type->getPointerTo());
+    return this->builder.CreateCall(type, callee, arguments);
+  }
+
+  void callHelper(std::uintptr_t address) {
+    this->callHelper(address, llvm::Type::getVoidTy(this->context), {this->vm->getType()}, {this->vm});
+  }
+
+  llvm::Value* field(llvm::Value* variable, unsigned index) {
+    return this->builder.CreateStructGEP(this->variableType, variable, index);
+  }
+
+  llvm::Value* element(llvm::Value* base, std::size_t index) {
+    return this->builder.CreateGEP(this->variableType, base, this->builder.getInt64(index));
+  }
+
+  llvm::Value* typeCode(VariableType type) {
+    return this->builder.getInt32(static_cast<std::uint32_t>(type));
+  }
+
+  llvm::Value* loadType(std::size_t slot) {
+    return this->builder.CreateLoad(this->i32, this->types.at(slot));
+  }
+
+  llvm::Value* loadValue(std::size_t slot) {
+    return this->builder.CreateLoad(this->i64, this->values.at(slot));
+  }
+
+  void storeSlot(std::size_t slot, llvm::Value* type, llvm::Value* value) {
+    this->builder.CreateStore(type, this->types.at(slot));
+    this->builder.CreateStore(value, this->values.at(slot));
+  }
+
+  void push(std::size_t slot) {
+    this->builder.CreateStore(this->loadType(slot), this->field(this->scratch, 0));
+    this->builder.CreateStore(this->loadValue(slot), this->field(this->scratch, 1));
+    this->callHelper(
+      this->helpers.pushOperand,
+      llvm::Type::getVoidTy(this->context),
+      {this->vm->getType(), this->scratch->getType()},
+      {this->vm, this->scratch});
+  }
+
+  void pop(std::size_t slot) {
+    this->callHelper(
+      this->helpers.popOperand,
+      llvm::Type::getVoidTy(this->context),
+      {this->vm->getType(), this->scratch->getType()},
+      {this->vm, this->scratch});
+    this->storeSlot(
+      slot,
+      this->builder.CreateLoad(this->i32, this->field(this->scratch, 0)),
+      this->builder.CreateLoad(this->i64, this->field(this->scratch, 1)));
+  }
+
+  void pushAll(std::size_t depth) {
+    for (std::size_t i = 0; i < depth; i++) {
+      this->push(i);
+    }
+  }
+
+  void popAll(std::size_t depth) {
+    for (std::size_t i = depth; i-- > 0;) {
+      this->pop(i);
+    }
+  }
+
+  void storeProgramCounter(std::size_t pc) {
+    this->builder.CreateStore(this->builder.getInt64(pc), this->programCounter);
+  }
+
+  // hands the frame back to the interpreter at pc
+  void exitAt(std::size_t pc, std::size_t depth) {
+    this->pushAll(depth);
+    this->storeProgramCounter(pc);
+    this->builder.CreateRetVoid();
+  }
+
+  void continueAt(std::size_t pc, std::size_t depth) {
+    if (pc < this->size && this->blocks.at(pc) != nullptr) {
+      this->builder.CreateBr(this->blocks.at(pc));
+    } else {
+      this->exitAt(pc, depth);
+    }
+  }
+
+  // runs the instruction through its runtime helper with the whole op stack in place
+  void lowerGeneric(std::size_t pc, std::size_t depth, std::uintptr_t helper) {
+    const auto& bc = this->byteCode.at(pc);
+    auto effect = bytecode::stackEffect(bc, this->file.functions, this->file.objects);
+    std::size_t next = depth - effect.pops + effect.pushes;
+
+    this->pushAll(depth);
+    this->storeProgramCounter(pc);
+    this->callHelper(helper);
+    this->popAll(next);
+    this->continueAt(pc + 1, next);
+  }
+
+  void lowerLoad(std::size_t pc, std::size_t depth, llvm::Value* base) {
+    auto variable = this->element(base, this->byteCode.at(pc).parameter);
+
+    this->storeSlot(
+      depth,
+      this->builder.CreateLoad(this->i32, this->field(variable, 0)),
+      this->builder.CreateLoad(this->i64, this->field(variable, 1)));
+    this->continueAt(pc + 1, depth + 1);
+  }
+
+  void lowerStore(std::size_t pc, std::size_t depth, llvm::Value* base) {
+    auto variable = this->element(base, this->byteCode.at(pc).parameter);
+
+    this->builder.CreateStore(this->loadType(depth - 1), this->field(variable, 0));
+    this->builder.CreateStore(this->loadValue(depth - 1), this->field(variable, 1));
+    this->continueAt(pc + 1, depth - 1);
+  }
+
+  void lowerConstant(std::size_t pc, std::size_t depth, VariableType type, std::uint64_t value) {
+    this->storeSlot(depth, this->typeCode(type), this->builder.getInt64(value));
+    this->continueAt(pc + 1, depth + 1);
+  }
+
+  static bool isQuickened(bytecode::ByteCodeInstruction instruction) {
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::AddIntInt:
+      case bytecode::ByteCodeInstruction::SubtractIntInt:
+      case bytecode::ByteCodeInstruction::MultiplyIntInt:
+      case bytecode::ByteCodeInstruction::DivideIntInt:
+      case bytecode::ByteCodeInstruction::LessIntInt:
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt:
+      case bytecode::ByteCodeInstruction::GreaterIntInt:
+      case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt:
+        return true;
+      default:
+        return isFloatOperation(instruction);
+    }
+  }
+
+  static bool isFloatOperation(bytecode::ByteCodeInstruction instruction) {
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::AddFloatFloat:
+      case bytecode::ByteCodeInstruction::SubtractFloatFloat:
+      case bytecode::ByteCodeInstruction::MultiplyFloatFloat:
+      case bytecode::ByteCodeInstruction::DivideFloatFloat:
+      case bytecode::ByteCodeInstruction::LessFloatFloat:
+      case bytecode::ByteCodeInstruction::LessOrEqualFloatFloat:
+      case bytecode::ByteCodeInstruction::GreaterFloatFloat:
+      case bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // the result of a quickened instruction on operands already known to have its type
+  std::pair<llvm::Value*, VariableType> quickenedResult(bytecode::ByteCodeInstruction instruction, llvm::Value* a, llvm::Value* b) {
+    auto real = [this](llvm::Value* value) { return this->builder.CreateBitCast(value, this->f64); };
+    auto bits = [this](llvm::Value* value) { return this->builder.CreateBitCast(value, this->i64); };
+    auto boolean = [this](llvm::Value* value) { return this->builder.CreateZExt(value, this->i64); };
+
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::AddIntInt: return {this->builder.CreateAdd(a, b), VariableType::Integer};
+      case bytecode::ByteCodeInstruction::SubtractIntInt: return {this->builder.CreateSub(a, b), VariableType::Integer};
+      case bytecode::ByteCodeInstruction::MultiplyIntInt: return {this->builder.CreateMul(a, b), VariableType::Integer};
+      case bytecode::ByteCodeInstruction::DivideIntInt: return {this->builder.CreateSDiv(a, b), VariableType::Integer};
+      case bytecode::ByteCodeInstruction::LessIntInt: return {boolean(this->builder.CreateICmpSLT(a, b)), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt: return {boolean(this->builder.CreateICmpSLE(a, b)), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::GreaterIntInt: return {boolean(this->builder.CreateICmpSGT(a, b)), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt: return {boolean(this->builder.CreateICmpSGE(a, b)), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::AddFloatFloat: return {bits(this->builder.CreateFAdd(real(a), real(b))), VariableType::Float};
+      case bytecode::ByteCodeInstruction::SubtractFloatFloat: return {bits(this->builder.CreateFSub(real(a), real(b))), VariableType::Float};
+      case bytecode::ByteCodeInstruction::MultiplyFloatFloat: return {bits(this->builder.CreateFMul(real(a), real(b))), VariableType::Float};
+      case bytecode::ByteCodeInstruction::DivideFloatFloat: return {bits(this->builder.CreateFDiv(real(a), real(b))), VariableType::Float};
+      case bytecode::ByteCodeInstruction::LessFloatFloat: return {boolean(this->builder.CreateFCmpOLT(real(a), real(b))), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::LessOrEqualFloatFloat: return {boolean(this->builder.CreateFCmpOLE(real(a), real(b))), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::GreaterFloatFloat: return {boolean(this->builder.CreateFCmpOGT(real(a), real(b))), VariableType::Boolean};
+      case bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat: return {boolean(this->builder.CreateFCmpOGE(real(a), real(b))), VariableType::Boolean};
+      default: return {nullptr, VariableType::Undefined};
+    }
+  }
+
+  // inline fast path when both operands have the quickened type, the runtime
+  // helper handles everything else including dequickening
+  void lowerQuickened(std::size_t pc, std::size_t depth, std::uintptr_t helper) {
+    auto instruction = this->byteCode.at(pc).instruction;
+    auto operandType = this->typeCode(isFloatOperation(instruction) ? VariableType::Float : VariableType::Integer);
+
+    auto fast = llvm::BasicBlock::Create(this->context, "fast" + std::to_string(pc), this->function);
+    auto slow = llvm::BasicBlock::Create(this->context, "slow" + std::to_string(pc), this->function);
+
+    auto isFast = this->builder.CreateAnd(
+      this->builder.CreateICmpEQ(this->loadType(depth - 2), operandType),
+      this->builder.CreateICmpEQ(this->loadType(depth - 1), operandType));
+    this->builder.CreateCondBr(isFast, fast, slow);
+
+    this->builder.SetInsertPoint(fast);
+    auto a = this->loadValue(depth - 2);
+    auto b = this->loadValue(depth - 1);
+
+    if (instruction == bytecode::ByteCodeInstruction::DivideIntInt) {
+      // division by zero yields undefined and the most negative number
+      // divided by -1 traps, the helper takes care of both
+      auto divide = llvm::BasicBlock::Create(this->context, "divide" + std::to_string(pc), this->function);
+      auto isSafe = this->builder.CreateAnd(
+        this->builder.CreateICmpNE(b, this->builder.getInt64(0)),
+        this->builder.CreateICmpNE(b, this->builder.getInt64(static_cast<std::uint64_t>(-1))));
+      this->builder.CreateCondBr(isSafe, divide, slow);
+      this->builder.SetInsertPoint(divide);
+    }
+
+    auto result = this->quickenedResult(instruction, a, b);
+    this->storeSlot(depth - 2, this->typeCode(result.second), result.first);
+    this->continueAt(pc + 1, depth - 1);
+
+    this->builder.SetInsertPoint(slow);
+    this->lowerGeneric(pc, depth, helper);
+  }
+
+  void lowerJumpIfFalse(std::size_t pc, std::size_t depth) {
+    std::size_t target = this->byteCode.at(pc).parameter;
+
+    auto fast = llvm::BasicBlock::Create(this->context, "fast" + std::to_string(pc), this->function);
+    auto slow = llvm::BasicBlock::Create(this->context, "slow" + std::to_string(pc), this->function);
+    auto taken = this->blocks.at(target);
+    auto notTaken = llvm::BasicBlock::Create(this->context, "next" + std::to_string(pc), this->function);
+
+    auto isBoolean = this->builder.CreateICmpEQ(this->loadType(depth - 1), this->typeCode(VariableType::Boolean));
+    this->builder.CreateCondBr(isBoolean, fast, slow);
+
+    this->builder.SetInsertPoint(fast);
+    auto value = this->builder.CreateTrunc(this->loadValue(depth - 1), this->i8);
+    this->builder.CreateCondBr(this->builder.CreateICmpNE(value, this->builder.getInt8(0)), notTaken, taken);
+
+    this->builder.SetInsertPoint(slow);
+    this->pushAll(depth);
+    this->storeProgramCounter(pc);
+    auto jumped = this->callHelper(this->helpers.jumpIfFalse, this->i8, {this->vm->getType()}, {this->vm});
+    this->popAll(depth - 1);
+    this->builder.CreateCondBr(this->builder.CreateICmpNE(jumped, this->builder.getInt8(0)), taken, notTaken);
+
+    this->builder.SetInsertPoint(notTaken);
+    this->continueAt(pc + 1, depth - 1);
+  }
+
+  void lowerInstruction(std::size_t pc, std::size_t depth) {
+    const auto& bc = this->byteCode.at(pc);
+    std::uintptr_t helper = this->helpers.generic(bc.instruction);
+
+    switch (bc.instruction) {
+      case bytecode::ByteCodeInstruction::LoadIntegerConstant: {
+        if (bc.parameter >= this->file.intConstants.size()) {
+          break;
+        }
+        this->lowerConstant(pc, depth, VariableType::Integer, static_cast<std::uint64_t>(this->file.intConstants.at(bc.parameter)));
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LoadFloatConstant: {
+        if (bc.parameter >= this->file.floatConstants.size()) {
+          break;
+        }
+        double value = this->file.floatConstants.at(bc.parameter);
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        this->lowerConstant(pc, depth, VariableType::Float, bits);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LoadBooleanTrueConstant:
+        this->lowerConstant(pc, depth, VariableType::Boolean, 1);
+        return;
+      case bytecode::ByteCodeInstruction::LoadBooleanFalseConstant:
+        this->lowerConstant(pc, depth, VariableType::Boolean, 0);
+        return;
+      case bytecode::ByteCodeInstruction::LoadUndefinedConstant:
+        this->lowerConstant(pc, depth, VariableType::Undefined, 0);
+        return;
+      case bytecode::ByteCodeInstruction::LoadLocal: {
+        if (bc.parameter >= this->fn.localsCount) {
+          break;
+        }
+        this->lowerLoad(pc, depth, this->locals);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LoadGlobal: {
+        if (bc.parameter >= this->file.globalsCount) {
+          break;
+        }
+        this->lowerLoad(pc, depth, this->globals);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::SetLocal: {
+        if (bc.parameter >= this->fn.localsCount) {
+          break;
+        }
+        this->lowerStore(pc, depth, this->locals);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::SetGlobal: {
+        if (bc.parameter >= this->file.globalsCount) {
+          break;
+        }
+        this->lowerStore(pc, depth, this->globals);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::Pop:
+        this->continueAt(pc + 1, depth - 1);
+        return;
+      case bytecode::ByteCodeInstruction::NoOp:
+        this->continueAt(pc + 1, depth);
+        return;
+      case bytecode::ByteCodeInstruction::Jump:
+        this->builder.CreateBr(this->blocks.at(bc.parameter));
+        return;
+      case bytecode::ByteCodeInstruction::JumpIfFalse:
+        this->lowerJumpIfFalse(pc, depth);
+        return;
+      case bytecode::ByteCodeInstruction::Return:
+      case bytecode::ByteCodeInstruction::Invoke:
+      case bytecode::ByteCodeInstruction::CallKnown:
+        this->pushAll(depth);
+        this->storeProgramCounter(pc);
+        this->callHelper(helper);
+        this->builder.CreateRetVoid();
+        return;
+      default:
+        if (helper != 0 && isQuickened(bc.instruction)) {
+          this->lowerQuickened(pc, depth, helper);
+          return;
+        }
+        break;
+    }
+
+    if (helper == 0) {
+      // Halt and anything unknown is left to the interpreter
+      this->exitAt(pc, depth);
+    } else {
+      this->lowerGeneric(pc, depth, helper);
+    }
+  }
+};
+
+static void optimize(llvm::Module& module, llvm::TargetMachine* targetMachine) {
+  llvm::LoopAnalysisManager loopAnalysis;
+  llvm::FunctionAnalysisManager functionAnalysis;
+  llvm::CGSCCAnalysisManager cgsccAnalysis;
+  llvm::ModuleAnalysisManager moduleAnalysis;
+
+  llvm::PassBuilder passBuilder{targetMachine};
+  passBuilder.registerModuleAnalyses(moduleAnalysis);
+  passBuilder.registerCGSCCAnalyses(cgsccAnalysis);
+  passBuilder.registerFunctionAnalyses(functionAnalysis);
+  passBuilder.registerLoopAnalyses(loopAnalysis);
+  passBuilder.crossRegisterProxies(loopAnalysis, functionAnalysis, cgsccAnalysis, moduleAnalysis);
+
+  auto passes = passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+  passes.run(module, moduleAnalysis);
+}
+
+// runs on the compile thread
+jit::CompileResult VirtualMachine::compileLlvm(
+  const bytecode::CompiledFile& file,
+  const bytecode::Function& fn,
+  const std::vector<bytecode::ByteCode>& byteCode
+) {
+  LlvmEnvironment* environment = llvmEnvironment();
+
+  if (environment == nullptr || byteCode.empty()) {
+    return jit::CompileResult{nullptr, {}};
+  }
+
+  LlvmHelpers helpers{
+    &VirtualMachine::nativeHelper,
+    &VirtualMachine::changesStackFrame,
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeJumpIfFalse),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePushOperand),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePopOperand),
+  };
+
+  std::string name = "flang_function_" + std::to_string(environment->functionCount++);
+
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto module = std::make_unique<llvm::Module>(name, *context);
+  module->setDataLayout(environment->jit->getDataLayout());
+  module->setTargetTriple(environment->jit->getTargetTriple().str());
+
+  LlvmLowering lowering{file, fn, byteCode, helpers, *module};
+
+  if (!lowering.lower(name)) {
+    return jit::CompileResult{nullptr, {}};
+  }
+
+  optimize(*module, environment->targetMachine.get());
+
+  auto tracker = environment->jit->getMainJITDylib().createResourceTracker();
+
+  if (auto error = environment->jit->addIRModule(tracker, llvm::orc::ThreadSafeModule{std::move(module), std::move(context)})) {
+    llvm::consumeError(std::move(error));
+    return jit::CompileResult{nullptr, {}};
+  }
+
+  auto symbol = environment->jit->lookup(name);
+
+  if (!symbol) {
+    llvm::consumeError(symbol.takeError());
+    llvm::consumeError(tracker->remove());
+    return jit::CompileResult{nullptr, {}};
+  }
+
+  auto code = std::make_unique<LlvmCode>(tracker, reinterpret_cast<void (*)(void*, std::size_t, void*, void*, void*)>(symbol->getAddress()));
+
+  return jit::CompileResult{std::move(code), std::move(lowering.entries)};
+}
+
+#else
+
+jit::CompileResult VirtualMachine::compileLlvm(
+  const bytecode::CompiledFile& /*file*/,
+  const bytecode::Function& /*fn*/,
+  const std::vector<bytecode::ByteCode>& /*byteCode*/
+) {
+  return jit::CompileResult{nullptr, {}};
+}
+
+#endif
+
+}
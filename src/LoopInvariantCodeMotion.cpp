@@ -0,0 +1,254 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+class Loop {
+public:
+  ir::BlockId header;
+  std::vector<bool> contains;
+  std::size_t size;
+};
+
+class LoopInvariantCodeMotion {
+private:
+  ir::Function& fn;
+  std::vector<Loop> loops;
+
+  // a back edge runs from a block the header dominates, everything that
+  // reaches that block without passing the header is in the loop
+  std::vector<Loop> findLoops() const {
+    auto idom = this->fn.immediateDominators();
+    std::vector<Loop> loops;
+
+    for (ir::BlockId header = 1; header < this->fn.blocks.size(); header++) {
+      Loop loop{header, std::vector<bool>(this->fn.blocks.size(), false), 1};
+      loop.contains.at(header) = true;
+      std::vector<ir::BlockId> work;
+
+      for (auto predecessor : this->fn.blocks.at(header).predecessors) {
+        if (ir::Function::dominates(idom, header, predecessor)) {
+          work.push_back(predecessor);
+        }
+      }
+
+      if (work.empty()) {
+        continue;
+      }
+
+      while (!work.empty()) {
+        ir::BlockId block = work.back();
+        work.pop_back();
+
+        if (loop.contains.at(block)) {
+          continue;
+        }
+
+        loop.contains.at(block) = true;
+        loop.size++;
+        const auto& predecessors = this->fn.blocks.at(block).predecessors;
+        work.insert(work.end(), predecessors.begin(), predecessors.end());
+      }
+
+      loops.push_back(std::move(loop));
+    }
+
+    // inner loops first, what they hoist can then leave the outer loop too
+    std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+      return a.size < b.size;
+    });
+
+    return loops;
+  }
+
+  // the one block that runs right before the header when the loop is entered,
+  // made when the edge in is a branch. nullopt when the loop has several entries
+  std::optional<ir::BlockId> preheader(const Loop& loop) {
+    std::optional<std::size_t> entry;
+    const auto& predecessors = this->fn.blocks.at(loop.header).predecessors;
+
+    for (std::size_t i = 0; i < predecessors.size(); i++) {
+      if (loop.contains.at(predecessors.at(i))) {
+        continue;
+      }
+      if (entry) {
+        return std::nullopt;
+      }
+      entry = i;
+    }
+
+    if (!entry) {
+      return std::nullopt;
+    }
+
+    ir::BlockId outside = predecessors.at(entry.value());
+    const auto& successors = this->fn.blocks.at(outside).terminator.successors;
+
+    // block 0 keeps nothing but the initial values
+    if (outside != 0 && successors.size() == 1) {
+      return outside;
+    }
+
+    if (std::count(successors.begin(), successors.end(), loop.header) != 1) {
+      return std::nullopt;
+    }
+
+    // the new block takes the place of outside in the header's predecessors,
+    // so the phi operands stay where they are
+    ir::BlockId block = this->fn.blocks.size();
+    this->fn.blocks.push_back(ir::Block{{}, ir::Terminator{ir::TerminatorKind::Jump, std::nullopt, {loop.header}}, {outside}});
+
+    // it sits in every loop the block it is entered from is in
+    for (auto& other : this->loops) {
+      other.contains.push_back(other.contains.at(outside));
+    }
+    this->fn.blocks.at(loop.header).predecessors.at(entry.value()) = block;
+
+    auto& edges = this->fn.blocks.at(outside).terminator.successors;
+    std::replace(edges.begin(), edges.end(), loop.header, block);
+    return block;
+  }
+
+  static bool isConstant(const ir::Instruction& instruction) {
+    if (instruction.kind != ir::InstructionKind::Operation) {
+      return false;
+    }
+
+    switch (instruction.op) {
+      case ByteCodeInstruction::LoadIntegerConstant:
+      case ByteCodeInstruction::LoadFloatConstant:
+      case ByteCodeInstruction::LoadStringConstant:
+      case ByteCodeInstruction::LoadUndefinedConstant:
+      case ByteCodeInstruction::LoadBooleanTrueConstant:
+      case ByteCodeInstruction::LoadBooleanFalseConstant:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void moveTo(ir::BlockId target, ir::ValueId id) {
+    auto& from = this->fn.blocks.at(this->fn.values.at(id).block).instructions;
+    from.erase(std::find(from.begin(), from.end(), id));
+    this->fn.blocks.at(target).instructions.push_back(id);
+    this->fn.values.at(id).block = target;
+  }
+
+  bool isHoistable(const Loop& loop, ir::ValueId id, const std::vector<ir::ValueId>& writes) const {
+    const auto& instruction = this->fn.values.at(id);
+
+    if (instruction.kind != ir::InstructionKind::Operation || !instruction.hasResult) {
+      return false;
+    }
+
+    auto effects = ir::effectsOf(instruction.op);
+
+    if (effects.writes != ir::Memory::None || effects.isObservable || effects.allocates) {
+      return false;
+    }
+
+    // constants are loaded again at every use anyway, and an integer divide
+    // can trap so it must not run on paths that skipped it
+    if (isConstant(instruction) || instruction.op == ByteCodeInstruction::Divide
+      || instruction.op == ByteCodeInstruction::DivideIntInt) {
+      return false;
+    }
+
+    for (auto operand : instruction.operands) {
+      const auto& value = this->fn.values.at(operand);
+      if (loop.contains.at(value.block) && !isConstant(value)) {
+        return false;
+      }
+    }
+
+    for (auto write : writes) {
+      if (ir::Effects::clobbers(this->fn.values.at(write), instruction)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool hoist(std::size_t index) {
+    std::vector<ir::ValueId> writes;
+    const auto& loop = this->loops.at(index);
+
+    for (ir::BlockId block = 0; block < this->fn.blocks.size(); block++) {
+      if (!loop.contains.at(block)) {
+        continue;
+      }
+      for (auto id : this->fn.blocks.at(block).instructions) {
+        if (ir::effectsOf(this->fn.values.at(id).op).writes != ir::Memory::None
+          && this->fn.values.at(id).kind == ir::InstructionKind::Operation) {
+          writes.push_back(id);
+        }
+      }
+    }
+
+    std::optional<ir::BlockId> target;
+    bool changed = false;
+
+    // reverse postorder puts every operand ahead of its uses, so a value
+    // whose operands were just hoisted is hoisted right after them
+    for (auto block : this->fn.reversePostOrder()) {
+      if (!loop.contains.at(block)) {
+        continue;
+      }
+
+      auto instructions = this->fn.blocks.at(block).instructions;
+
+      for (auto id : instructions) {
+        if (!this->isHoistable(loop, id, writes)) {
+          continue;
+        }
+
+        if (!target) {
+          target = this->preheader(loop);
+          if (!target) {
+            return changed;
+          }
+        }
+
+        // the preheader dominates the loop, so the constants still reach
+        // their other uses
+        for (auto operand : this->fn.values.at(id).operands) {
+          if (loop.contains.at(this->fn.values.at(operand).block)) {
+            this->moveTo(target.value(), operand);
+          }
+        }
+
+        this->moveTo(target.value(), id);
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+public:
+  explicit LoopInvariantCodeMotion(ir::Function& fn)
+  : fn{fn}
+  {}
+
+  bool run() {
+    bool changed = false;
+    this->loops = this->findLoops();
+
+    for (std::size_t i = 0; i < this->loops.size(); i++) {
+      changed = this->hoist(i) || changed;
+    }
+
+    return changed;
+  }
+};
+
+bool hoistLoopInvariants(Program& program) {
+  return ir::transform(program, [](ir::Function& fn) {
+    return LoopInvariantCodeMotion{fn}.run();
+  });
+}
+
+};
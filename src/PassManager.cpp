@@ -0,0 +1,250 @@
+#include "PassManager.hpp"
+
+#include <cstring>
+
+namespace compiler {
+
+FunctionBody::FunctionBody(const bytecode::Function& fn) noexcept
+: argumentCount{fn.argumentCount}
+, localsCount{fn.localsCount}
+, closures{fn.closures}
+, byteCode{fn.byteCode}
+{}
+
+bytecode::Function FunctionBody::toFunction() const noexcept {
+  return bytecode::Function{this->argumentCount, this->localsCount, this->closures, this->byteCode};
+}
+
+Program::Program(const bytecode::CompiledFile& file) noexcept
+: entrypoint{file.entrypoint}
+, globalsCount{file.globalsCount}
+, functions{file.functions.begin(), file.functions.end()}
+, objects{file.objects}
+, intConstants{file.intConstants}
+, floatConstants{file.floatConstants}
+, stringConstants{file.stringConstants}
+{}
+
+std::shared_ptr<bytecode::CompiledFile> Program::toCompiledFile() const noexcept {
+  std::vector<bytecode::Function> fns;
+  fns.reserve(this->functions.size());
+
+  for (const auto& fn : this->functions) {
+    fns.push_back(fn.toFunction());
+  }
+
+  return std::make_shared<bytecode::CompiledFile>(
+    this->entrypoint.toFunction(),
+    this->globalsCount,
+    std::move(fns),
+    this->objects,
+    this->intConstants,
+    this->floatConstants,
+    this->stringConstants);
+}
+
+std::size_t Program::intConstant(std::int64_t value) {
+  auto find = std::find(this->intConstants.begin(), this->intConstants.end(), value);
+
+  if (find != this->intConstants.end()) {
+    return static_cast<std::size_t>(find - this->intConstants.begin());
+  }
+
+  this->intConstants.push_back(value);
+  return this->intConstants.size() - 1;
+}
+
+std::size_t Program::floatConstant(double value) {
+  // compare bits so 0.0 and -0.0 stay apart
+  for (std::size_t i = 0; i < this->floatConstants.size(); i++) {
+    if (std::memcmp(&this->floatConstants.at(i), &value, sizeof(value)) == 0) {
+      return i;
+    }
+  }
+
+  this->floatConstants.push_back(value);
+  return this->floatConstants.size() - 1;
+}
+
+std::size_t Program::stringConstant(const std::string& value) {
+  auto find = std::find(this->stringConstants.begin(), this->stringConstants.end(), value);
+
+  if (find != this->stringConstants.end()) {
+    return static_cast<std::size_t>(find - this->stringConstants.begin());
+  }
+
+  this->stringConstants.push_back(value);
+  return this->stringConstants.size() - 1;
+}
+
+void Program::forEachFunction(const std::function<void(FunctionBody&)>& visit) {
+  visit(this->entrypoint);
+
+  for (auto& fn : this->functions) {
+    visit(fn);
+  }
+}
+
+static bool isJump(bytecode::ByteCodeInstruction instruction) {
+  return instruction == bytecode::ByteCodeInstruction::Jump || instruction == bytecode::ByteCodeInstruction::JumpIfFalse;
+}
+
+void removeInstructions(FunctionBody& fn, const std::vector<bool>& isRemoved) noexcept {
+  std::size_t size = fn.byteCode.size();
+
+  // newIndex[i] is where instruction i, or the first kept one after it, ends up
+  std::vector<std::size_t> newIndex(size + 1);
+  std::size_t kept = 0;
+
+  for (std::size_t i = 0; i < size; i++) {
+    newIndex.at(i) = kept;
+    if (!isRemoved.at(i)) {
+      kept++;
+    }
+  }
+  newIndex.at(size) = kept;
+
+  std::vector<bytecode::ByteCode> byteCode;
+  byteCode.reserve(kept);
+
+  for (std::size_t i = 0; i < size; i++) {
+    if (isRemoved.at(i)) {
+      continue;
+    }
+
+    auto bc = fn.byteCode.at(i);
+
+    if (isJump(bc.instruction)) {
+      bc.parameter = newIndex.at(std::min(bc.parameter, size));
+    }
+
+    byteCode.push_back(bc);
+  }
+
+  fn.byteCode = std::move(byteCode);
+}
+
+bool eliminateUnreachableCode(Program& program) {
+  bool changed = false;
+
+  program.forEachFunction([&changed](FunctionBody& fn) {
+    std::size_t size = fn.byteCode.size();
+    std::vector<bool> isRemoved(size, true);
+    std::vector<std::size_t> work;
+
+    auto reach = [&isRemoved, &work, size](std::size_t pc) {
+      if (pc < size && isRemoved.at(pc)) {
+        isRemoved.at(pc) = false;
+        work.push_back(pc);
+      }
+    };
+
+    reach(0);
+
+    while (!work.empty()) {
+      std::size_t pc = work.back();
+      work.pop_back();
+
+      const auto& bc = fn.byteCode.at(pc);
+
+      switch (bc.instruction) {
+        case bytecode::ByteCodeInstruction::Halt:
+        case bytecode::ByteCodeInstruction::Return:
+          break;
+
+        case bytecode::ByteCodeInstruction::Jump:
+          reach(bc.parameter);
+          break;
+
+        case bytecode::ByteCodeInstruction::JumpIfFalse:
+          reach(bc.parameter);
+          reach(pc + 1);
+          break;
+
+        default:
+          reach(pc + 1);
+          break;
+      }
+    }
+
+    if (std::find(isRemoved.begin(), isRemoved.end(), true) == isRemoved.end()) {
+      return;
+    }
+
+    removeInstructions(fn, isRemoved);
+    changed = true;
+  });
+
+  return changed;
+}
+
+void PassManager::add(Pass pass) {
+  this->passes.push_back(std::move(pass));
+}
+
+std::shared_ptr<bytecode::CompiledFile> PassManager::run(std::shared_ptr<bytecode::CompiledFile> file) {
+  bool hasPasses = std::any_of(this->passes.begin(), this->passes.end(), [this](const Pass& pass) {
+    return pass.minimumLevel <= this->level;
+  });
+
+  if (!hasPasses) {
+    return file;
+  }
+
+  Program program{*file};
+  bool changed = false;
+
+  for (const auto& pass : this->passes) {
+    if (pass.minimumLevel > this->level) {
+      continue;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool passChanged = pass.run(program);
+    auto time = std::chrono::steady_clock::now() - start;
+
+    this->timings.push_back(PassTiming{pass.name, std::chrono::duration_cast<std::chrono::nanoseconds>(time), passChanged});
+    changed = changed || passChanged;
+  }
+
+  if (!changed) {
+    return file;
+  }
+
+  return program.toCompiledFile();
+}
+
+void PassManager::printTimings(std::ostream & os) const {
+  auto milliseconds = [](std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+  };
+
+  std::chrono::nanoseconds total{0};
+
+  for (const auto& timing : this->timings) {
+    os << "Pass " << timing.name << ": " << milliseconds(timing.time) << " ms"
+      << (timing.changed ? ", changed" : "") << '\n';
+    total += timing.time;
+  }
+
+  os << "Passes total: " << milliseconds(total) << " ms" << std::endl;
+}
+
+PassManager PassManager::withDefaultPasses(OptimizationLevel level, std::size_t inlineBudget) {
+  PassManager passManager{level};
+
+  passManager.add(Pass{"unreachable-code", OptimizationLevel::O1, eliminateUnreachableCode});
+  passManager.add(Pass{"inlining", OptimizationLevel::O2, [inlineBudget](Program& program) {
+    return inlineFunctions(program, inlineBudget);
+  }});
+  passManager.add(Pass{"scalar-replacement", OptimizationLevel::O2, replaceObjects});
+  passManager.add(Pass{"constant-folding", OptimizationLevel::O1, foldConstants});
+  passManager.add(Pass{"value-numbering", OptimizationLevel::O2, numberValues});
+  passManager.add(Pass{"loop-invariants", OptimizationLevel::O2, hoistLoopInvariants});
+  passManager.add(Pass{"control-flow", OptimizationLevel::O1, simplifyControlFlow});
+  passManager.add(Pass{"dead-code", OptimizationLevel::O1, eliminateDeadCode});
+
+  return passManager;
+}
+
+};
@@ -0,0 +1,169 @@
+#include "Profile.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace runtime {
+
+static const std::string profileHeader = "flang-profile 2";
+
+// one character per instruction, '-' stands in for a function without any
+static char feedbackToChar(OperandFeedback feedback) {
+  switch (feedback) {
+    case OperandFeedback::None: return 'n';
+    case OperandFeedback::Integer: return 'i';
+    case OperandFeedback::Float: return 'f';
+    case OperandFeedback::Polymorphic: return 'p';
+  }
+
+  return 'n';
+}
+
+static std::optional<OperandFeedback> charToFeedback(char c) {
+  switch (c) {
+    case 'n': return OperandFeedback::None;
+    case 'i': return OperandFeedback::Integer;
+    case 'f': return OperandFeedback::Float;
+    case 'p': return OperandFeedback::Polymorphic;
+    default: return std::nullopt;
+  }
+}
+
+// only the Invoke sites that saw a callee are written, as pc:target separated
+// by commas with p standing in for a polymorphic site
+static bool readCallTargets(const std::string & text, std::vector<CallTarget>& callTargets) {
+  if (text == "-") {
+    return true;
+  }
+
+  std::istringstream in{text};
+  std::string entry;
+
+  while (std::getline(in, entry, ',')) {
+    std::size_t separator = entry.find(':');
+
+    if (separator == std::string::npos || separator == 0 || separator + 1 == entry.size()) {
+      return false;
+    }
+
+    std::string pcText = entry.substr(0, separator);
+    std::string targetText = entry.substr(separator + 1);
+
+    if (pcText.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+
+    std::size_t pc = std::stoull(pcText);
+
+    if (pc >= callTargets.size()) {
+      return false;
+    }
+
+    if (targetText == "p") {
+      callTargets.at(pc) = polymorphicCallTarget;
+
+    } else if (targetText.find_first_not_of("0123456789") == std::string::npos && targetText.size() < 10) {
+      callTargets.at(pc) = static_cast<CallTarget>(std::stoul(targetText));
+
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void writeCallTargets(std::ostream & out, const std::vector<CallTarget>& callTargets) {
+  bool isEmpty = true;
+
+  for (std::size_t pc = 0; pc < callTargets.size(); pc++) {
+    if (callTargets.at(pc) == noCallTarget) {
+      continue;
+    }
+
+    out << (isEmpty ? "" : ",") << pc << ':';
+
+    if (callTargets.at(pc) == polymorphicCallTarget) {
+      out << 'p';
+    } else {
+      out << callTargets.at(pc);
+    }
+
+    isEmpty = false;
+  }
+
+  if (isEmpty) {
+    out << '-';
+  }
+}
+
+std::optional<Profile> readProfile(std::istream & in) {
+  std::string header;
+
+  if (!std::getline(in, header) || header != profileHeader) {
+    return std::nullopt;
+  }
+
+  Profile profile{0, {}};
+  std::size_t functionCount = 0;
+
+  if (!(in >> std::hex >> profile.fileHash >> std::dec >> functionCount)) {
+    return std::nullopt;
+  }
+
+  for (std::size_t i = 0; i < functionCount; i++) {
+    FunctionProfile function{0, 0, {}, {}};
+    std::string feedback;
+    std::string callTargets;
+
+    if (!(in >> function.entryCount >> function.backEdgeCount >> feedback >> callTargets)) {
+      return std::nullopt;
+    }
+
+    if (feedback != "-") {
+      for (char c : feedback) {
+        auto value = charToFeedback(c);
+
+        if (!value) {
+          return std::nullopt;
+        }
+
+        function.feedback.push_back(value.value());
+      }
+    }
+
+    function.callTargets.assign(function.feedback.size(), noCallTarget);
+
+    if (!readCallTargets(callTargets, function.callTargets)) {
+      return std::nullopt;
+    }
+
+    profile.functions.push_back(std::move(function));
+  }
+
+  return profile;
+}
+
+void writeProfile(std::ostream & out, const Profile& profile) {
+  out << profileHeader << '\n'
+    << std::hex << std::setw(16) << std::setfill('0') << profile.fileHash << std::dec << '\n'
+    << profile.functions.size() << '\n';
+
+  for (const auto& function : profile.functions) {
+    out << function.entryCount << ' ' << function.backEdgeCount << ' ';
+
+    if (function.feedback.empty()) {
+      out << '-';
+    }
+
+    for (auto feedback : function.feedback) {
+      out << feedbackToChar(feedback);
+    }
+
+    out << ' ';
+    writeCallTargets(out, function.callTargets);
+    out << '\n';
+  }
+}
+
+}
@@ -2,61 +2,71 @@
 
 namespace runtime {
 
-enum class VariableType {
-  Undefined,
-  Integer,
-  Boolean,
-  Float,
-  String,
-  Object,
-  Function,
-};
-
-struct Object;
-
-struct ClosureContext {
-  const StackFrame* stackFrame;
-  std::size_t scopeIndex;
-};
-
-struct Function {
-  std::vector<runtime::ClosureContext> captures;
-  std::shared_ptr<StackFrame> scopeOuter;
-  const bytecode::Function* fn;
-};
-
-struct Variable {
-  VariableType type;
-
-  union {
-    std::int64_t integerValue;
-    double doubleValue;
-    bool boolValue;
-    Object* objectValue;
-    Function* functionValue;
-    const std::string* stringValue;
-  };
-};
+void runtime::VirtualMachine::run() noexcept {
 
-struct Object {
-  std::unordered_map<std::string, Variable> properties;
-};
+  this->codeBlocks.clear();
+  this->codeBlocks.reserve(this->file->functions.size() + 1);
+
+  for (const auto& function : this->file->functions) {
+    this->codeBlocks.push_back(CodeBlock{
+      &function,
+      function.byteCode,
+      std::vector<OperandFeedback>(function.byteCode.size(), OperandFeedback::None),
+      std::vector<CallTarget>(function.byteCode.size(), noCallTarget),
+      nullptr,
+      {},
+      false,
+      false,
+      0,
+      0,
+      nullptr,
+      {},
+      false,
+      false
+    });
+  }
+
+  this->codeBlocks.push_back(CodeBlock{
+    &this->file->entrypoint,
+    this->file->entrypoint.byteCode,
+    std::vector<OperandFeedback>(this->file->entrypoint.byteCode.size(), OperandFeedback::None),
+    std::vector<CallTarget>(this->file->entrypoint.byteCode.size(), noCallTarget),
+    nullptr,
+    {},
+    false,
+    false,
+    0,
+    0,
+    nullptr,
+    {},
+    false,
+    false
+  });
+
+  if (this->preloadedProfile) {
+    this->applyProfile(this->preloadedProfile.value());
+  }
+
+  if (this->snapshotState) {
+    this->restoreSnapshot(this->snapshotState.value());
 
-struct StackFrame {
-  std::size_t programCounter;
-  std::vector<Variable> locals;
-  const runtime::Function* function;
-  std::shared_ptr<StackFrame> outer;
-  std::vector<Variable> opStack;
-};
+  } else {
+    runtime::Function* fn = this->heap.NewFunction();
+    fn->captures.clear();
+    fn->scopeOuter = nullptr;
+    fn->fn = &this->file->entrypoint;
+    fn->code = &this->codeBlocks.back();
+    this->pushStackFrame(fn);
 
-void runtime::VirtualMachine::run() noexcept {
+    Variable undefined{};
+    undefined.type = VariableType::Undefined;
+    this->globals.assign(this->file->globalsCount, undefined);
+  }
 
-  runtime::Function* fn = this->heap.NewFunction();
-  fn->captures.clear();
-  fn->scopeOuter = nullptr;
-  fn->fn = &this->file->entrypoint;
-  this->pushStackFrame(fn);
+  if (!this->aotCode.empty() && this->aotCode.size() != this->codeBlocks.size()) {
+    this->panic("Ahead of time code does not match the compiled file!");
+    return;
+  }
 
   this->heap.StartGc();
 
@@ -70,12 +80,36 @@ void runtime::VirtualMachine::run() noexcept {
       std::getline(std::cin, ignore);
     }
 
-    if (this->stackFrame->programCounter >= this->stackFrame->function->fn->byteCode.size()) {
+    if (!this->aotCode.empty()) {
+      CodeBlock* code = this->stackFrame->function->code;
+      std::size_t pc = this->stackFrame->programCounter;
+
+      // Halt, snapshot() and overruns are still handled below
+      if (pc < code->byteCode.size() && !isInterpreterOnly(code->byteCode[pc].instruction)) {
+        this->aotCode[static_cast<std::size_t>(code - this->codeBlocks.data())](this, pc);
+        continue;
+      }
+    }
+
+    if (this->isJitEnabled) {
+      // the top of the loop is the only safe point, no native code is running
+      if (this->compileQueue->hasFinished()) {
+        this->installCompiledCode();
+      }
+
+      if (this->enterNativeCode(this->stackFrame->function->code)) {
+        continue;
+      }
+    }
+
+    const auto& byteCode = this->stackFrame->function->code->byteCode;
+
+    if (this->stackFrame->programCounter >= byteCode.size()) {
       this->panic("Program counter overran bytecode!");
       return;
     }
 
-    auto instruction = this->stackFrame->function->fn->byteCode.at(this->stackFrame->programCounter).instruction;
+    auto instruction = byteCode[this->stackFrame->programCounter].instruction;
 
     switch (instruction) {
       case bytecode::ByteCodeInstruction::Halt: { this->heap.EndGc(); return; }
@@ -95,8 +129,11 @@ void runtime::VirtualMachine::run() noexcept {
       case bytecode::ByteCodeInstruction::LoadBooleanFalseConstant: { this->LoadBooleanFalseConstant(); break; }
       case bytecode::ByteCodeInstruction::LoadLocal: { this->LoadLocal(); break; }
       case bytecode::ByteCodeInstruction::SetLocal: { this->SetLocal(); break; }
+      case bytecode::ByteCodeInstruction::LoadGlobal: { this->LoadGlobal(); break; }
+      case bytecode::ByteCodeInstruction::SetGlobal: { this->SetGlobal(); break; }
       case bytecode::ByteCodeInstruction::Return: { this->Return(); break; }
       case bytecode::ByteCodeInstruction::Invoke: { this->Invoke(); break; }
+      case bytecode::ByteCodeInstruction::CallKnown: { this->CallKnown(); break; }
       case bytecode::ByteCodeInstruction::NoOp: { break; }
       case bytecode::ByteCodeInstruction::MakeFn: { this->MakeFn(); break; }
       case bytecode::ByteCodeInstruction::MakeObj: { this->MakeObj(); break; }
@@ -120,6 +157,29 @@ void runtime::VirtualMachine::run() noexcept {
       case bytecode::ByteCodeInstruction::GetEnv: { this->GetEnv(); break; }
       case bytecode::ByteCodeInstruction::LoadClosure: { this->LoadClosure(); break; }
       case bytecode::ByteCodeInstruction::Pop: { this->Pop(); break; }
+      case bytecode::ByteCodeInstruction::Snapshot: {
+        if (this->Snapshot()) {
+          this->heap.EndGc();
+          return;
+        }
+        break;
+      }
+      case bytecode::ByteCodeInstruction::AddIntInt: { this->AddIntInt(); break; }
+      case bytecode::ByteCodeInstruction::AddFloatFloat: { this->AddFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::SubtractIntInt: { this->SubtractIntInt(); break; }
+      case bytecode::ByteCodeInstruction::SubtractFloatFloat: { this->SubtractFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::MultiplyIntInt: { this->MultiplyIntInt(); break; }
+      case bytecode::ByteCodeInstruction::MultiplyFloatFloat: { this->MultiplyFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::DivideIntInt: { this->DivideIntInt(); break; }
+      case bytecode::ByteCodeInstruction::DivideFloatFloat: { this->DivideFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::LessIntInt: { this->LessIntInt(); break; }
+      case bytecode::ByteCodeInstruction::LessFloatFloat: { this->LessFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt: { this->LessOrEqualIntInt(); break; }
+      case bytecode::ByteCodeInstruction::LessOrEqualFloatFloat: { this->LessOrEqualFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::GreaterIntInt: { this->GreaterIntInt(); break; }
+      case bytecode::ByteCodeInstruction::GreaterFloatFloat: { this->GreaterFloatFloat(); break; }
+      case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt: { this->GreaterOrEqualIntInt(); break; }
+      case bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat: { this->GreaterOrEqualFloatFloat(); break; }
       default: {
         this->panic("Unknown bytecode found in instructions!");
         return;
@@ -164,6 +224,9 @@ void runtime::VirtualMachine::pushStackFrame(const runtime::Function* function)
   newFrame->function = function;
 
   this->stackFrame = newFrame;
+
+  function->code->entryCount++;
+  this->promoteIfHot(function->code);
 }
 
 Variable runtime::VirtualMachine::popOpStack() {
@@ -196,6 +259,12 @@ void runtime::VirtualMachine::Add() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::AddIntInt,
+    bytecode::ByteCodeInstruction::AddFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -218,6 +287,12 @@ void runtime::VirtualMachine::Subtract() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::SubtractIntInt,
+    bytecode::ByteCodeInstruction::SubtractFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -240,6 +315,12 @@ void runtime::VirtualMachine::Multiply() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::MultiplyIntInt,
+    bytecode::ByteCodeInstruction::MultiplyFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -258,10 +339,26 @@ void runtime::VirtualMachine::Multiply() {
   this->advance();
 }
 
+// the divisor is not zero. the most negative number divided by -1 wraps
+// around like the other integer operations instead of trapping
+static std::int64_t integerQuotient(std::int64_t dividend, std::int64_t divisor) {
+  if (divisor == -1) {
+    return static_cast<std::int64_t>(std::uint64_t{0} - static_cast<std::uint64_t>(dividend));
+  }
+
+  return dividend / divisor;
+}
+
 void runtime::VirtualMachine::Divide() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::DivideIntInt,
+    bytecode::ByteCodeInstruction::DivideFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -272,7 +369,7 @@ void runtime::VirtualMachine::Divide() {
       this->pushUndefined();
 
     } else {
-      this->pushInteger(first.integerValue / second.integerValue);
+      this->pushInteger(integerQuotient(first.integerValue, second.integerValue));
     }
 
   } else if (first.type == VariableType::Float) {
@@ -302,7 +399,15 @@ void runtime::VirtualMachine::Read() {
 }
 
 void runtime::VirtualMachine::Jump() {
-  this->stackFrame->programCounter = this->getByteCodeParameter();
+  std::size_t target = this->getByteCodeParameter();
+
+  if (target <= this->stackFrame->programCounter) {
+    auto code = this->stackFrame->function->code;
+    code->backEdgeCount++;
+    this->promoteIfHot(code);
+  }
+
+  this->stackFrame->programCounter = target;
 }
 void runtime::VirtualMachine::JumpIfFalse() {
   Variable top{this->popOpStack()};
@@ -430,6 +535,32 @@ void runtime::VirtualMachine::SetLocal() {
   this->advance();
 }
 
+void runtime::VirtualMachine::LoadGlobal() {
+  auto index = this->getByteCodeParameter();
+
+  if (index >= this->globals.size()) {
+    this->panic("Index out of bounds in LoadGlobal");
+    return;
+  }
+
+  this->pushOpStack(this->globals[index]);
+
+  this->advance();
+}
+
+void runtime::VirtualMachine::SetGlobal() {
+  auto index = this->getByteCodeParameter();
+
+  if (index >= this->globals.size()) {
+    this->panic("Index out of bounds in SetGlobal");
+    return;
+  }
+
+  this->globals[index] = this->popOpStack();
+
+  this->advance();
+}
+
 runtime::Variable runtime::VirtualMachine::loadClosureValue(const runtime::Function* fn, std::size_t index) {
   auto& closures = fn->captures;
 
@@ -478,6 +609,7 @@ void runtime::VirtualMachine::MakeFn() {
 
   runtime::Function* fn = this->heap.NewFunction();
   fn->fn = &this->file->functions.at(index);
+  fn->code = &this->codeBlocks.at(index);
   fn->captures.clear();
 
   for (const auto& closure : fn->fn->closures) {
@@ -528,6 +660,7 @@ void runtime::VirtualMachine::Invoke() {
     return;
   }
 
+  this->recordCallTarget(top.functionValue);
   this->pushStackFrame(top.functionValue);
 
   for (
@@ -539,6 +672,79 @@ void runtime::VirtualMachine::Invoke() {
   }
 }
 
+void runtime::VirtualMachine::CallKnown() {
+
+  std::size_t index = this->getByteCodeParameter();
+
+  if (index >= this->file->functions.size()) {
+    this->panic("Index out of bounds in CallKnown");
+    return;
+  }
+
+  const bytecode::Function* target = &this->file->functions.at(index);
+
+  auto caller = this->stackFrame;
+
+  // a recursive call reuses the running instance so its captures stay valid,
+  // anything else was proven capture free by the compiler
+  const runtime::Function* callee = caller->function;
+
+  if (callee->fn != target) {
+    callee = this->knownFunction(index);
+  }
+
+  if (caller->opStack.size() < target->argumentCount) {
+    this->panic("Not enough arguments on op stack in CallKnown");
+    return;
+  }
+
+  this->pushStackFrame(callee);
+
+  for (std::size_t i = target->argumentCount; i-- > 0;) {
+    this->stackFrame->locals.at(i) = caller->opStack.back();
+    caller->opStack.pop_back();
+  }
+}
+
+void runtime::VirtualMachine::recordCallTarget(const runtime::Function* callee) {
+  auto code = this->stackFrame->function->code;
+  auto& callTarget = code->callTargets[this->stackFrame->programCounter];
+
+  if (callTarget == polymorphicCallTarget) {
+    return;
+  }
+
+  // the entrypoint is never a callee, anything outside the functions is polymorphic
+  auto index = static_cast<std::size_t>(callee->fn - this->file->functions.data());
+  CallTarget observed = index < this->file->functions.size() ? static_cast<CallTarget>(index) : polymorphicCallTarget;
+
+  if (callTarget == noCallTarget) {
+    callTarget = observed;
+
+  } else if (callTarget != observed) {
+    callTarget = polymorphicCallTarget;
+  }
+}
+
+const runtime::Function* runtime::VirtualMachine::knownFunction(std::size_t index) {
+  if (this->knownFunctions.size() <= index) {
+    this->knownFunctions.resize(this->file->functions.size(), nullptr);
+  }
+
+  runtime::Function* fn = this->knownFunctions.at(index);
+
+  if (fn == nullptr) {
+    fn = this->heap.NewFunction();
+    fn->fn = &this->file->functions.at(index);
+    fn->code = &this->codeBlocks.at(index);
+    fn->captures.clear();
+    fn->scopeOuter = nullptr;
+    this->knownFunctions.at(index) = fn;
+  }
+
+  return fn;
+}
+
 void runtime::VirtualMachine::MakeObj() {
 
   std::size_t objIndex = this->getByteCodeParameter();
@@ -567,6 +773,12 @@ void runtime::VirtualMachine::Less() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::LessIntInt,
+    bytecode::ByteCodeInstruction::LessFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -588,6 +800,12 @@ void runtime::VirtualMachine::LessOrEqual() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::LessOrEqualIntInt,
+    bytecode::ByteCodeInstruction::LessOrEqualFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -609,6 +827,12 @@ void runtime::VirtualMachine::Greater() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::GreaterIntInt,
+    bytecode::ByteCodeInstruction::GreaterFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -630,6 +854,12 @@ void runtime::VirtualMachine::GreaterOrEqual() {
   Variable second = this->popOpStack();
   Variable first = this->popOpStack();
 
+  this->quicken(
+    first,
+    second,
+    bytecode::ByteCodeInstruction::GreaterOrEqualIntInt,
+    bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat);
+
   if (!this->protectDifferentTypes(first, second)) {
     this->advance();
     return;
@@ -997,6 +1227,757 @@ void runtime::VirtualMachine::Pop() {
   this->advance();
 }
 
+bool runtime::VirtualMachine::Snapshot() {
+  this->pushUndefined();
+  this->advance();
+
+  if (this->snapshotOut == nullptr) {
+    return false;
+  }
+
+  // the state after the call, so the restored script continues right behind it
+  this->writeSnapshot(*this->snapshotOut);
+  this->isSnapshotWritten = true;
+  return true;
+}
+
+void runtime::VirtualMachine::AddIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Add);
+    return;
+  }
+
+  first->integerValue = first->integerValue + second->integerValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::AddFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Add);
+    return;
+  }
+
+  first->doubleValue = first->doubleValue + second->doubleValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::SubtractIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Subtract);
+    return;
+  }
+
+  first->integerValue = first->integerValue - second->integerValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::SubtractFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Subtract);
+    return;
+  }
+
+  first->doubleValue = first->doubleValue - second->doubleValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::MultiplyIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Multiply);
+    return;
+  }
+
+  first->integerValue = first->integerValue * second->integerValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::MultiplyFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Multiply);
+    return;
+  }
+
+  first->doubleValue = first->doubleValue * second->doubleValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::DivideIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Divide);
+    return;
+  }
+
+  if (second->integerValue == 0) {
+    first->type = VariableType::Undefined;
+
+  } else {
+    first->integerValue = integerQuotient(first->integerValue, second->integerValue);
+  }
+
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::DivideFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Divide);
+    return;
+  }
+
+  first->doubleValue = first->doubleValue / second->doubleValue;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::LessIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Less);
+    return;
+  }
+
+  bool result = first->integerValue < second->integerValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::LessFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Less);
+    return;
+  }
+
+  bool result = first->doubleValue < second->doubleValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::LessOrEqualIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::LessOrEqual);
+    return;
+  }
+
+  bool result = first->integerValue <= second->integerValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::LessOrEqualFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::LessOrEqual);
+    return;
+  }
+
+  bool result = first->doubleValue <= second->doubleValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::GreaterIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Greater);
+    return;
+  }
+
+  bool result = first->integerValue > second->integerValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::GreaterFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::Greater);
+    return;
+  }
+
+  bool result = first->doubleValue > second->doubleValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::GreaterOrEqualIntInt() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Integer, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::GreaterOrEqual);
+    return;
+  }
+
+  bool result = first->integerValue >= second->integerValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::GreaterOrEqualFloatFloat() {
+  Variable* first;
+  Variable* second;
+
+  if (!this->quickenedOperands(VariableType::Float, &first, &second)) {
+    this->dequicken(bytecode::ByteCodeInstruction::GreaterOrEqual);
+    return;
+  }
+
+  bool result = first->doubleValue >= second->doubleValue;
+  first->type = VariableType::Boolean;
+  first->boolValue = result;
+  this->stackFrame->opStack.pop_back();
+  this->advance();
+}
+
+void runtime::VirtualMachine::quicken(
+  Variable first,
+  Variable second,
+  bytecode::ByteCodeInstruction integerInstruction,
+  bytecode::ByteCodeInstruction floatInstruction
+) {
+  auto code = this->stackFrame->function->code;
+  auto& feedback = code->feedback[this->stackFrame->programCounter];
+
+  OperandFeedback observed = OperandFeedback::Polymorphic;
+
+  if (first.type == second.type && first.type == VariableType::Integer) {
+    observed = OperandFeedback::Integer;
+
+  } else if (first.type == second.type && first.type == VariableType::Float) {
+    observed = OperandFeedback::Float;
+  }
+
+  if (feedback == OperandFeedback::None) {
+    feedback = observed;
+
+  } else if (feedback != observed) {
+    feedback = OperandFeedback::Polymorphic;
+  }
+
+  auto& bc = code->byteCode[this->stackFrame->programCounter];
+
+  if (feedback == OperandFeedback::Integer) {
+    bc.instruction = integerInstruction;
+
+  } else if (feedback == OperandFeedback::Float) {
+    bc.instruction = floatInstruction;
+  }
+}
+
+bool runtime::VirtualMachine::quickenedOperands(VariableType type, Variable** first, Variable** second) {
+  auto& opStack = this->stackFrame->opStack;
+
+  if (opStack.size() < 2) {
+    this->panic("Could not read quickened operands, op stack is too small!");
+  }
+
+  *first = &opStack[opStack.size() - 2];
+  *second = &opStack[opStack.size() - 1];
+
+  return (*first)->type == type && (*second)->type == type;
+}
+
+// a guard failed, restore the generic instruction for good and let the
+// interpreter loop execute it without advancing. baseline code compiled
+// while the instruction was quickened would keep failing the same guard, so
+// it is thrown away once it hands back control
+void runtime::VirtualMachine::dequicken(bytecode::ByteCodeInstruction generic) {
+  auto code = this->stackFrame->function->code;
+  code->feedback[this->stackFrame->programCounter] = OperandFeedback::Polymorphic;
+  code->byteCode[this->stackFrame->programCounter].instruction = generic;
+
+  if (code->native != nullptr) {
+    code->isNativeStale = true;
+  }
+}
+
+template<void (VirtualMachine::*handler)()>
+void runtime::VirtualMachine::nativeCall(VirtualMachine* vm) {
+  (vm->*handler)();
+}
+
+// a failed guard restores the generic instruction without advancing, run it
+// right away so the native code stays in step with the program counter
+template<void (VirtualMachine::*quickened)(), void (VirtualMachine::*generic)()>
+void runtime::VirtualMachine::nativeCallQuickened(VirtualMachine* vm) {
+  StackFrame* frame = vm->stackFrame.get();
+  std::size_t pc = frame->programCounter;
+
+  (vm->*quickened)();
+
+  if (frame->programCounter == pc) {
+    (vm->*generic)();
+  }
+}
+
+// returns true when the baseline code should hand back control at the jump
+// target, either to enter optimized code, to install finished compilations
+// or to be recompiled after a dequickening
+bool runtime::VirtualMachine::nativeJump(VirtualMachine* vm) {
+  vm->Jump();
+  auto code = vm->stackFrame->function->code;
+  return (code->optimized != nullptr && code->isOptimizedEntry[vm->stackFrame->programCounter])
+    || code->isNativeStale
+    || vm->compileQueue->hasFinished();
+}
+
+bool runtime::VirtualMachine::nativeJumpIfFalse(VirtualMachine* vm) {
+  std::size_t next = vm->stackFrame->programCounter + 1;
+  vm->JumpIfFalse();
+  return vm->stackFrame->programCounter != next;
+}
+
+#define NATIVE_HELPER(handler) \
+  reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeCall<&VirtualMachine::handler>)
+
+#define NATIVE_QUICKENED_HELPER(quickened, generic) \
+  reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeCallQuickened<&VirtualMachine::quickened, &VirtualMachine::generic>)
+
+// helpers for instructions that run straight through, 0 for everything the
+// template compiler handles itself
+std::uintptr_t runtime::VirtualMachine::nativeHelper(bytecode::ByteCodeInstruction instruction) {
+  switch (instruction) {
+    case bytecode::ByteCodeInstruction::Add: return NATIVE_HELPER(Add);
+    case bytecode::ByteCodeInstruction::Subtract: return NATIVE_HELPER(Subtract);
+    case bytecode::ByteCodeInstruction::Multiply: return NATIVE_HELPER(Multiply);
+    case bytecode::ByteCodeInstruction::Divide: return NATIVE_HELPER(Divide);
+    case bytecode::ByteCodeInstruction::Print: return NATIVE_HELPER(Print);
+    case bytecode::ByteCodeInstruction::Read: return NATIVE_HELPER(Read);
+    case bytecode::ByteCodeInstruction::Jump: return NATIVE_HELPER(Jump);
+    case bytecode::ByteCodeInstruction::LoadIntegerConstant: return NATIVE_HELPER(LoadIntegerConstant);
+    case bytecode::ByteCodeInstruction::LoadFloatConstant: return NATIVE_HELPER(LoadFloatConstant);
+    case bytecode::ByteCodeInstruction::LoadStringConstant: return NATIVE_HELPER(LoadStringConstant);
+    case bytecode::ByteCodeInstruction::LoadUndefinedConstant: return NATIVE_HELPER(LoadUndefinedConstant);
+    case bytecode::ByteCodeInstruction::LoadBooleanTrueConstant: return NATIVE_HELPER(LoadBooleanTrueConstant);
+    case bytecode::ByteCodeInstruction::LoadBooleanFalseConstant: return NATIVE_HELPER(LoadBooleanFalseConstant);
+    case bytecode::ByteCodeInstruction::LoadLocal: return NATIVE_HELPER(LoadLocal);
+    case bytecode::ByteCodeInstruction::SetLocal: return NATIVE_HELPER(SetLocal);
+    case bytecode::ByteCodeInstruction::LoadGlobal: return NATIVE_HELPER(LoadGlobal);
+    case bytecode::ByteCodeInstruction::SetGlobal: return NATIVE_HELPER(SetGlobal);
+    case bytecode::ByteCodeInstruction::LoadClosure: return NATIVE_HELPER(LoadClosure);
+    case bytecode::ByteCodeInstruction::MakeFn: return NATIVE_HELPER(MakeFn);
+    case bytecode::ByteCodeInstruction::MakeObj: return NATIVE_HELPER(MakeObj);
+    case bytecode::ByteCodeInstruction::Less: return NATIVE_HELPER(Less);
+    case bytecode::ByteCodeInstruction::LessOrEqual: return NATIVE_HELPER(LessOrEqual);
+    case bytecode::ByteCodeInstruction::Greater: return NATIVE_HELPER(Greater);
+    case bytecode::ByteCodeInstruction::GreaterOrEqual: return NATIVE_HELPER(GreaterOrEqual);
+    case bytecode::ByteCodeInstruction::Not: return NATIVE_HELPER(Not);
+    case bytecode::ByteCodeInstruction::Equal: return NATIVE_HELPER(Equal);
+    case bytecode::ByteCodeInstruction::NotEqual: return NATIVE_HELPER(NotEqual);
+    case bytecode::ByteCodeInstruction::And: return NATIVE_HELPER(And);
+    case bytecode::ByteCodeInstruction::Or: return NATIVE_HELPER(Or);
+    case bytecode::ByteCodeInstruction::GetType: return NATIVE_HELPER(GetType);
+    case bytecode::ByteCodeInstruction::CastToInt: return NATIVE_HELPER(CastToInt);
+    case bytecode::ByteCodeInstruction::CastToFloat: return NATIVE_HELPER(CastToFloat);
+    case bytecode::ByteCodeInstruction::Length: return NATIVE_HELPER(Length);
+    case bytecode::ByteCodeInstruction::ChatAt: return NATIVE_HELPER(ChatAt);
+    case bytecode::ByteCodeInstruction::StringAppend: return NATIVE_HELPER(StringAppend);
+    case bytecode::ByteCodeInstruction::ObjectGet: return NATIVE_HELPER(ObjectGet);
+    case bytecode::ByteCodeInstruction::ObjectSet: return NATIVE_HELPER(ObjectSet);
+    case bytecode::ByteCodeInstruction::GetEnv: return NATIVE_HELPER(GetEnv);
+    case bytecode::ByteCodeInstruction::Pop: return NATIVE_HELPER(Pop);
+    case bytecode::ByteCodeInstruction::Return: return NATIVE_HELPER(Return);
+    case bytecode::ByteCodeInstruction::Invoke: return NATIVE_HELPER(Invoke);
+    case bytecode::ByteCodeInstruction::CallKnown: return NATIVE_HELPER(CallKnown);
+    case bytecode::ByteCodeInstruction::AddIntInt: return NATIVE_QUICKENED_HELPER(AddIntInt, Add);
+    case bytecode::ByteCodeInstruction::AddFloatFloat: return NATIVE_QUICKENED_HELPER(AddFloatFloat, Add);
+    case bytecode::ByteCodeInstruction::SubtractIntInt: return NATIVE_QUICKENED_HELPER(SubtractIntInt, Subtract);
+    case bytecode::ByteCodeInstruction::SubtractFloatFloat: return NATIVE_QUICKENED_HELPER(SubtractFloatFloat, Subtract);
+    case bytecode::ByteCodeInstruction::MultiplyIntInt: return NATIVE_QUICKENED_HELPER(MultiplyIntInt, Multiply);
+    case bytecode::ByteCodeInstruction::MultiplyFloatFloat: return NATIVE_QUICKENED_HELPER(MultiplyFloatFloat, Multiply);
+    case bytecode::ByteCodeInstruction::DivideIntInt: return NATIVE_QUICKENED_HELPER(DivideIntInt, Divide);
+    case bytecode::ByteCodeInstruction::DivideFloatFloat: return NATIVE_QUICKENED_HELPER(DivideFloatFloat, Divide);
+    case bytecode::ByteCodeInstruction::LessIntInt: return NATIVE_QUICKENED_HELPER(LessIntInt, Less);
+    case bytecode::ByteCodeInstruction::LessFloatFloat: return NATIVE_QUICKENED_HELPER(LessFloatFloat, Less);
+    case bytecode::ByteCodeInstruction::LessOrEqualIntInt: return NATIVE_QUICKENED_HELPER(LessOrEqualIntInt, LessOrEqual);
+    case bytecode::ByteCodeInstruction::LessOrEqualFloatFloat: return NATIVE_QUICKENED_HELPER(LessOrEqualFloatFloat, LessOrEqual);
+    case bytecode::ByteCodeInstruction::GreaterIntInt: return NATIVE_QUICKENED_HELPER(GreaterIntInt, Greater);
+    case bytecode::ByteCodeInstruction::GreaterFloatFloat: return NATIVE_QUICKENED_HELPER(GreaterFloatFloat, Greater);
+    case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt: return NATIVE_QUICKENED_HELPER(GreaterOrEqualIntInt, GreaterOrEqual);
+    case bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat: return NATIVE_QUICKENED_HELPER(GreaterOrEqualFloatFloat, GreaterOrEqual);
+    default: return 0;
+  }
+}
+
+// native code exits in front of these and leaves them to the dispatch loop
+bool runtime::VirtualMachine::isInterpreterOnly(bytecode::ByteCodeInstruction instruction) {
+  return instruction == bytecode::ByteCodeInstruction::Halt || instruction == bytecode::ByteCodeInstruction::Snapshot;
+}
+
+bool runtime::VirtualMachine::changesStackFrame(bytecode::ByteCodeInstruction instruction) {
+  return instruction == bytecode::ByteCodeInstruction::Return
+    || instruction == bytecode::ByteCodeInstruction::Invoke
+    || instruction == bytecode::ByteCodeInstruction::CallKnown;
+}
+
+void runtime::VirtualMachine::nativePushOperand(VirtualMachine* vm, const Variable* value) {
+  vm->pushOpStack(*value);
+}
+
+void runtime::VirtualMachine::nativePopOperand(VirtualMachine* vm, Variable* value) {
+  *value = vm->popOpStack();
+}
+
+// the optimized code has already rebuilt the op stack and program counter
+// of the current frame, interpretation resumes at the failed instruction
+void runtime::VirtualMachine::nativeDeoptimize(VirtualMachine* vm) {
+  vm->stackFrame->function->code->isDeoptimized = true;
+}
+
+// the call target guard of optimized code. returns true without touching
+// anything when the callee is not the function the Invoke has always seen,
+// otherwise it makes the call like Invoke does
+bool runtime::VirtualMachine::nativeInvokeTarget(VirtualMachine* vm, std::size_t target) {
+  auto caller = vm->stackFrame;
+  std::size_t argCount = vm->getByteCodeParameter();
+  auto& opStack = caller->opStack;
+
+  if (opStack.size() <= argCount || target >= vm->file->functions.size()) {
+    return true;
+  }
+
+  std::size_t base = opStack.size() - argCount - 1;
+  const Variable& callee = opStack.at(base);
+
+  if (callee.type != VariableType::Function || callee.functionValue->fn != &vm->file->functions.at(target)) {
+    return true;
+  }
+
+  vm->pushStackFrame(callee.functionValue);
+
+  auto& locals = vm->stackFrame->locals;
+
+  for (std::size_t i = 0; i < argCount && i < locals.size(); i++) {
+    locals.at(i) = opStack.at(base + 1 + i);
+  }
+
+  opStack.resize(base);
+  return false;
+}
+
+#undef NATIVE_QUICKENED_HELPER
+#undef NATIVE_HELPER
+
+void runtime::VirtualMachine::promoteIfHot(CodeBlock* code) {
+  if (!this->isJitEnabled) {
+    return;
+  }
+
+  if (this->backend == jit::Backend::Llvm) {
+    if (code->optimized == nullptr
+      && !code->isOptimizedUnavailable
+      && (code->entryCount >= optimizeEntryThreshold || code->backEdgeCount >= optimizeBackEdgeThreshold)) {
+      this->submitCompilation(code, true);
+    }
+    return;
+  }
+
+  if (code->native == nullptr
+    && !code->isNativeUnavailable
+    && (code->entryCount >= hotEntryThreshold || code->backEdgeCount >= hotBackEdgeThreshold)) {
+    this->submitCompilation(code, false);
+  }
+
+  if (code->optimized == nullptr
+    && !code->isOptimizedUnavailable
+    && (code->entryCount >= optimizeEntryThreshold || code->backEdgeCount >= optimizeBackEdgeThreshold)) {
+    this->submitCompilation(code, true);
+  }
+}
+
+// the compile thread works on a copy of the bytecode since the interpreter
+// keeps quickening it, the function stays unavailable until its code is installed
+void runtime::VirtualMachine::submitCompilation(CodeBlock* code, bool isOptimizing) {
+  auto key = static_cast<std::size_t>(code - this->codeBlocks.data());
+  auto file = this->file;
+  auto fn = code->fn;
+  auto byteCode = code->byteCode;
+
+  if (isOptimizing) {
+    code->isOptimizedUnavailable = true;
+
+    bool isLlvm = this->backend == jit::Backend::Llvm;
+    auto callTargets = code->callTargets;
+
+    this->compileQueue->submit(key, true, [file, fn, byteCode, callTargets, isLlvm]() {
+      return isLlvm ? compileLlvm(*file, *fn, byteCode) : compileOptimized(*file, *fn, byteCode, callTargets);
+    });
+
+  } else {
+    code->isNativeUnavailable = true;
+
+    this->compileQueue->submit(key, false, [file, fn, byteCode]() {
+      return compileNative(*file, *fn, byteCode);
+    });
+  }
+}
+
+void runtime::VirtualMachine::installCompiledCode() {
+  for (auto& task : this->compileQueue->takeFinished()) {
+    CodeBlock& code = this->codeBlocks.at(task.key);
+
+    if (task.result.code == nullptr) {
+      continue;
+    }
+
+    if (task.isOptimizing) {
+      code.optimized = std::move(task.result.code);
+      code.isOptimizedEntry = std::move(task.result.entries);
+      code.isOptimizedUnavailable = false;
+
+    } else {
+      code.native = std::move(task.result.code);
+      code.isNativeEntry = std::move(task.result.entries);
+      code.isNativeUnavailable = false;
+    }
+  }
+}
+
+void runtime::VirtualMachine::setAotCode(std::vector<AotFunction> code) {
+  this->aotCode = std::move(code);
+}
+
+void runtime::VirtualMachine::setProfile(Profile profile) {
+  this->preloadedProfile = std::move(profile);
+}
+
+runtime::Profile runtime::VirtualMachine::collectProfile() const {
+  Profile profile{bytecode::hashCompiledFile(*this->file), {}};
+  profile.functions.reserve(this->codeBlocks.size());
+
+  // capped so the counts stay meaningful however many runs they were carried through
+  for (const auto& code : this->codeBlocks) {
+    profile.functions.push_back(FunctionProfile{
+      std::min(code.entryCount, optimizeEntryThreshold),
+      std::min(code.backEdgeCount, optimizeBackEdgeThreshold),
+      code.feedback,
+      code.callTargets
+    });
+  }
+
+  return profile;
+}
+
+void runtime::VirtualMachine::setProfileOutput(std::string path) {
+  this->profilePath = std::move(path);
+}
+
+void runtime::VirtualMachine::saveProfile() {
+  if (!this->profilePath || this->codeBlocks.empty()) {
+    return;
+  }
+
+  std::ofstream profileOut{this->profilePath.value()};
+
+  if (!profileOut.fail()) {
+    writeProfile(profileOut, this->collectProfile());
+  }
+}
+
+static std::optional<bytecode::ByteCodeInstruction> quickenedInstruction(
+  bytecode::ByteCodeInstruction generic,
+  OperandFeedback feedback
+) {
+  bool isInteger = feedback == OperandFeedback::Integer;
+
+  if (!isInteger && feedback != OperandFeedback::Float) {
+    return std::nullopt;
+  }
+
+  switch (generic) {
+    case bytecode::ByteCodeInstruction::Add:
+      return isInteger ? bytecode::ByteCodeInstruction::AddIntInt : bytecode::ByteCodeInstruction::AddFloatFloat;
+    case bytecode::ByteCodeInstruction::Subtract:
+      return isInteger ? bytecode::ByteCodeInstruction::SubtractIntInt : bytecode::ByteCodeInstruction::SubtractFloatFloat;
+    case bytecode::ByteCodeInstruction::Multiply:
+      return isInteger ? bytecode::ByteCodeInstruction::MultiplyIntInt : bytecode::ByteCodeInstruction::MultiplyFloatFloat;
+    case bytecode::ByteCodeInstruction::Divide:
+      return isInteger ? bytecode::ByteCodeInstruction::DivideIntInt : bytecode::ByteCodeInstruction::DivideFloatFloat;
+    case bytecode::ByteCodeInstruction::Less:
+      return isInteger ? bytecode::ByteCodeInstruction::LessIntInt : bytecode::ByteCodeInstruction::LessFloatFloat;
+    case bytecode::ByteCodeInstruction::LessOrEqual:
+      return isInteger ? bytecode::ByteCodeInstruction::LessOrEqualIntInt : bytecode::ByteCodeInstruction::LessOrEqualFloatFloat;
+    case bytecode::ByteCodeInstruction::Greater:
+      return isInteger ? bytecode::ByteCodeInstruction::GreaterIntInt : bytecode::ByteCodeInstruction::GreaterFloatFloat;
+    case bytecode::ByteCodeInstruction::GreaterOrEqual:
+      return isInteger ? bytecode::ByteCodeInstruction::GreaterOrEqualIntInt : bytecode::ByteCodeInstruction::GreaterOrEqualFloatFloat;
+    default:
+      return std::nullopt;
+  }
+}
+
+// quickens every instruction the earlier run settled on and carries over the
+// hotness counters and call targets, so the first call or back edge already
+// promotes a function that was hot before. a profile of another file is dropped whole,
+// a function whose shape does not match is skipped
+void runtime::VirtualMachine::applyProfile(const Profile& profile) {
+  if (profile.fileHash != bytecode::hashCompiledFile(*this->file) || profile.functions.size() != this->codeBlocks.size()) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < this->codeBlocks.size(); i++) {
+    CodeBlock& code = this->codeBlocks.at(i);
+    const FunctionProfile& function = profile.functions.at(i);
+
+    if (function.feedback.size() != code.byteCode.size() || function.callTargets.size() != code.byteCode.size()) {
+      continue;
+    }
+
+    code.entryCount = function.entryCount;
+    code.backEdgeCount = function.backEdgeCount;
+
+    for (std::size_t pc = 0; pc < code.byteCode.size(); pc++) {
+      CallTarget callTarget = function.callTargets.at(pc);
+
+      if (code.byteCode.at(pc).instruction == bytecode::ByteCodeInstruction::Invoke
+        && (callTarget == polymorphicCallTarget || callTarget < this->file->functions.size())) {
+        code.callTargets.at(pc) = callTarget;
+      }
+
+      if (function.feedback.at(pc) == OperandFeedback::None) {
+        continue;
+      }
+
+      code.feedback.at(pc) = function.feedback.at(pc);
+
+      auto quickened = quickenedInstruction(code.byteCode.at(pc).instruction, function.feedback.at(pc));
+
+      if (quickened) {
+        code.byteCode.at(pc).instruction = quickened.value();
+      }
+    }
+  }
+}
+
+void runtime::VirtualMachine::setSnapshotOutput(std::ostream* out) {
+  this->snapshotOut = out;
+}
+
+bool runtime::VirtualMachine::hasWrittenSnapshot() const {
+  return this->isSnapshotWritten;
+}
+
+void runtime::VirtualMachine::setSnapshot(std::string state) {
+  this->snapshotState = std::move(state);
+}
+
+void runtime::VirtualMachine::printJitStatistics(std::ostream & os) {
+  if (this->compileQueue == nullptr) {
+    return;
+  }
+
+  auto statistics = this->compileQueue->getStatistics();
+  auto milliseconds = [](std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+  };
+
+  double averageInstallTime = statistics.installed == 0
+    ? 0.0
+    : milliseconds(statistics.totalInstallTime) / static_cast<double>(statistics.installed);
+
+  os << "JIT compilations: " << statistics.submitted << " submitted, "
+    << statistics.installed << " installed, "
+    << this->compileQueue->queueLength() << " still queued\n"
+    << "JIT compile queue: peak length " << statistics.peakQueueLength << '\n'
+    << "JIT install time: " << averageInstallTime << " ms average, "
+    << milliseconds(statistics.maxInstallTime) << " ms max" << std::endl;
+}
+
+// once a function is promoted its native code takes over from the current
+// program counter where it has an entry, for a hot loop this is on stack
+// replacement. native code hands back control on calls, returns, at Halt,
+// snapshot() and when optimized code deoptimizes or becomes available
+bool runtime::VirtualMachine::enterNativeCode(CodeBlock* code) {
+  StackFrame* frame = this->stackFrame.get();
+  std::size_t pc = frame->programCounter;
+
+  // recompiled from the current bytecode once the function is entered again
+  if (code->isNativeStale) {
+    code->native = nullptr;
+    code->isNativeEntry.clear();
+    code->isNativeStale = false;
+  }
+
+  if (pc >= code->byteCode.size() || isInterpreterOnly(code->byteCode[pc].instruction)) {
+    return false;
+  }
+
+  if (code->optimized != nullptr && code->isOptimizedEntry[pc]) {
+    code->optimized->enter(pc, this, frame->locals.data(), this->globals.data(), &frame->programCounter);
+
+    if (code->isDeoptimized) {
+      code->optimized = nullptr;
+      code->isOptimizedUnavailable = true;
+    }
+    return true;
+  }
+
+  if (code->native != nullptr && code->isNativeEntry[pc]) {
+    code->native->enter(pc, this, frame->locals.data(), this->globals.data(), &frame->programCounter);
+    return true;
+  }
+
+  return false;
+}
+
 bool VirtualMachine::variableEquals(Variable var1, Variable var2) {
   if (var1.type != var2.type) {
     return false;
@@ -1133,7 +2114,7 @@ void runtime::VirtualMachine::pushObject(runtime::Object* obj) {
 }
 
 std::size_t runtime::VirtualMachine::getByteCodeParameter() {
-  return this->stackFrame->function->fn->byteCode.at(this->stackFrame->programCounter).parameter;
+  return this->stackFrame->function->code->byteCode[this->stackFrame->programCounter].parameter;
 }
 
 bool runtime::VirtualMachine::protectDifferentTypes(Variable v1, Variable v2) {
@@ -1146,63 +2127,14 @@ bool runtime::VirtualMachine::protectDifferentTypes(Variable v1, Variable v2) {
 }
 
 std::string runtime::VirtualMachine::byteCodeToString(bytecode::ByteCode bc, bool panic) {
+  auto name = bytecode::byteCodeToString(bc);
 
-  #define PARAM "(" + std::to_string(bc.parameter) + ")"
-
-  switch (bc.instruction) {
-    case bytecode::ByteCodeInstruction::Halt: return "Halt";
-    case bytecode::ByteCodeInstruction::Add: return "Add";
-    case bytecode::ByteCodeInstruction::Subtract: return "Subtract";
-    case bytecode::ByteCodeInstruction::Multiply: return "Multiply";
-    case bytecode::ByteCodeInstruction::Divide: return "Divide";
-    case bytecode::ByteCodeInstruction::Print: return "Print";
-    case bytecode::ByteCodeInstruction::Read: return "Read";
-    case bytecode::ByteCodeInstruction::Jump: return "Jump" PARAM;
-    case bytecode::ByteCodeInstruction::JumpIfFalse: return "JumpIfFalse" PARAM;
-    case bytecode::ByteCodeInstruction::LoadIntegerConstant: return "LoadIntegerConstant" PARAM;
-    case bytecode::ByteCodeInstruction::LoadFloatConstant: return "LoadFloatConstant" PARAM;
-    case bytecode::ByteCodeInstruction::LoadStringConstant: return "LoadStringConstant" PARAM;
-    case bytecode::ByteCodeInstruction::LoadUndefinedConstant: return "LoadUndefinedConstant";
-    case bytecode::ByteCodeInstruction::LoadBooleanTrueConstant: return "LoadBooleanTrueConstant";
-    case bytecode::ByteCodeInstruction::LoadBooleanFalseConstant: return "LoadBooleanFalseConstant";
-    case bytecode::ByteCodeInstruction::LoadLocal: return "LoadLocal" PARAM;
-    case bytecode::ByteCodeInstruction::SetLocal: return "SetLocal" PARAM;
-    case bytecode::ByteCodeInstruction::Return: return "Return";
-    case bytecode::ByteCodeInstruction::Invoke: return "Invoke" PARAM;
-    case bytecode::ByteCodeInstruction::NoOp: return "NoOp";
-    case bytecode::ByteCodeInstruction::MakeFn: return "MakeFn" PARAM;
-    case bytecode::ByteCodeInstruction::MakeObj: return "MakeObj" PARAM;
-    case bytecode::ByteCodeInstruction::Less: return "Less";
-    case bytecode::ByteCodeInstruction::LessOrEqual: return "LessOrEqual";
-    case bytecode::ByteCodeInstruction::Greater: return "Greater";
-    case bytecode::ByteCodeInstruction::GreaterOrEqual: return "GreaterOrEqual";
-    case bytecode::ByteCodeInstruction::Not: return "Not";
-    case bytecode::ByteCodeInstruction::Equal: return "Equal";
-    case bytecode::ByteCodeInstruction::NotEqual: return "NotEqual";
-    case bytecode::ByteCodeInstruction::And: return "And";
-    case bytecode::ByteCodeInstruction::Or: return "Or";
-    case bytecode::ByteCodeInstruction::GetType: return "GetType";
-    case bytecode::ByteCodeInstruction::CastToInt: return "CastToInt";
-    case bytecode::ByteCodeInstruction::CastToFloat: return "CastToFloat";
-    case bytecode::ByteCodeInstruction::Length: return "Length";
-    case bytecode::ByteCodeInstruction::ChatAt: return "ChatAt";
-    case bytecode::ByteCodeInstruction::StringAppend: return "StringAppend";
-    case bytecode::ByteCodeInstruction::ObjectGet: return "ObjectGet";
-    case bytecode::ByteCodeInstruction::ObjectSet: return "ObjectSet";
-    case bytecode::ByteCodeInstruction::GetEnv: return "GetEnv";
-    case bytecode::ByteCodeInstruction::LoadClosure: return "LoadClosure" PARAM;
-    case bytecode::ByteCodeInstruction::Pop: return "Pop";
-    default: {
-      if (panic) {
-        this->panic("Unkown bytecode instruction encountered");
-        return "";
-      } else {
-        return "<UNKNOWN>";
-      }
-    }
+  if (!name && panic) {
+    this->panic("Unkown bytecode instruction encountered");
+    return "";
   }
 
-  #undef PARAM
+  return name.value_or("<UNKNOWN>");
 }
 
 template<typename T>
@@ -1251,8 +2183,8 @@ void runtime::VirtualMachine::print() {
       this->out << "| |   |" << i << "| " << this->variableToString(stackFrame->opStack.at(i), false) << '\n';
     }
     this->out << "| | Byte Code:\n";
-    for (std::size_t i = 0; i < stackFrame->function->fn->byteCode.size(); i++) {
-      this->out << "| |   |" << i << "| " << this->byteCodeToString(stackFrame->function->fn->byteCode.at(i), false) << '\n';
+    for (std::size_t i = 0; i < stackFrame->function->code->byteCode.size(); i++) {
+      this->out << "| |   |" << i << "| " << this->byteCodeToString(stackFrame->function->code->byteCode.at(i), false) << '\n';
     }
     this->out << "| \\------------------\n";
 
@@ -1260,6 +2192,12 @@ void runtime::VirtualMachine::print() {
   }
   this->out << "\\------------------\n";
 
+  this->out << "Globals:\n";
+  for (std::size_t i = 0; i < this->globals.size(); i++) {
+    this->out << "| |" << i << "| " << this->variableToString(this->globals.at(i), false) << '\n';
+  }
+  this->out << "\\------------------\n";
+
   this->out << "Entrypoint:\n";
   this->printFunction(&this->file->entrypoint);
   this->out << "\\------------------\n";
@@ -1310,6 +2248,8 @@ void runtime::VirtualMachine::panic(const std::string & message) {
 
   this->print();
 
+  this->saveProfile();
+
   exit(1);
 }
 
@@ -0,0 +1,150 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+class ScalarReplacement {
+private:
+  Program& program;
+  ir::Function& fn;
+
+  std::optional<std::string> constantKey(ir::ValueId value) const {
+    const auto& instruction = this->fn.values.at(value);
+
+    if (instruction.kind != ir::InstructionKind::Operation || instruction.op != ByteCodeInstruction::LoadStringConstant) {
+      return std::nullopt;
+    }
+
+    return this->program.stringConstants.at(instruction.parameter);
+  }
+
+  // an object escapes unless every use reads a constant key, its length or
+  // its type. anything else, a store, a call, a phi or a return, could
+  // observe or change the object itself
+  std::optional<std::vector<ir::ValueId>> nonEscapingUses(ir::ValueId object) const {
+    std::vector<ir::ValueId> uses;
+
+    for (const auto& block : this->fn.blocks) {
+      if (block.terminator.value == object) {
+        return std::nullopt;
+      }
+    }
+
+    for (ir::ValueId id = 0; id < this->fn.values.size(); id++) {
+      const auto& instruction = this->fn.values.at(id);
+      const auto& operands = instruction.operands;
+
+      if (std::find(operands.begin(), operands.end(), object) == operands.end()) {
+        continue;
+      }
+
+      if (instruction.kind != ir::InstructionKind::Operation) {
+        return std::nullopt;
+      }
+
+      switch (instruction.op) {
+        case ByteCodeInstruction::ObjectGet:
+          if (operands.at(0) != object || operands.at(1) == object || !this->constantKey(operands.at(1))) {
+            return std::nullopt;
+          }
+          break;
+
+        case ByteCodeInstruction::Length:
+        case ByteCodeInstruction::GetType:
+          break;
+
+        default:
+          return std::nullopt;
+      }
+
+      uses.push_back(id);
+    }
+
+    return uses;
+  }
+
+  void replaceWithConstant(ir::ValueId id, ByteCodeInstruction op, std::size_t parameter) {
+    auto& instruction = this->fn.values.at(id);
+    instruction.op = op;
+    instruction.parameter = parameter;
+    instruction.operands.clear();
+  }
+
+  // the fields become the values the object was built from, MakeObj keeps
+  // the last of several equal keys
+  void replace(ir::ValueId object, const std::vector<ir::ValueId>& uses) {
+    const auto& keys = this->program.objects.at(this->fn.values.at(object).parameter).keys;
+    auto fields = this->fn.values.at(object).operands;
+
+    for (auto use : uses) {
+      switch (this->fn.values.at(use).op) {
+        case ByteCodeInstruction::ObjectGet: {
+          auto key = this->constantKey(this->fn.values.at(use).operands.at(1)).value();
+          auto find = std::find(keys.rbegin(), keys.rend(), key);
+
+          if (find == keys.rend()) {
+            this->replaceWithConstant(use, ByteCodeInstruction::LoadUndefinedConstant, 0);
+          } else {
+            std::size_t field = static_cast<std::size_t>(keys.rend() - find) - 1;
+            this->fn.replaceAllUses(use, fields.at(field));
+            this->fn.remove(use);
+          }
+          break;
+        }
+
+        case ByteCodeInstruction::Length: {
+          std::vector<std::string> distinct{keys};
+          std::sort(distinct.begin(), distinct.end());
+          auto count = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+          this->replaceWithConstant(use, ByteCodeInstruction::LoadIntegerConstant, this->program.intConstant(count));
+          break;
+        }
+
+        default:
+          this->replaceWithConstant(use, ByteCodeInstruction::LoadStringConstant, this->program.stringConstant("object"));
+          break;
+      }
+    }
+
+    this->fn.remove(object);
+  }
+
+public:
+  ScalarReplacement(Program& program, ir::Function& fn)
+  : program{program}
+  , fn{fn}
+  {}
+
+  bool run() {
+    bool changed = false;
+
+    for (ir::ValueId id = 0; id < this->fn.values.size(); id++) {
+      const auto& instruction = this->fn.values.at(id);
+
+      if (instruction.kind != ir::InstructionKind::Operation
+        || instruction.op != ByteCodeInstruction::MakeObj
+        || instruction.parameter >= this->program.objects.size()) {
+        continue;
+      }
+
+      auto uses = this->nonEscapingUses(id);
+
+      if (uses) {
+        this->replace(id, uses.value());
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+};
+
+bool replaceObjects(Program& program) {
+  return ir::transform(program, [&program](ir::Function& fn) {
+    return ScalarReplacement{program, fn}.run();
+  });
+}
+
+};
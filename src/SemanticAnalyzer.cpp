@@ -139,7 +139,8 @@ public:
     {"float", 1},
     {"length", 1},
     {"charAt", 2},
-    {"append", 2}
+    {"append", 2},
+    {"snapshot", 0}
   }}
   , error{false}
   , functionDept{0}
@@ -243,6 +244,7 @@ public:
         } catch (...) {
           this->reportError(node->token, "Invalid value for integer literal.");
         }
+        return;
       }
       case TokenType::FloatLiteral: {
         try {
@@ -250,6 +252,7 @@ public:
         } catch (...) {
           this->reportError(node->token, "Invalid value for float literal.");
         }
+        return;
       }
       default:
         return;
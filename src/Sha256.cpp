@@ -0,0 +1,98 @@
+#include "Sha256.hpp"
+
+namespace interpreter {
+
+static const std::array<std::uint32_t, 64> roundConstants{{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+}};
+
+static std::uint32_t rotateRight(std::uint32_t value, unsigned int count) {
+  return (value >> count) | (value << (32 - count));
+}
+
+static void compress(std::array<std::uint32_t, 8>& state, const std::uint8_t* block) {
+  std::array<std::uint32_t, 64> w{};
+
+  for (std::size_t i = 0; i < 16; i++) {
+    w.at(i) = static_cast<std::uint32_t>(block[i * 4]) << 24
+      | static_cast<std::uint32_t>(block[i * 4 + 1]) << 16
+      | static_cast<std::uint32_t>(block[i * 4 + 2]) << 8
+      | static_cast<std::uint32_t>(block[i * 4 + 3]);
+  }
+
+  for (std::size_t i = 16; i < 64; i++) {
+    std::uint32_t s0 = rotateRight(w.at(i - 15), 7) ^ rotateRight(w.at(i - 15), 18) ^ (w.at(i - 15) >> 3);
+    std::uint32_t s1 = rotateRight(w.at(i - 2), 17) ^ rotateRight(w.at(i - 2), 19) ^ (w.at(i - 2) >> 10);
+    w.at(i) = w.at(i - 16) + s0 + w.at(i - 7) + s1;
+  }
+
+  auto [a, b, c, d, e, f, g, h] = state;
+
+  for (std::size_t i = 0; i < 64; i++) {
+    std::uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+    std::uint32_t choose = (e & f) ^ (~e & g);
+    std::uint32_t t1 = h + s1 + choose + roundConstants.at(i) + w.at(i);
+    std::uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+    std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+    std::uint32_t t2 = s0 + majority;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  std::array<std::uint32_t, 8> result{{a, b, c, d, e, f, g, h}};
+
+  for (std::size_t i = 0; i < 8; i++) {
+    state.at(i) += result.at(i);
+  }
+}
+
+Sha256Digest sha256(const std::string & data) {
+  std::array<std::uint32_t, 8> state{{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  }};
+
+  // the message, a one bit, zeros up to 56 mod 64 and the length in bits
+  std::string padded = data;
+  padded.push_back(static_cast<char>(0x80));
+
+  while (padded.size() % 64 != 56) {
+    padded.push_back('\0');
+  }
+
+  std::uint64_t bits = static_cast<std::uint64_t>(data.size()) * 8;
+
+  for (int i = 7; i >= 0; i--) {
+    padded.push_back(static_cast<char>(bits >> (8 * i)));
+  }
+
+  for (std::size_t offset = 0; offset < padded.size(); offset += 64) {
+    compress(state, reinterpret_cast<const std::uint8_t*>(padded.data() + offset));
+  }
+
+  Sha256Digest digest{};
+
+  for (std::size_t i = 0; i < 8; i++) {
+    digest.at(i * 4) = static_cast<std::uint8_t>(state.at(i) >> 24);
+    digest.at(i * 4 + 1) = static_cast<std::uint8_t>(state.at(i) >> 16);
+    digest.at(i * 4 + 2) = static_cast<std::uint8_t>(state.at(i) >> 8);
+    digest.at(i * 4 + 3) = static_cast<std::uint8_t>(state.at(i));
+  }
+
+  return digest;
+}
+
+}
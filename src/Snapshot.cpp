@@ -0,0 +1,467 @@
+#include "Runtime.hpp"
+#include "ByteCodeFile.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+
+namespace runtime {
+
+static const char snapshotMagic[8] = {'F', 'L', 'A', 'N', 'G', 'S', 'N', '\0'};
+static constexpr std::uint64_t snapshotVersion = 1;
+
+// strings either live in the heap or are constants of the compiled file,
+// references carry that in their lowest bit
+static constexpr std::uint64_t constantStringBit = 1;
+
+static constexpr std::uint64_t noReference = ~static_cast<std::uint64_t>(0);
+
+// Numbers every heap value and stack frame reachable from the running
+// script, a reference to one of them is its index in the table of its kind
+class SnapshotTables {
+public:
+  const bytecode::CompiledFile& file;
+  std::vector<const std::string*> strings;
+  std::vector<const Object*> objects;
+  std::vector<const Function*> functions;
+  std::vector<const StackFrame*> frames;
+  std::unordered_map<const void*, std::uint64_t> ids;
+
+  explicit SnapshotTables(const bytecode::CompiledFile& file) noexcept
+  : file{file}
+  , strings{}
+  , objects{}
+  , functions{}
+  , frames{}
+  , ids{}
+  {}
+
+  std::uint64_t reference(const void* value) const {
+    return value == nullptr ? noReference : this->ids.at(value);
+  }
+
+  std::optional<std::size_t> constantString(const std::string* value) const {
+    const auto& constants = this->file.stringConstants;
+
+    if (constants.empty() || value < constants.data() || value >= constants.data() + constants.size()) {
+      return std::nullopt;
+    }
+
+    return static_cast<std::size_t>(value - constants.data());
+  }
+
+  template<typename T>
+  bool add(std::vector<const T*>& table, const T* value) {
+    if (value == nullptr || this->ids.count(value) != 0) {
+      return false;
+    }
+
+    this->ids[value] = table.size();
+    table.push_back(value);
+    return true;
+  }
+
+  void visit(const Variable& variable) {
+    switch (variable.type) {
+      case VariableType::String:
+        if (!this->constantString(variable.stringValue)) {
+          this->add(this->strings, variable.stringValue);
+        }
+        break;
+      case VariableType::Object:
+        this->visit(variable.objectValue);
+        break;
+      case VariableType::Function:
+        this->visit(variable.functionValue);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void visit(const Object* object) {
+    if (!this->add(this->objects, object)) {
+      return;
+    }
+
+    for (const auto& property : object->properties) {
+      this->visit(property.second);
+    }
+  }
+
+  void visit(const Function* function) {
+    if (!this->add(this->functions, function)) {
+      return;
+    }
+
+    for (const auto& capture : function->captures) {
+      this->visit(capture.stackFrame);
+    }
+
+    this->visit(function->scopeOuter.get());
+  }
+
+  void visit(const StackFrame* frame) {
+    if (!this->add(this->frames, frame)) {
+      return;
+    }
+
+    this->visit(frame->function);
+    this->visit(frame->outer.get());
+
+    for (const auto& local : frame->locals) {
+      this->visit(local);
+    }
+
+    for (const auto& operand : frame->opStack) {
+      this->visit(operand);
+    }
+  }
+
+  void write(bytecode::ByteCodeWriter& writer, const Variable& variable) const {
+    writer.word(static_cast<std::uint64_t>(variable.type));
+
+    switch (variable.type) {
+      case VariableType::Integer:
+        writer.word(static_cast<std::uint64_t>(variable.integerValue));
+        break;
+      case VariableType::Float: {
+        std::uint64_t bits;
+        std::memcpy(&bits, &variable.doubleValue, sizeof(bits));
+        writer.word(bits);
+        break;
+      }
+      case VariableType::Boolean:
+        writer.word(variable.boolValue ? 1 : 0);
+        break;
+      case VariableType::String: {
+        auto constant = this->constantString(variable.stringValue);
+        writer.word(constant
+          ? constant.value() << 1 | constantStringBit
+          : this->reference(variable.stringValue) << 1);
+        break;
+      }
+      case VariableType::Object:
+        writer.word(this->reference(variable.objectValue));
+        break;
+      case VariableType::Function:
+        writer.word(this->reference(variable.functionValue));
+        break;
+      default:
+        writer.word(0);
+        break;
+    }
+  }
+};
+
+// Layout after the header and the embedded compiled file, all words:
+//   string, object, function and frame counts
+//   every string, every object as its properties
+//   every function as its code block index, captures and outer scope
+//   every frame as its program counter, function, caller, locals and op stack
+//   globals, known functions and the current frame
+void VirtualMachine::writeSnapshot(std::ostream & out) {
+  SnapshotTables tables{*this->file};
+
+  tables.visit(this->stackFrame.get());
+
+  for (const auto& global : this->globals) {
+    tables.visit(global);
+  }
+
+  for (const auto* function : this->knownFunctions) {
+    tables.visit(function);
+  }
+
+  std::ostringstream compiledFile;
+  bytecode::writeCompiledFile(*this->file, compiledFile);
+
+  bytecode::ByteCodeWriter writer{out};
+
+  out.write(snapshotMagic, sizeof(snapshotMagic));
+  writer.word(snapshotVersion);
+  writer.string(compiledFile.str());
+
+  writer.word(tables.strings.size());
+  writer.word(tables.objects.size());
+  writer.word(tables.functions.size());
+  writer.word(tables.frames.size());
+
+  for (const auto* string : tables.strings) {
+    writer.string(*string);
+  }
+
+  for (const auto* object : tables.objects) {
+    writer.word(object->properties.size());
+
+    for (const auto& property : object->properties) {
+      writer.string(property.first);
+      tables.write(writer, property.second);
+    }
+  }
+
+  for (const auto* function : tables.functions) {
+    writer.word(static_cast<std::uint64_t>(function->code - this->codeBlocks.data()));
+    writer.word(function->captures.size());
+
+    for (const auto& capture : function->captures) {
+      writer.word(tables.reference(capture.stackFrame));
+      writer.word(capture.scopeIndex);
+    }
+
+    writer.word(tables.reference(function->scopeOuter.get()));
+  }
+
+  for (const auto* frame : tables.frames) {
+    writer.word(frame->programCounter);
+    writer.word(tables.reference(frame->function));
+    writer.word(tables.reference(frame->outer.get()));
+
+    writer.word(frame->locals.size());
+    for (const auto& local : frame->locals) {
+      tables.write(writer, local);
+    }
+
+    writer.word(frame->opStack.size());
+    for (const auto& operand : frame->opStack) {
+      tables.write(writer, operand);
+    }
+  }
+
+  writer.word(this->globals.size());
+  for (const auto& global : this->globals) {
+    tables.write(writer, global);
+  }
+
+  writer.word(this->knownFunctions.size());
+  for (const auto* function : this->knownFunctions) {
+    writer.word(tables.reference(function));
+  }
+
+  writer.word(tables.reference(this->stackFrame.get()));
+}
+
+std::optional<SnapshotFile> readSnapshot(const std::string & data) {
+  auto bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+
+  if (data.size() < sizeof(snapshotMagic) || std::memcmp(bytes, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+    return std::nullopt;
+  }
+
+  bytecode::ByteCodeReader reader{bytes + sizeof(snapshotMagic), data.size() - sizeof(snapshotMagic)};
+  std::uint64_t version;
+  std::string compiledFile;
+
+  if (!reader.word(version) || version != snapshotVersion || !reader.string(compiledFile)) {
+    return std::nullopt;
+  }
+
+  auto file = bytecode::decodeCompiledFile(reinterpret_cast<const std::uint8_t*>(compiledFile.data()), compiledFile.size());
+
+  if (file == nullptr) {
+    return std::nullopt;
+  }
+
+  return SnapshotFile{std::move(file), reader.rest()};
+}
+
+// Recreates the tables in this VM's heap first and links them afterwards, any
+// reference out of range means the snapshot is corrupt
+void VirtualMachine::restoreSnapshot(const std::string & state) {
+  bytecode::ByteCodeReader reader{reinterpret_cast<const std::uint8_t*>(state.data()), state.size()};
+
+  std::uint64_t stringCount, objectCount, functionCount, frameCount;
+
+  if (!reader.length(stringCount, 8)
+    || !reader.length(objectCount, 8)
+    || !reader.length(functionCount, 24)
+    || !reader.length(frameCount, 40)) {
+    this->panic("Corrupt snapshot!");
+  }
+
+  std::vector<std::string*> strings;
+  std::vector<Object*> objects;
+  std::vector<Function*> functions;
+  std::vector<std::shared_ptr<StackFrame>> frames;
+
+  for (std::uint64_t i = 0; i < stringCount; i++) {
+    strings.push_back(this->heap.NewString());
+
+    if (!reader.string(*strings.back())) {
+      this->panic("Corrupt snapshot!");
+    }
+  }
+
+  for (std::uint64_t i = 0; i < objectCount; i++) {
+    objects.push_back(this->heap.NewObject());
+  }
+
+  for (std::uint64_t i = 0; i < functionCount; i++) {
+    functions.push_back(this->heap.NewFunction());
+  }
+
+  for (std::uint64_t i = 0; i < frameCount; i++) {
+    frames.push_back(std::make_shared<StackFrame>());
+  }
+
+  auto word = [this, &reader]() {
+    std::uint64_t value;
+
+    if (!reader.word(value)) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    return value;
+  };
+
+  auto reference = [this, &word](auto& table, bool isOptional) {
+    std::uint64_t index = word();
+
+    if (isOptional && index == noReference) {
+      return static_cast<typename std::decay_t<decltype(table)>::value_type>(nullptr);
+    }
+
+    if (index >= table.size()) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    return table.at(index);
+  };
+
+  auto variable = [this, &word, &reference, &strings, &objects, &functions]() {
+    Variable value{};
+    std::uint64_t type = word();
+
+    switch (static_cast<VariableType>(type)) {
+      case VariableType::Undefined:
+        word();
+        break;
+      case VariableType::Integer:
+        value.integerValue = static_cast<std::int64_t>(word());
+        break;
+      case VariableType::Float: {
+        std::uint64_t bits = word();
+        std::memcpy(&value.doubleValue, &bits, sizeof(bits));
+        break;
+      }
+      case VariableType::Boolean:
+        value.boolValue = word() != 0;
+        break;
+      case VariableType::String: {
+        std::uint64_t string = word();
+        std::uint64_t index = string >> 1;
+        const auto& constants = this->file->stringConstants;
+
+        if ((string & constantStringBit) != 0 ? index >= constants.size() : index >= strings.size()) {
+          this->panic("Corrupt snapshot!");
+        }
+
+        value.stringValue = (string & constantStringBit) != 0 ? &constants.at(index) : strings.at(index);
+        break;
+      }
+      case VariableType::Object:
+        value.objectValue = reference(objects, false);
+        break;
+      case VariableType::Function:
+        value.functionValue = reference(functions, false);
+        break;
+      default:
+        this->panic("Corrupt snapshot!");
+    }
+
+    value.type = static_cast<VariableType>(type);
+    return value;
+  };
+
+  for (auto* object : objects) {
+    std::uint64_t propertyCount;
+
+    if (!reader.length(propertyCount, 24)) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    for (std::uint64_t i = 0; i < propertyCount; i++) {
+      std::string key;
+
+      if (!reader.string(key)) {
+        this->panic("Corrupt snapshot!");
+      }
+
+      object->properties[key] = variable();
+    }
+  }
+
+  for (auto* function : functions) {
+    std::uint64_t index = word();
+    std::uint64_t captureCount;
+
+    if (index >= this->codeBlocks.size() || !reader.length(captureCount, 16)) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    function->code = &this->codeBlocks.at(index);
+    function->fn = function->code->fn;
+    function->captures.clear();
+
+    for (std::uint64_t i = 0; i < captureCount; i++) {
+      ClosureContext capture{};
+      capture.stackFrame = reference(frames, false).get();
+      capture.scopeIndex = word();
+      function->captures.push_back(capture);
+    }
+
+    function->scopeOuter = reference(frames, true);
+  }
+
+  for (auto& frame : frames) {
+    frame->programCounter = word();
+    frame->function = reference(functions, false);
+    frame->outer = reference(frames, true);
+
+    std::uint64_t count;
+
+    if (!reader.length(count, 16)) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    for (std::uint64_t i = 0; i < count; i++) {
+      frame->locals.push_back(variable());
+    }
+
+    if (!reader.length(count, 16)) {
+      this->panic("Corrupt snapshot!");
+    }
+
+    for (std::uint64_t i = 0; i < count; i++) {
+      frame->opStack.push_back(variable());
+    }
+  }
+
+  std::uint64_t count;
+
+  if (!reader.length(count, 16) || count != this->file->globalsCount) {
+    this->panic("Corrupt snapshot!");
+  }
+
+  this->globals.clear();
+  for (std::uint64_t i = 0; i < count; i++) {
+    this->globals.push_back(variable());
+  }
+
+  if (!reader.length(count, 8) || count > this->file->functions.size()) {
+    this->panic("Corrupt snapshot!");
+  }
+
+  this->knownFunctions.clear();
+  for (std::uint64_t i = 0; i < count; i++) {
+    this->knownFunctions.push_back(reference(functions, true));
+  }
+
+  this->stackFrame = reference(frames, false);
+
+  if (!reader.isAtEnd()) {
+    this->panic("Corrupt snapshot!");
+  }
+}
+
+}
@@ -0,0 +1,605 @@
+#include "Runtime.hpp"
+
+#include <cstddef>
+
+namespace runtime {
+
+static_assert(sizeof(Variable) == 16, "the optimizing tier copies variables as two quad words");
+
+// where a value of the op stack lives while optimized code runs. values are
+// kept out of the real op stack until an instruction that needs them there,
+// Integer and Boolean are unboxed in their spill slot, Boxed is a copied
+// Variable of unknown type and Constant is never stored at all
+enum class SpeculatedKind {
+  Materialized,
+  Constant,
+  Integer,
+  Boolean,
+  Boxed,
+};
+
+struct SpeculatedValue {
+  SpeculatedKind kind;
+  std::int64_t constant;
+};
+
+// the op stack as seen by the optimized code, the first materialized values
+// are on the real op stack of the frame
+struct SpeculatedStack {
+  std::vector<SpeculatedValue> values;
+  std::size_t materialized;
+};
+
+// resumes the interpreter at pc once stack has been rebuilt
+struct DeoptimizationPoint {
+  std::size_t label;
+  std::size_t pc;
+  SpeculatedStack stack;
+};
+
+struct SpeculativeHelpers {
+  std::uintptr_t (*generic)(bytecode::ByteCodeInstruction);
+  bool (*changesStackFrame)(bytecode::ByteCodeInstruction);
+  std::uintptr_t jumpIfFalse;
+  std::uintptr_t pushOperand;
+  std::uintptr_t popOperand;
+  std::uintptr_t deoptimize;
+  std::uintptr_t invokeTarget;
+};
+
+// Compiles quickened bytecode into code that trusts the integer feedback the
+// instructions were quickened with. Operands stay in registers and spill slots
+// instead of the op stack, guards on the operand types jump to deoptimization
+// points which rebuild the op stack and resume in the interpreter. An Invoke
+// that has only ever seen one callee is guarded on it and calls it directly.
+// Anything that is not integer arithmetic, a comparison, a local, a branch or
+// such a call runs the same handler the baseline code would. Calls are never
+// inlined, and object reads have no shape to guard on since objects are
+// plain property maps.
+//
+// registers: rbx the VM, r12 the locals of the frame, r13 the globals and
+// r14 the program counter of the frame
+class SpeculativeCompiler {
+private:
+  const bytecode::CompiledFile& file;
+  const bytecode::Function& fn;
+  const std::vector<bytecode::ByteCode>& byteCode;
+  const std::vector<CallTarget>& callTargets;
+  const SpeculativeHelpers& helpers;
+  std::size_t size;
+  jit::Assembler assembler;
+  std::vector<std::optional<std::size_t>> depths;
+  std::vector<bool> isJumpTarget;
+  std::size_t maxDepth;
+  SpeculatedStack stack;
+  std::vector<DeoptimizationPoint> deoptimizations;
+
+public:
+  std::vector<bool> entries;
+
+  explicit SpeculativeCompiler(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode,
+    const std::vector<CallTarget>& callTargets,
+    const SpeculativeHelpers& helpers
+  ) noexcept
+  : file{file}
+  , fn{fn}
+  , byteCode{byteCode}
+  , callTargets{callTargets}
+  , helpers{helpers}
+  , size{byteCode.size()}
+  , assembler{byteCode.size()}
+  , depths(byteCode.size())
+  , isJumpTarget(byteCode.size(), false)
+  , maxDepth{0}
+  , stack{{}, 0}
+  , entries(byteCode.size(), false)
+  {}
+
+  std::unique_ptr<jit::NativeCode> compile() {
+    if (!this->analyzeDepths()) {
+      return nullptr;
+    }
+
+    this->assembler.prologue(static_cast<std::int32_t>(16 * (this->maxDepth + 1)));
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (!this->depths.at(pc)) {
+        // never reached, binding the label keeps the entry table complete
+        this->assembler.bind(pc);
+        this->assembler.exit();
+        continue;
+      }
+
+      std::size_t depth = this->depths.at(pc).value();
+
+      if (this->isJumpTarget.at(pc)) {
+        this->flush();
+      }
+
+      if (this->stack.values.size() != depth) {
+        return nullptr;
+      }
+
+      this->assembler.bind(pc);
+      this->entries.at(pc) = this->stack.materialized == depth;
+
+      if (!this->compileInstruction(pc)) {
+        return nullptr;
+      }
+    }
+
+    for (const auto& deoptimization : this->deoptimizations) {
+      this->assembler.bind(deoptimization.label);
+      this->stack = deoptimization.stack;
+      this->flush();
+      this->storeProgramCounter(deoptimization.pc);
+      this->assembler.call(this->helpers.deoptimize);
+      this->assembler.exit();
+    }
+
+    return this->assembler.finalize();
+  }
+
+private:
+  static std::int32_t slot(std::size_t index) {
+    return static_cast<std::int32_t>(-32 - 16 * static_cast<std::int64_t>(index + 1));
+  }
+
+  static std::int32_t typeOf(std::size_t index) {
+    return slot(index) + static_cast<std::int32_t>(offsetof(Variable, type));
+  }
+
+  static std::int32_t valueOf(std::size_t index) {
+    return slot(index) + static_cast<std::int32_t>(offsetof(Variable, integerValue));
+  }
+
+  static std::int32_t typeCode(VariableType type) {
+    return static_cast<std::int32_t>(type);
+  }
+
+  // depths and jump targets of every instruction, false when the op stack
+  // depth is not known everywhere
+  bool analyzeDepths() {
+    auto depths = bytecode::stackDepths(this->byteCode, this->file.functions, this->file.objects);
+
+    if (!depths) {
+      return false;
+    }
+
+    this->depths = std::move(depths.value());
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      if (!this->depths.at(pc)) {
+        continue;
+      }
+
+      const auto& bc = this->byteCode.at(pc);
+      auto effect = bytecode::stackEffect(bc, this->file.functions, this->file.objects);
+      std::size_t depth = this->depths.at(pc).value();
+
+      this->maxDepth = std::max(this->maxDepth, std::max(depth, depth - effect.pops + effect.pushes));
+
+      if (bc.instruction == bytecode::ByteCodeInstruction::Jump
+        || bc.instruction == bytecode::ByteCodeInstruction::JumpIfFalse) {
+        this->isJumpTarget.at(bc.parameter) = true;
+      }
+    }
+
+    return true;
+  }
+
+  void storeProgramCounter(std::size_t pc) {
+    this->assembler.moveImmediate(jit::Register::rax, pc);
+    this->assembler.store(jit::Register::r14, 0, jit::Register::rax);
+  }
+
+  // moves every value that is not yet on the real op stack onto it
+  void flush() {
+    for (std::size_t i = this->stack.materialized; i < this->stack.values.size(); i++) {
+      auto& value = this->stack.values.at(i);
+
+      switch (value.kind) {
+        case SpeculatedKind::Constant:
+          this->assembler.storeImmediate32(jit::Register::rbp, typeOf(i), typeCode(VariableType::Integer));
+          this->assembler.moveImmediate(jit::Register::rax, static_cast<std::uint64_t>(value.constant));
+          this->assembler.store(jit::Register::rbp, valueOf(i), jit::Register::rax);
+          break;
+        case SpeculatedKind::Integer:
+          this->assembler.storeImmediate32(jit::Register::rbp, typeOf(i), typeCode(VariableType::Integer));
+          break;
+        case SpeculatedKind::Boolean:
+          this->assembler.storeImmediate32(jit::Register::rbp, typeOf(i), typeCode(VariableType::Boolean));
+          break;
+        default:
+          break;
+      }
+
+      this->assembler.loadAddress(jit::Register::rsi, jit::Register::rbp, slot(i));
+      this->assembler.call(this->helpers.pushOperand);
+      value.kind = SpeculatedKind::Materialized;
+    }
+
+    this->stack.materialized = this->stack.values.size();
+  }
+
+  // after an unconditional transfer the next instruction is only reached by
+  // a jump, where everything is on the real op stack
+  void resetStack(std::size_t pc) {
+    std::size_t depth = pc < this->size && this->depths.at(pc) ? this->depths.at(pc).value() : 0;
+
+    this->stack.values.assign(depth, SpeculatedValue{SpeculatedKind::Materialized, 0});
+    this->stack.materialized = depth;
+  }
+
+  void push(SpeculatedKind kind, std::int64_t constant) {
+    this->stack.values.push_back(SpeculatedValue{kind, constant});
+  }
+
+  void pop() {
+    this->stack.values.pop_back();
+    this->stack.materialized = std::min(this->stack.materialized, this->stack.values.size());
+  }
+
+  // pops the top count values off the real op stack into their spill slots
+  void unmaterialize(std::size_t count) {
+    std::size_t top = this->stack.values.size();
+
+    for (std::size_t i = top; i-- > top - count;) {
+      if (this->stack.values.at(i).kind == SpeculatedKind::Materialized) {
+        this->assembler.loadAddress(jit::Register::rsi, jit::Register::rbp, slot(i));
+        this->assembler.call(this->helpers.popOperand);
+        this->stack.values.at(i).kind = SpeculatedKind::Boxed;
+        this->stack.materialized = i;
+      }
+    }
+  }
+
+  std::size_t deoptimizeAt(std::size_t pc) {
+    std::size_t label = this->assembler.createLabel();
+    this->deoptimizations.push_back(DeoptimizationPoint{label, pc, this->stack});
+    return label;
+  }
+
+  // leaves both integer operands of a quickened instruction in rax and rcx
+  void loadIntegerOperands(std::size_t pc) {
+    this->unmaterialize(2);
+
+    std::size_t top = this->stack.values.size();
+    std::optional<std::size_t> deoptimization;
+
+    for (std::size_t i = top - 2; i < top; i++) {
+      if (this->stack.values.at(i).kind == SpeculatedKind::Boxed) {
+        if (!deoptimization) {
+          deoptimization = this->deoptimizeAt(pc);
+        }
+        this->assembler.compareImmediate32(jit::Register::rbp, typeOf(i), typeCode(VariableType::Integer));
+        this->assembler.jumpIf(jit::Condition::NotEqual, deoptimization.value());
+      }
+    }
+
+    // flushing calls into the VM, so it has to happen before the operands
+    // are loaded into registers
+    std::size_t below = top - 2;
+    if (this->stack.materialized < below) {
+      SpeculatedStack operands = this->stack;
+      this->stack.values.resize(below);
+      this->flush();
+      this->stack.values.push_back(operands.values.at(below));
+      this->stack.values.push_back(operands.values.at(below + 1));
+    }
+
+    this->loadInteger(jit::Register::rax, below);
+    this->loadInteger(jit::Register::rcx, below + 1);
+  }
+
+  void loadInteger(jit::Register dst, std::size_t index) {
+    const auto& value = this->stack.values.at(index);
+
+    if (value.kind == SpeculatedKind::Constant) {
+      this->assembler.moveImmediate(dst, static_cast<std::uint64_t>(value.constant));
+    } else {
+      this->assembler.load(dst, jit::Register::rbp, valueOf(index));
+    }
+  }
+
+  bool compileArithmetic(std::size_t pc, bytecode::ByteCodeInstruction instruction) {
+    if (this->stack.values.size() < 2) {
+      return false;
+    }
+
+    this->loadIntegerOperands(pc);
+
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::AddIntInt:
+        this->assembler.add(jit::Register::rax, jit::Register::rcx);
+        break;
+      case bytecode::ByteCodeInstruction::SubtractIntInt:
+        this->assembler.subtract(jit::Register::rax, jit::Register::rcx);
+        break;
+      case bytecode::ByteCodeInstruction::MultiplyIntInt:
+        this->assembler.multiply(jit::Register::rax, jit::Register::rcx);
+        break;
+      default: {
+        // division by zero produces undefined and the most negative number
+        // divided by -1 traps, both are left to the interpreter
+        std::size_t deoptimization = this->deoptimizeAt(pc);
+        this->assembler.test(jit::Register::rcx, jit::Register::rcx);
+        this->assembler.jumpIf(jit::Condition::Equal, deoptimization);
+        this->assembler.compareImmediate(jit::Register::rcx, -1);
+        this->assembler.jumpIf(jit::Condition::Equal, deoptimization);
+        this->assembler.divide(jit::Register::rcx);
+        break;
+      }
+    }
+
+    this->pop();
+    this->assembler.store(jit::Register::rbp, valueOf(this->stack.values.size() - 1), jit::Register::rax);
+    this->stack.values.back() = SpeculatedValue{SpeculatedKind::Integer, 0};
+    return true;
+  }
+
+  static jit::Condition conditionOf(bytecode::ByteCodeInstruction instruction) {
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::LessIntInt: return jit::Condition::Less;
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt: return jit::Condition::LessOrEqual;
+      case bytecode::ByteCodeInstruction::GreaterIntInt: return jit::Condition::Greater;
+      default: return jit::Condition::GreaterOrEqual;
+    }
+  }
+
+  // returns the number of instructions compiled, a comparison directly
+  // followed by a branch becomes a single conditional jump
+  std::size_t compileComparison(std::size_t pc, bytecode::ByteCodeInstruction instruction) {
+    if (this->stack.values.size() < 2) {
+      return 0;
+    }
+
+    this->loadIntegerOperands(pc);
+    this->assembler.compare(jit::Register::rax, jit::Register::rcx);
+
+    jit::Condition condition = conditionOf(instruction);
+    std::size_t next = pc + 1;
+
+    if (next < this->size
+      && !this->isJumpTarget.at(next)
+      && this->byteCode.at(next).instruction == bytecode::ByteCodeInstruction::JumpIfFalse
+      && this->byteCode.at(next).parameter < this->size) {
+      this->pop();
+      this->pop();
+      this->assembler.jumpIf(jit::negate(condition), this->byteCode.at(next).parameter);
+      this->assembler.bind(next);
+      return 2;
+    }
+
+    this->assembler.setIf(condition, jit::Register::rax);
+    this->pop();
+    this->assembler.store(jit::Register::rbp, valueOf(this->stack.values.size() - 1), jit::Register::rax);
+    this->stack.values.back() = SpeculatedValue{SpeculatedKind::Boolean, 0};
+    return 1;
+  }
+
+  // copies the top of the stack into a local or global
+  void compileStore(jit::Register base, std::int32_t disp) {
+    this->unmaterialize(1);
+
+    std::size_t top = this->stack.values.size() - 1;
+    const auto& value = this->stack.values.at(top);
+
+    switch (value.kind) {
+      case SpeculatedKind::Constant:
+        this->assembler.storeImmediate32(base, disp, typeCode(VariableType::Integer));
+        this->assembler.moveImmediate(jit::Register::rax, static_cast<std::uint64_t>(value.constant));
+        break;
+      case SpeculatedKind::Integer:
+        this->assembler.storeImmediate32(base, disp, typeCode(VariableType::Integer));
+        this->assembler.load(jit::Register::rax, jit::Register::rbp, valueOf(top));
+        break;
+      case SpeculatedKind::Boolean:
+        this->assembler.storeImmediate32(base, disp, typeCode(VariableType::Boolean));
+        this->assembler.load(jit::Register::rax, jit::Register::rbp, valueOf(top));
+        break;
+      default:
+        this->assembler.load(jit::Register::rax, jit::Register::rbp, slot(top));
+        this->assembler.store(base, disp, jit::Register::rax);
+        this->assembler.load(jit::Register::rax, jit::Register::rbp, slot(top) + 8);
+        break;
+    }
+
+    this->assembler.store(base, disp + 8, jit::Register::rax);
+    this->pop();
+  }
+
+  void compileLoad(jit::Register base, std::int32_t disp) {
+    std::size_t index = this->stack.values.size();
+
+    this->assembler.load(jit::Register::rax, base, disp);
+    this->assembler.store(jit::Register::rbp, slot(index), jit::Register::rax);
+    this->assembler.load(jit::Register::rax, base, disp + 8);
+    this->assembler.store(jit::Register::rbp, slot(index) + 8, jit::Register::rax);
+
+    this->push(SpeculatedKind::Boxed, 0);
+  }
+
+  // everything else runs through its handler with the op stack in place
+  bool compileGeneric(std::size_t pc) {
+    const auto& bc = this->byteCode.at(pc);
+    std::uintptr_t helper = this->helpers.generic(bc.instruction);
+
+    this->flush();
+    this->storeProgramCounter(pc);
+
+    if (helper == 0) {
+      this->assembler.exit();
+      this->resetStack(pc + 1);
+      return true;
+    }
+
+    this->assembler.call(helper);
+
+    if (this->helpers.changesStackFrame(bc.instruction)) {
+      this->assembler.exit();
+      this->resetStack(pc + 1);
+      return true;
+    }
+
+    auto effect = bytecode::stackEffect(bc, this->file.functions, this->file.objects);
+    this->stack.values.resize(this->stack.values.size() - effect.pops + effect.pushes, SpeculatedValue{SpeculatedKind::Materialized, 0});
+    this->stack.materialized = this->stack.values.size();
+    return true;
+  }
+
+  // a monomorphic Invoke calls its callee once the guard in the helper holds,
+  // any other callee deoptimizes before the op stack is touched
+  bool compileInvoke(std::size_t pc) {
+    CallTarget target = pc < this->callTargets.size() ? this->callTargets.at(pc) : noCallTarget;
+
+    if (target >= this->file.functions.size()) {
+      return this->compileGeneric(pc);
+    }
+
+    this->flush();
+    this->storeProgramCounter(pc);
+
+    std::size_t deoptimization = this->deoptimizeAt(pc);
+    this->assembler.moveImmediate(jit::Register::rsi, target);
+    this->assembler.callAndBranch(this->helpers.invokeTarget, deoptimization);
+    this->assembler.exit();
+    this->resetStack(pc + 1);
+    return true;
+  }
+
+  bool compileInstruction(std::size_t& pc) {
+    const auto& bc = this->byteCode.at(pc);
+    std::size_t localsCount = this->fn.localsCount;
+
+    switch (bc.instruction) {
+      case bytecode::ByteCodeInstruction::LoadIntegerConstant: {
+        if (bc.parameter >= this->file.intConstants.size()) {
+          return this->compileGeneric(pc);
+        }
+        this->push(SpeculatedKind::Constant, this->file.intConstants.at(bc.parameter));
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::LoadLocal: {
+        if (bc.parameter >= localsCount) {
+          return this->compileGeneric(pc);
+        }
+        this->compileLoad(jit::Register::r12, static_cast<std::int32_t>(16 * bc.parameter));
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::LoadGlobal: {
+        if (bc.parameter >= this->file.globalsCount) {
+          return this->compileGeneric(pc);
+        }
+        this->compileLoad(jit::Register::r13, static_cast<std::int32_t>(16 * bc.parameter));
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::SetLocal: {
+        if (bc.parameter >= localsCount) {
+          return this->compileGeneric(pc);
+        }
+        this->compileStore(jit::Register::r12, static_cast<std::int32_t>(16 * bc.parameter));
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::SetGlobal: {
+        if (bc.parameter >= this->file.globalsCount) {
+          return this->compileGeneric(pc);
+        }
+        this->compileStore(jit::Register::r13, static_cast<std::int32_t>(16 * bc.parameter));
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::Pop: {
+        if (this->stack.materialized == this->stack.values.size()) {
+          return this->compileGeneric(pc);
+        }
+        this->pop();
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::AddIntInt:
+      case bytecode::ByteCodeInstruction::SubtractIntInt:
+      case bytecode::ByteCodeInstruction::MultiplyIntInt:
+      case bytecode::ByteCodeInstruction::DivideIntInt:
+        return this->compileArithmetic(pc, bc.instruction);
+
+      case bytecode::ByteCodeInstruction::LessIntInt:
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt:
+      case bytecode::ByteCodeInstruction::GreaterIntInt:
+      case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt: {
+        std::size_t compiled = this->compileComparison(pc, bc.instruction);
+        pc += compiled - 1;
+        return compiled != 0;
+      }
+      case bytecode::ByteCodeInstruction::Invoke:
+        return this->compileInvoke(pc);
+      case bytecode::ByteCodeInstruction::Jump: {
+        this->flush();
+        if (bc.parameter >= this->size) {
+          this->storeProgramCounter(bc.parameter);
+          this->assembler.exit();
+        } else {
+          this->assembler.jump(bc.parameter);
+        }
+        this->resetStack(pc + 1);
+        return true;
+      }
+      case bytecode::ByteCodeInstruction::JumpIfFalse: {
+        if (bc.parameter >= this->size) {
+          return false;
+        }
+
+        if (this->stack.values.back().kind != SpeculatedKind::Boolean) {
+          this->flush();
+          this->storeProgramCounter(pc);
+          this->assembler.callAndBranch(this->helpers.jumpIfFalse, bc.parameter);
+          this->pop();
+          return true;
+        }
+
+        std::size_t top = this->stack.values.size() - 1;
+        SpeculatedValue condition = this->stack.values.back();
+        this->stack.values.pop_back();
+        this->flush();
+        this->stack.values.push_back(condition);
+
+        this->assembler.compareImmediate8(jit::Register::rbp, valueOf(top), 0);
+        this->pop();
+        this->assembler.jumpIf(jit::Condition::Equal, bc.parameter);
+        return true;
+      }
+      default:
+        return this->compileGeneric(pc);
+    }
+  }
+};
+
+// runs on the compile thread
+jit::CompileResult VirtualMachine::compileOptimized(
+  const bytecode::CompiledFile& file,
+  const bytecode::Function& fn,
+  const std::vector<bytecode::ByteCode>& byteCode,
+  const std::vector<CallTarget>& callTargets
+) {
+  if (byteCode.empty()) {
+    return jit::CompileResult{nullptr, {}};
+  }
+
+  SpeculativeHelpers helpers{
+    &VirtualMachine::nativeHelper,
+    &VirtualMachine::changesStackFrame,
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeJumpIfFalse),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePushOperand),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePopOperand),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeDeoptimize),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeInvokeTarget),
+  };
+
+  SpeculativeCompiler compiler{file, fn, byteCode, callTargets, helpers};
+  auto optimized = compiler.compile();
+
+  return jit::CompileResult{std::move(optimized), std::move(compiler.entries)};
+}
+
+}
@@ -0,0 +1,517 @@
+#include "Runtime.hpp"
+
+#include <cstddef>
+
+namespace runtime {
+
+// where a value the baseline code has not pushed onto the op stack yet
+// lives. Slot is still the local or global it was loaded from, Constant is
+// never stored at all and Boxed is a Variable in the spill slot of its position
+enum class TemplateKind {
+  Slot,
+  Constant,
+  Boxed,
+};
+
+struct TemplateValue {
+  TemplateKind kind;
+  jit::Register base;
+  std::int32_t disp;
+  std::int64_t constant;
+};
+
+// out of line code for a failed type guard, it pushes the operands, runs the
+// quickened handler which falls back to the generic one and continues at resume
+struct TemplateSlowPath {
+  std::size_t label;
+  std::size_t resume;
+  std::size_t pc;
+  std::vector<TemplateValue> pending;
+  // a comparison fused with the JumpIfFalse following it
+  std::optional<std::size_t> branchTarget;
+};
+
+struct TemplateHelpers {
+  std::uintptr_t (*handler)(bytecode::ByteCodeInstruction);
+  bool (*changesStackFrame)(bytecode::ByteCodeInstruction);
+  std::uintptr_t jump;
+  std::uintptr_t jumpIfFalse;
+  std::uintptr_t pushOperand;
+  std::uintptr_t popOperand;
+};
+
+// at most this many values are kept off the op stack at once
+constexpr std::size_t maxPendingValues = 4;
+
+// Compiles bytecode into baseline code. Locals, globals, integer constants
+// and quickened integer add, subtract, multiply and comparisons are emitted
+// inline and keep their values out of the op stack, guarded on the operand
+// types. Everything else calls its handler with the op stack in place, so
+// all other semantics stay in one place, and jumps become native branches.
+// The program counter of the frame is only written before a handler needs it.
+//
+// registers: rbx the VM, r12 the locals of the frame, r13 the globals and
+// r14 the program counter of the frame
+class TemplateCompiler {
+private:
+  const bytecode::CompiledFile& file;
+  const bytecode::Function& fn;
+  const std::vector<bytecode::ByteCode>& byteCode;
+  const TemplateHelpers& helpers;
+  std::size_t size;
+  jit::Assembler assembler;
+  std::size_t exitLabel;
+  std::vector<bool> isJumpTarget;
+  std::vector<TemplateValue> pending;
+  bool isProgramCounterStale;
+  std::vector<TemplateSlowPath> slowPaths;
+
+public:
+  std::vector<bool> entries;
+
+  explicit TemplateCompiler(
+    const bytecode::CompiledFile& file,
+    const bytecode::Function& fn,
+    const std::vector<bytecode::ByteCode>& byteCode,
+    const TemplateHelpers& helpers
+  ) noexcept
+  : file{file}
+  , fn{fn}
+  , byteCode{byteCode}
+  , helpers{helpers}
+  , size{byteCode.size()}
+  // one extra label past the end so a jump there hands back control
+  , assembler{byteCode.size() + 1}
+  , exitLabel{0}
+  , isJumpTarget(byteCode.size() + 1, false)
+  , pending{}
+  , isProgramCounterStale{false}
+  , slowPaths{}
+  , entries(byteCode.size(), false)
+  {}
+
+  std::unique_ptr<jit::NativeCode> compile() {
+    for (const auto& bc : this->byteCode) {
+      if (bc.instruction == bytecode::ByteCodeInstruction::Jump
+        || bc.instruction == bytecode::ByteCodeInstruction::JumpIfFalse) {
+        this->isJumpTarget.at(std::min(bc.parameter, this->size)) = true;
+      }
+    }
+
+    this->exitLabel = this->assembler.createLabel();
+    this->assembler.prologue(static_cast<std::int32_t>(16 * (maxPendingValues + 1)));
+
+    for (std::size_t pc = 0; pc < this->size; pc++) {
+      // jumps arrive with everything on the op stack and the program counter
+      // of wherever they came from
+      if (this->isJumpTarget.at(pc)) {
+        this->flush();
+        this->isProgramCounterStale = true;
+      }
+
+      this->assembler.bind(pc);
+      this->entries.at(pc) = this->pending.empty();
+
+      this->compileInstruction(pc);
+    }
+
+    this->flush();
+    this->syncProgramCounter(this->size);
+
+    this->assembler.bind(this->size);
+    this->assembler.bind(this->exitLabel);
+    this->assembler.exit();
+
+    for (const auto& slowPath : this->slowPaths) {
+      this->compileSlowPath(slowPath);
+    }
+
+    return this->assembler.finalize();
+  }
+
+private:
+  static std::int32_t slot(std::size_t index) {
+    return static_cast<std::int32_t>(-32 - 16 * static_cast<std::int64_t>(index + 1));
+  }
+
+  static std::int32_t typeOffset() {
+    return static_cast<std::int32_t>(offsetof(Variable, type));
+  }
+
+  static std::int32_t valueOffset() {
+    return static_cast<std::int32_t>(offsetof(Variable, integerValue));
+  }
+
+  static std::int32_t typeCode(VariableType type) {
+    return static_cast<std::int32_t>(type);
+  }
+
+  void storeProgramCounter(std::size_t pc) {
+    this->assembler.moveImmediate(jit::Register::rax, pc);
+    this->assembler.store(jit::Register::r14, 0, jit::Register::rax);
+  }
+
+  // handlers read their parameter through the program counter, inline code
+  // leaves it behind
+  void syncProgramCounter(std::size_t pc) {
+    if (this->isProgramCounterStale) {
+      this->storeProgramCounter(pc);
+      this->isProgramCounterStale = false;
+    }
+  }
+
+  void copyVariable(jit::Register dstBase, std::int32_t dst, jit::Register srcBase, std::int32_t src) {
+    this->assembler.load(jit::Register::rax, srcBase, src);
+    this->assembler.store(dstBase, dst, jit::Register::rax);
+    this->assembler.load(jit::Register::rax, srcBase, src + 8);
+    this->assembler.store(dstBase, dst + 8, jit::Register::rax);
+  }
+
+  // pushes the pending value at index onto the real op stack
+  void pushValue(const TemplateValue& value, std::size_t index) {
+    switch (value.kind) {
+      case TemplateKind::Slot:
+        this->assembler.loadAddress(jit::Register::rsi, value.base, value.disp);
+        break;
+      case TemplateKind::Constant:
+        this->assembler.storeImmediate32(jit::Register::rbp, slot(index) + typeOffset(), typeCode(VariableType::Integer));
+        this->assembler.moveImmediate(jit::Register::rax, static_cast<std::uint64_t>(value.constant));
+        this->assembler.store(jit::Register::rbp, slot(index) + valueOffset(), jit::Register::rax);
+        this->assembler.loadAddress(jit::Register::rsi, jit::Register::rbp, slot(index));
+        break;
+      case TemplateKind::Boxed:
+        this->assembler.loadAddress(jit::Register::rsi, jit::Register::rbp, slot(index));
+        break;
+    }
+
+    this->assembler.call(this->helpers.pushOperand);
+  }
+
+  // pushes all but the top keep pending values, the rest move down to the
+  // spill slots of their new positions
+  void flushBelow(std::size_t keep) {
+    std::size_t count = this->pending.size() - std::min(keep, this->pending.size());
+
+    for (std::size_t i = 0; i < count; i++) {
+      this->pushValue(this->pending.at(i), i);
+    }
+
+    for (std::size_t i = count; i < this->pending.size(); i++) {
+      if (this->pending.at(i).kind == TemplateKind::Boxed) {
+        this->copyVariable(jit::Register::rbp, slot(i - count), jit::Register::rbp, slot(i));
+      }
+    }
+
+    this->pending.erase(this->pending.begin(), this->pending.begin() + static_cast<std::ptrdiff_t>(count));
+  }
+
+  void flush() {
+    this->flushBelow(0);
+  }
+
+  void push(TemplateValue value) {
+    if (this->pending.size() == maxPendingValues) {
+      this->flush();
+    }
+
+    this->pending.push_back(value);
+    this->isProgramCounterStale = true;
+  }
+
+  // leaves the integer value of the pending value at index in dst, jumping
+  // to the slow path when it is not an integer
+  void loadInteger(jit::Register dst, std::size_t index, std::size_t slowPath) {
+    const auto& value = this->pending.at(index);
+
+    switch (value.kind) {
+      case TemplateKind::Constant:
+        this->assembler.moveImmediate(dst, static_cast<std::uint64_t>(value.constant));
+        break;
+      case TemplateKind::Slot:
+        this->assembler.compareImmediate32(value.base, value.disp + typeOffset(), typeCode(VariableType::Integer));
+        this->assembler.jumpIf(jit::Condition::NotEqual, slowPath);
+        this->assembler.load(dst, value.base, value.disp + valueOffset());
+        break;
+      case TemplateKind::Boxed:
+        this->assembler.compareImmediate32(jit::Register::rbp, slot(index) + typeOffset(), typeCode(VariableType::Integer));
+        this->assembler.jumpIf(jit::Condition::NotEqual, slowPath);
+        this->assembler.load(dst, jit::Register::rbp, slot(index) + valueOffset());
+        break;
+    }
+  }
+
+  TemplateSlowPath& createSlowPath(std::size_t pc) {
+    this->slowPaths.push_back(TemplateSlowPath{
+      this->assembler.createLabel(),
+      this->assembler.createLabel(),
+      pc,
+      this->pending,
+      std::nullopt
+    });
+
+    return this->slowPaths.back();
+  }
+
+  // the result replaces both operands in the spill slot of the lower one
+  void compileArithmetic(std::size_t pc, bytecode::ByteCodeInstruction instruction) {
+    std::size_t lower = this->pending.size() - 2;
+    auto slowPath = this->createSlowPath(pc);
+
+    this->loadInteger(jit::Register::rax, lower, slowPath.label);
+    this->loadInteger(jit::Register::rcx, lower + 1, slowPath.label);
+
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::AddIntInt:
+        this->assembler.add(jit::Register::rax, jit::Register::rcx);
+        break;
+      case bytecode::ByteCodeInstruction::SubtractIntInt:
+        this->assembler.subtract(jit::Register::rax, jit::Register::rcx);
+        break;
+      default:
+        this->assembler.multiply(jit::Register::rax, jit::Register::rcx);
+        break;
+    }
+
+    this->assembler.storeImmediate32(jit::Register::rbp, slot(lower) + typeOffset(), typeCode(VariableType::Integer));
+    this->assembler.store(jit::Register::rbp, slot(lower) + valueOffset(), jit::Register::rax);
+    this->assembler.bind(slowPath.resume);
+
+    this->pending.pop_back();
+    this->pending.back() = TemplateValue{TemplateKind::Boxed, jit::Register::rbp, 0, 0};
+    this->isProgramCounterStale = true;
+  }
+
+  static jit::Condition conditionOf(bytecode::ByteCodeInstruction instruction) {
+    switch (instruction) {
+      case bytecode::ByteCodeInstruction::LessIntInt: return jit::Condition::Less;
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt: return jit::Condition::LessOrEqual;
+      case bytecode::ByteCodeInstruction::GreaterIntInt: return jit::Condition::Greater;
+      default: return jit::Condition::GreaterOrEqual;
+    }
+  }
+
+  // a comparison directly followed by a branch becomes a single conditional
+  // jump, returns the number of instructions compiled
+  std::size_t compileComparison(std::size_t pc, bytecode::ByteCodeInstruction instruction) {
+    jit::Condition condition = conditionOf(instruction);
+    std::size_t next = pc + 1;
+
+    if (next < this->size
+      && !this->isJumpTarget.at(next)
+      && this->byteCode.at(next).instruction == bytecode::ByteCodeInstruction::JumpIfFalse
+      && this->byteCode.at(next).parameter < this->size) {
+      std::size_t target = this->byteCode.at(next).parameter;
+
+      this->flushBelow(2);
+
+      auto& slowPath = this->createSlowPath(pc);
+      slowPath.branchTarget = target;
+      auto copy = slowPath;
+
+      this->loadInteger(jit::Register::rax, 0, copy.label);
+      this->loadInteger(jit::Register::rcx, 1, copy.label);
+      this->assembler.compare(jit::Register::rax, jit::Register::rcx);
+      this->assembler.jumpIf(jit::negate(condition), target);
+      this->assembler.bind(next);
+      this->assembler.bind(copy.resume);
+
+      this->pending.clear();
+      this->isProgramCounterStale = true;
+      return 2;
+    }
+
+    std::size_t lower = this->pending.size() - 2;
+    auto slowPath = this->createSlowPath(pc);
+
+    this->loadInteger(jit::Register::rax, lower, slowPath.label);
+    this->loadInteger(jit::Register::rcx, lower + 1, slowPath.label);
+    this->assembler.compare(jit::Register::rax, jit::Register::rcx);
+    this->assembler.setIf(condition, jit::Register::rax);
+    this->assembler.storeImmediate32(jit::Register::rbp, slot(lower) + typeOffset(), typeCode(VariableType::Boolean));
+    this->assembler.store(jit::Register::rbp, slot(lower) + valueOffset(), jit::Register::rax);
+    this->assembler.bind(slowPath.resume);
+
+    this->pending.pop_back();
+    this->pending.back() = TemplateValue{TemplateKind::Boxed, jit::Register::rbp, 0, 0};
+    this->isProgramCounterStale = true;
+    return 1;
+  }
+
+  // copies the top pending value into a local or global, unless a value
+  // below it was loaded from there and has to be pushed first
+  void compileStore(std::size_t pc, jit::Register base, std::int32_t disp) {
+    for (std::size_t i = 0; i + 1 < this->pending.size(); i++) {
+      const auto& value = this->pending.at(i);
+
+      if (value.kind == TemplateKind::Slot && value.base == base && value.disp == disp) {
+        this->compileGeneric(pc);
+        return;
+      }
+    }
+
+    std::size_t top = this->pending.size() - 1;
+    const auto& value = this->pending.at(top);
+
+    switch (value.kind) {
+      case TemplateKind::Slot:
+        this->copyVariable(base, disp, value.base, value.disp);
+        break;
+      case TemplateKind::Constant:
+        this->assembler.storeImmediate32(base, disp + typeOffset(), typeCode(VariableType::Integer));
+        this->assembler.moveImmediate(jit::Register::rax, static_cast<std::uint64_t>(value.constant));
+        this->assembler.store(base, disp + valueOffset(), jit::Register::rax);
+        break;
+      case TemplateKind::Boxed:
+        this->copyVariable(base, disp, jit::Register::rbp, slot(top));
+        break;
+    }
+
+    this->pending.pop_back();
+    this->isProgramCounterStale = true;
+  }
+
+  // everything else runs through its handler with the op stack in place
+  void compileGeneric(std::size_t pc) {
+    const auto& bc = this->byteCode.at(pc);
+    std::uintptr_t helper = this->helpers.handler(bc.instruction);
+
+    this->flush();
+    this->syncProgramCounter(pc);
+
+    if (helper == 0) {
+      // Halt and anything unknown is left to the interpreter
+      this->assembler.exit();
+      return;
+    }
+
+    this->assembler.call(helper);
+
+    if (this->helpers.changesStackFrame(bc.instruction)) {
+      this->assembler.exit();
+    }
+  }
+
+  void compileInstruction(std::size_t& pc) {
+    const auto& bc = this->byteCode.at(pc);
+    std::size_t localsCount = this->fn.localsCount;
+
+    switch (bc.instruction) {
+      case bytecode::ByteCodeInstruction::LoadIntegerConstant: {
+        if (bc.parameter >= this->file.intConstants.size()) {
+          break;
+        }
+        this->push(TemplateValue{TemplateKind::Constant, jit::Register::rbp, 0, this->file.intConstants.at(bc.parameter)});
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LoadLocal: {
+        if (bc.parameter >= localsCount) {
+          break;
+        }
+        this->push(TemplateValue{TemplateKind::Slot, jit::Register::r12, static_cast<std::int32_t>(16 * bc.parameter), 0});
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LoadGlobal: {
+        if (bc.parameter >= this->file.globalsCount) {
+          break;
+        }
+        this->push(TemplateValue{TemplateKind::Slot, jit::Register::r13, static_cast<std::int32_t>(16 * bc.parameter), 0});
+        return;
+      }
+      case bytecode::ByteCodeInstruction::SetLocal: {
+        if (bc.parameter >= localsCount || this->pending.empty()) {
+          break;
+        }
+        this->compileStore(pc, jit::Register::r12, static_cast<std::int32_t>(16 * bc.parameter));
+        return;
+      }
+      case bytecode::ByteCodeInstruction::SetGlobal: {
+        if (bc.parameter >= this->file.globalsCount || this->pending.empty()) {
+          break;
+        }
+        this->compileStore(pc, jit::Register::r13, static_cast<std::int32_t>(16 * bc.parameter));
+        return;
+      }
+      case bytecode::ByteCodeInstruction::AddIntInt:
+      case bytecode::ByteCodeInstruction::SubtractIntInt:
+      case bytecode::ByteCodeInstruction::MultiplyIntInt: {
+        if (this->pending.size() < 2) {
+          break;
+        }
+        this->compileArithmetic(pc, bc.instruction);
+        return;
+      }
+      case bytecode::ByteCodeInstruction::LessIntInt:
+      case bytecode::ByteCodeInstruction::LessOrEqualIntInt:
+      case bytecode::ByteCodeInstruction::GreaterIntInt:
+      case bytecode::ByteCodeInstruction::GreaterOrEqualIntInt: {
+        if (this->pending.size() < 2) {
+          break;
+        }
+        pc += this->compileComparison(pc, bc.instruction) - 1;
+        return;
+      }
+      case bytecode::ByteCodeInstruction::Jump: {
+        this->flush();
+        this->syncProgramCounter(pc);
+        this->assembler.callAndBranch(this->helpers.jump, this->exitLabel);
+        this->assembler.jump(std::min(bc.parameter, this->size));
+        return;
+      }
+      case bytecode::ByteCodeInstruction::JumpIfFalse: {
+        this->flush();
+        this->syncProgramCounter(pc);
+        this->assembler.callAndBranch(this->helpers.jumpIfFalse, std::min(bc.parameter, this->size));
+        return;
+      }
+      default:
+        break;
+    }
+
+    this->compileGeneric(pc);
+  }
+
+  // only the operands go onto the op stack, the handler replaces them with
+  // its result which is popped back into the spill slot of the lower one
+  void compileSlowPath(const TemplateSlowPath& slowPath) {
+    std::size_t lower = slowPath.pending.size() - 2;
+
+    this->assembler.bind(slowPath.label);
+    this->pushValue(slowPath.pending.at(lower), lower);
+    this->pushValue(slowPath.pending.at(lower + 1), lower + 1);
+    this->storeProgramCounter(slowPath.pc);
+    this->assembler.call(this->helpers.handler(this->byteCode.at(slowPath.pc).instruction));
+
+    if (slowPath.branchTarget) {
+      this->assembler.callAndBranch(this->helpers.jumpIfFalse, slowPath.branchTarget.value());
+
+    } else {
+      this->assembler.loadAddress(jit::Register::rsi, jit::Register::rbp, slot(lower));
+      this->assembler.call(this->helpers.popOperand);
+    }
+
+    this->assembler.jump(slowPath.resume);
+  }
+};
+
+// runs on the compile thread
+jit::CompileResult VirtualMachine::compileNative(
+  const bytecode::CompiledFile& file,
+  const bytecode::Function& fn,
+  const std::vector<bytecode::ByteCode>& byteCode
+) {
+  TemplateHelpers helpers{
+    &VirtualMachine::nativeHelper,
+    &VirtualMachine::changesStackFrame,
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeJump),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativeJumpIfFalse),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePushOperand),
+    reinterpret_cast<std::uintptr_t>(&VirtualMachine::nativePopOperand),
+  };
+
+  TemplateCompiler compiler{file, fn, byteCode, helpers};
+  auto native = compiler.compile();
+
+  return jit::CompileResult{std::move(native), std::move(compiler.entries)};
+}
+
+}
@@ -305,6 +305,10 @@ const std::vector<std::shared_ptr<TokenizerRule>> rules = {
   builtInFn("charAt"),
   builtInFn("append"),
 
+  // vm state, reserved like every other built in so scripts can no longer
+  // name a variable or parameter snapshot
+  builtInFn("snapshot"),
+
   std::make_shared<IdentifierTokenizerRule>(),
   std::make_shared<StringTokenizerRule>(),
   std::make_shared<FloatTokenizerRule>(),
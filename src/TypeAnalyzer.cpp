@@ -0,0 +1,259 @@
+#include "TypeAnalyzer.hpp"
+
+class TypeScope {
+public:
+  // parameters map to nullptr, their type is never known
+  std::unordered_map<std::string, const DeclareStatementAstNode*> declarations;
+  bool outerScopeCrossesFunctionBarrier;
+};
+
+// Infers types by walking the script until no variable changes type. Every
+// variable starts as Unknown and is widened by its initializer and each
+// assignment to it. Semantic analysis guarantees a variable is only read by
+// its own function once its declaration has run, reads from nested functions
+// may see a slot before it is bound so they are always Any.
+class TypeAnalyzerRun : public AstWalker {
+public:
+  std::unordered_map<const ExpressionAstNode*, InferredType> expressionTypes;
+  std::unordered_map<const DeclareStatementAstNode*, InferredType> variableTypes;
+  std::vector<TypeScope> scopes;
+  bool changed;
+
+  explicit TypeAnalyzerRun() noexcept
+  : changed{false}
+  {}
+
+  ~TypeAnalyzerRun() noexcept override = default;
+
+  void run(ScriptAstNode* script) noexcept {
+    do {
+      this->changed = false;
+      this->scopes.clear();
+      this->visitScriptAstNode(script);
+    } while (this->changed);
+  }
+
+  static InferredType join(InferredType t1, InferredType t2) noexcept {
+    if (t1 == InferredType::Unknown) {
+      return t2;
+    }
+
+    if (t2 == InferredType::Unknown || t1 == t2) {
+      return t1;
+    }
+
+    return InferredType::Any;
+  }
+
+  InferredType typeOf(const std::shared_ptr<ExpressionAstNode>& expression) noexcept {
+    auto find = this->expressionTypes.find(expression.get());
+
+    Error::assertWithPanic(find != this->expressionTypes.end(), "TypeAnalyzer visited an expression it did not type");
+
+    return find->second;
+  }
+
+  void setType(const ExpressionAstNode* node, InferredType type) noexcept {
+    this->expressionTypes[node] = type;
+  }
+
+  void widen(const DeclareStatementAstNode* declaration, InferredType type) noexcept {
+    auto find = this->variableTypes.find(declaration);
+
+    InferredType current = find == this->variableTypes.end() ? InferredType::Unknown : find->second;
+    InferredType widened = join(current, type);
+
+    if (widened != current) {
+      this->variableTypes[declaration] = widened;
+      this->changed = true;
+    }
+  }
+
+  // the declaration an identifier refers to from within the current function
+  std::optional<const DeclareStatementAstNode*> resolve(const std::string & identifier) noexcept {
+    for (std::size_t i = this->scopes.size(); i-- > 0;) {
+      const auto& scope = this->scopes.at(i);
+      auto find = scope.declarations.find(identifier);
+
+      if (find != scope.declarations.end()) {
+        if (find->second == nullptr) {
+          return std::nullopt;
+        }
+        return find->second;
+      }
+
+      if (scope.outerScopeCrossesFunctionBarrier) {
+        return std::nullopt;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  void pushScope(bool newFn) noexcept {
+    this->scopes.push_back(TypeScope{{}, newFn});
+  }
+
+  void popScope() noexcept {
+    Error::assertWithPanic(!this->scopes.empty(), "TypeAnalyzer popScope called with no scopes");
+    this->scopes.pop_back();
+  }
+
+  static InferredType arithmeticType(InferredType t1, InferredType t2, bool integerResultProven) noexcept {
+    if (t1 == InferredType::Unknown || t2 == InferredType::Unknown) {
+      return InferredType::Unknown;
+    }
+
+    if (t1 == InferredType::Integer && t2 == InferredType::Integer && integerResultProven) {
+      return InferredType::Integer;
+    }
+
+    if (t1 == InferredType::Float && t2 == InferredType::Float) {
+      return InferredType::Float;
+    }
+
+    return InferredType::Any;
+  }
+
+  static InferredType comparisonType(InferredType t1, InferredType t2) noexcept {
+    if (t1 == InferredType::Unknown || t2 == InferredType::Unknown) {
+      return InferredType::Unknown;
+    }
+
+    if (t1 == t2 && (t1 == InferredType::Integer || t1 == InferredType::Float)) {
+      return InferredType::Boolean;
+    }
+
+    return InferredType::Any;
+  }
+
+  static InferredType castType(InferredType t, InferredType result) noexcept {
+    if (t == InferredType::Unknown) {
+      return InferredType::Unknown;
+    }
+
+    if (t == InferredType::Integer || t == InferredType::Float) {
+      return result;
+    }
+
+    return InferredType::Any;
+  }
+
+  void onEnterScriptAstNode(ScriptAstNode* /*node*/) noexcept override {
+    this->pushScope(true);
+  }
+
+  void onEnterBlockStatementAstNode(BlockStatementAstNode* /*node*/) noexcept override {
+    this->pushScope(false);
+  }
+
+  void onExitBlockStatementAstNode(BlockStatementAstNode* /*node*/) noexcept override {
+    this->popScope();
+  }
+
+  void onEnterFunctionDeclarationExpressionAstNode(FunctionDeclarationExpressionAstNode* node) noexcept override {
+    this->pushScope(true);
+
+    for (const auto& parameter : node->parameters) {
+      this->scopes.back().declarations[parameter->value] = nullptr;
+    }
+  }
+
+  void onExitFunctionDeclarationExpressionAstNode(FunctionDeclarationExpressionAstNode* node) noexcept override {
+    this->popScope();
+    this->setType(node, InferredType::Function);
+  }
+
+  void onExitDeclareStatementAstNode(DeclareStatementAstNode* node) noexcept override {
+    this->widen(node, this->typeOf(node->expression));
+    this->scopes.back().declarations[node->identifier->value] = node;
+  }
+
+  void onExitAssignStatementAstNode(AssignStatementAstNode* node) noexcept override {
+    auto declaration = this->resolve(node->identifier->value);
+
+    if (declaration) {
+      this->widen(declaration.value(), this->typeOf(node->expression));
+    }
+  }
+
+  void onExitIdentifierExpressionAstNode(IdentifierExpressionAstNode* node) noexcept override {
+    auto declaration = this->resolve(node->token->value);
+
+    if (!declaration) {
+      this->setType(node, InferredType::Any);
+      return;
+    }
+
+    auto find = this->variableTypes.find(declaration.value());
+    this->setType(node, find == this->variableTypes.end() ? InferredType::Unknown : find->second);
+  }
+
+  void onExitLiteralExpressionAstNode(LiteralExpressionAstNode* node) noexcept override {
+    switch (node->token->tokenType) {
+      case TokenType::BooleanLiteral: { this->setType(node, InferredType::Boolean); return; }
+      case TokenType::FloatLiteral: { this->setType(node, InferredType::Float); return; }
+      case TokenType::IntegerLiteral: { this->setType(node, InferredType::Integer); return; }
+      case TokenType::UndefinedLiteral: { this->setType(node, InferredType::Undefined); return; }
+      case TokenType::StringLiteral: { this->setType(node, InferredType::String); return; }
+      default: { this->setType(node, InferredType::Any); return; }
+    }
+  }
+
+  void onExitFunctionInvocationExpressionAstNode(FunctionInvocationExpressionAstNode* node) noexcept override {
+    this->setType(node, InferredType::Any);
+  }
+
+  void onExitObjectDeclarationExpressionAstNode(ObjectDeclarationExpressionAstNode* node) noexcept override {
+    this->setType(node, InferredType::Object);
+  }
+
+  void onExitBuiltInFunctionInvocationExpressionAstNode(BuiltInFunctionInvocationExpressionAstNode* node) noexcept override {
+    const std::string & name = node->identifier->value;
+
+    std::vector<InferredType> args;
+    args.reserve(node->expressions.size());
+
+    for (const auto& expression : node->expressions) {
+      args.push_back(this->typeOf(expression));
+    }
+
+    if (name == "add" || name == "subtract" || name == "multiply") {
+      this->setType(node, arithmeticType(args.at(0), args.at(1), true));
+
+    } else if (name == "divide") {
+      // integer division by zero yields undefined
+      this->setType(node, arithmeticType(args.at(0), args.at(1), false));
+
+    } else if (name == "less" || name == "lessOrEqual" || name == "greater" || name == "greaterOrEqual") {
+      this->setType(node, comparisonType(args.at(0), args.at(1)));
+
+    } else if (name == "equal" || name == "notEqual" || name == "not" || name == "and" || name == "or") {
+      this->setType(node, InferredType::Boolean);
+
+    } else if (name == "int") {
+      this->setType(node, castType(args.at(0), InferredType::Integer));
+
+    } else if (name == "float") {
+      this->setType(node, castType(args.at(0), InferredType::Float));
+
+    } else if (name == "type" || name == "append") {
+      this->setType(node, InferredType::String);
+
+    } else if (name == "print" || name == "set" || name == "snapshot") {
+      this->setType(node, InferredType::Undefined);
+
+    } else {
+      this->setType(node, InferredType::Any);
+    }
+  }
+};
+
+std::unordered_map<const ExpressionAstNode*, InferredType> TypeAnalyzer::infer(const std::shared_ptr<ScriptAstNode>& script) noexcept {
+
+  TypeAnalyzerRun run;
+
+  run.run(script.get());
+
+  return std::move(run.expressionTypes);
+}
@@ -0,0 +1,153 @@
+#include "PassManager.hpp"
+#include "Ir.hpp"
+
+#include <map>
+
+namespace compiler {
+
+using bytecode::ByteCodeInstruction;
+
+// two values with the same key compute the same result
+class ValueKey {
+public:
+  ir::InstructionKind kind;
+  ByteCodeInstruction op;
+  std::size_t parameter;
+  std::vector<ir::ValueId> operands;
+
+  bool operator<(const ValueKey& other) const {
+    return std::tie(this->kind, this->op, this->parameter, this->operands)
+      < std::tie(other.kind, other.op, other.parameter, other.operands);
+  }
+};
+
+class ValueNumbering {
+private:
+  ir::Function& fn;
+  std::vector<std::vector<ir::BlockId>> children;
+  // pure values of the blocks that dominate the one being numbered
+  std::map<ValueKey, ir::ValueId> available;
+
+  static bool isCommutative(ByteCodeInstruction op) {
+    switch (op) {
+      case ByteCodeInstruction::Add:
+      case ByteCodeInstruction::AddIntInt:
+      case ByteCodeInstruction::AddFloatFloat:
+      case ByteCodeInstruction::Multiply:
+      case ByteCodeInstruction::MultiplyIntInt:
+      case ByteCodeInstruction::MultiplyFloatFloat:
+      case ByteCodeInstruction::Equal:
+      case ByteCodeInstruction::NotEqual:
+      case ByteCodeInstruction::And:
+      case ByteCodeInstruction::Or:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  ValueKey keyOf(const ir::Instruction& instruction) const {
+    ValueKey key{instruction.kind, instruction.op, instruction.parameter, instruction.operands};
+
+    if (instruction.kind == ir::InstructionKind::Phi) {
+      // phis are only the same within one block
+      key.parameter = instruction.block;
+    } else if (isCommutative(instruction.op)) {
+      std::sort(key.operands.begin(), key.operands.end());
+    }
+
+    return key;
+  }
+
+  bool replace(ir::ValueId id, ir::ValueId with) {
+    this->fn.replaceAllUses(id, with);
+    this->fn.remove(id);
+    return true;
+  }
+
+  // pure values are reused anywhere they dominate, values that read memory
+  // only further down their own block until something may have changed it.
+  // constants take part too, lowering loads them again at every use anyway
+  // and one id per constant lets the values computed from them match
+  bool number(ir::BlockId block) {
+    bool changed = false;
+    std::vector<ValueKey> added;
+    std::map<ValueKey, ir::ValueId> loads;
+    auto instructions = this->fn.blocks.at(block).instructions;
+
+    for (auto id : instructions) {
+      const auto& instruction = this->fn.values.at(id);
+      auto effects = ir::effectsOf(instruction.op);
+
+      if (instruction.kind == ir::InstructionKind::Operation
+        && (effects.writes != ir::Memory::None || effects.isObservable)) {
+        for (auto load = loads.begin(); load != loads.end();) {
+          if (ir::Effects::clobbers(instruction, this->fn.values.at(load->second))) {
+            load = loads.erase(load);
+          } else {
+            load++;
+          }
+        }
+        continue;
+      }
+
+      bool isCandidate = instruction.kind == ir::InstructionKind::Phi
+        || (instruction.kind == ir::InstructionKind::Operation && instruction.hasResult
+          && !effects.allocates);
+
+      if (!isCandidate) {
+        continue;
+      }
+
+      auto key = this->keyOf(instruction);
+      auto& table = effects.reads == ir::Memory::None ? this->available : loads;
+      auto find = table.find(key);
+
+      if (find != table.end()) {
+        changed = this->replace(id, find->second);
+        continue;
+      }
+
+      table.insert(std::make_pair(key, id));
+      if (&table == &this->available) {
+        added.push_back(std::move(key));
+      }
+    }
+
+    for (auto child : this->children.at(block)) {
+      changed = this->number(child) || changed;
+    }
+
+    for (const auto& key : added) {
+      this->available.erase(key);
+    }
+
+    return changed;
+  }
+
+public:
+  explicit ValueNumbering(ir::Function& fn)
+  : fn{fn}
+  , children(fn.blocks.size())
+  {
+    auto idom = fn.immediateDominators();
+
+    for (auto block : fn.reversePostOrder()) {
+      if (block != 0) {
+        this->children.at(idom.at(block)).push_back(block);
+      }
+    }
+  }
+
+  bool run() {
+    return this->number(0);
+  }
+};
+
+bool numberValues(Program& program) {
+  return ir::transform(program, [](ir::Function& fn) {
+    return ValueNumbering{fn}.run();
+  });
+}
+
+};
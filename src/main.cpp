@@ -5,29 +5,187 @@
 void usage(const std::string & msg) {
   std::cerr
     << "Error: " << msg << '\n'
-    << "Usage: flang <path to source code file>" << std::endl;
+    << "Usage: flang [-O0 | -O1 | -O2] [--pass-timing] [--inline-budget <instructions>] [--jit] [--jit-stats] [--llvm] [--profile <profile file>] [--cache <directory> | --no-cache] [--snapshot <output snapshot file> | --run-snapshot] [--aot <output c file> | --compile <output bytecode file> | --dump-ir | --run-bytecode] <path to source or bytecode file>" << std::endl;
 
   exit(1);
 }
 
 int main(int argc, char** argv) {
 
-  if (argc != 2) {
+  interpreter::Options options;
+
+  // lets a whole fleet share one compilation cache without changing any invocation
+  const char* cacheDirectory = std::getenv("FLANG_CACHE_DIR");
+
+  if (cacheDirectory != nullptr && *cacheDirectory != '\0') {
+    options.cacheDirectory = std::string{cacheDirectory};
+  }
+
+  std::optional<std::string> filePath = std::nullopt;
+  std::optional<std::string> aotPath = std::nullopt;
+  std::optional<std::string> byteCodePath = std::nullopt;
+  bool isByteCodeInput = false;
+  bool isSnapshotInput = false;
+  bool isIrDump = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg{argv[i]};
+
+    if (arg == "-O0") {
+      options.optimizationLevel = compiler::OptimizationLevel::O0;
+
+    } else if (arg == "-O1") {
+      options.optimizationLevel = compiler::OptimizationLevel::O1;
+
+    } else if (arg == "-O2") {
+      options.optimizationLevel = compiler::OptimizationLevel::O2;
+
+    } else if (arg == "--pass-timing") {
+      options.isPassTimingEnabled = true;
+
+    } else if (arg == "--inline-budget") {
+      if (i + 1 >= argc) {
+        usage("Missing instruction count for --inline-budget.");
+        return 1;
+      }
+      try {
+        options.inlineBudget = std::stoull(argv[++i]);
+      } catch (...) {
+        usage("Expected an instruction count for --inline-budget.");
+        return 1;
+      }
+
+    } else if (arg == "--jit") {
+      options.isJitEnabled = true;
+
+    } else if (arg == "--jit-stats") {
+      options.isJitEnabled = true;
+      options.isJitStatisticsEnabled = true;
+
+    } else if (arg == "--llvm") {
+      options.isJitEnabled = true;
+      options.jitBackend = jit::Backend::Llvm;
+
+    } else if (arg == "--profile") {
+      if (i + 1 >= argc) {
+        usage("Missing path for --profile.");
+        return 1;
+      }
+      options.profilePath = std::string{argv[++i]};
+
+    } else if (arg == "--cache") {
+      if (i + 1 >= argc) {
+        usage("Missing directory for --cache.");
+        return 1;
+      }
+      options.cacheDirectory = std::string{argv[++i]};
+
+    } else if (arg == "--no-cache") {
+      options.cacheDirectory = std::nullopt;
+
+    } else if (arg == "--snapshot") {
+      if (i + 1 >= argc) {
+        usage("Missing output path for --snapshot.");
+        return 1;
+      }
+      options.snapshotPath = std::string{argv[++i]};
+
+    } else if (arg == "--run-snapshot") {
+      isSnapshotInput = true;
+
+    } else if (arg == "--aot") {
+      if (i + 1 >= argc) {
+        usage("Missing output path for --aot.");
+        return 1;
+      }
+      aotPath = std::string{argv[++i]};
+
+    } else if (arg == "--compile") {
+      if (i + 1 >= argc) {
+        usage("Missing output path for --compile.");
+        return 1;
+      }
+      byteCodePath = std::string{argv[++i]};
+
+    } else if (arg == "--dump-ir") {
+      isIrDump = true;
+
+    } else if (arg == "--run-bytecode") {
+      isByteCodeInput = true;
+
+    } else if (!filePath) {
+      filePath = arg;
+
+    } else {
+      usage("Unexpected number of arguments.");
+      return 1;
+    }
+  }
+
+  if (!filePath) {
     usage("Unexpected number of arguments.");
     return 1;
   }
 
-  std::string filePath{argv[1]};
+  if ((isByteCodeInput || isSnapshotInput) && (aotPath || byteCodePath || isIrDump)) {
+    usage("--run-bytecode and --run-snapshot can not be combined with --aot, --compile or --dump-ir.");
+    return 1;
+  }
+
+  if (isByteCodeInput && isSnapshotInput) {
+    usage("--run-bytecode can not be combined with --run-snapshot.");
+    return 1;
+  }
+
+  auto interpreter = std::make_shared<interpreter::Interpreter>(std::cout, std::cin, options);
+
+  if (isByteCodeInput) {
+    interpreter->RunByteCode(filePath.value());
+    return 0;
+  }
+
+  if (isSnapshotInput) {
+    interpreter->RunSnapshot(filePath.value());
+    return 0;
+  }
 
-  auto contents = io::readFileToString(filePath);
+  auto contents = io::readFileToString(filePath.value());
 
   if (!contents) {
     usage("Could not open file.");
     return 1;
   }
 
-  auto interpreter = std::make_shared<interpreter::Interpreter>(std::cout, std::cin);
+  if (isIrDump) {
+    interpreter->DumpIr(contents.value(), std::cout);
+    return 0;
+  }
+
+  if (aotPath) {
+    std::ofstream c{aotPath.value()};
+
+    if (c.fail()) {
+      usage("Could not open output file.");
+      return 1;
+    }
+
+    interpreter->CompileToC(contents.value(), c);
+    return 0;
+  }
+
+  if (byteCodePath) {
+    std::ofstream byteCode{byteCodePath.value(), std::ios::binary};
+
+    if (byteCode.fail()) {
+      usage("Could not open output file.");
+      return 1;
+    }
+
+    interpreter->CompileToByteCode(contents.value(), byteCode);
+    return 0;
+  }
+
   interpreter->Run(contents.value());
 
   return 0;
-}
\ No newline at end of file
+}
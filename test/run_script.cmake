@@ -0,0 +1,156 @@
+# runs a script through flang and compares what it prints with an expected
+# output file, used as cmake -DFLANG=... -DSCRIPT=... -DEXPECTED=... -DMODE=...
+# -DWORK_DIR=... [-DFLAGS=...] -P run_script.cmake
+#
+# modes:
+#   run       runs the script
+#   bytecode  compiles the script to a bytecode file and runs that
+#   snapshot  stops the script at snapshot() and resumes it, both parts
+#             together have to print the expected output
+#   cache     runs the script through an empty cache, again through the filled
+#             one, with a changed source and with a damaged entry
+#   profile   runs the script twice, the second time with the profile of the first
+#   aot       compiles the script to C, builds it with CC against the runtime
+#             library in BUILD_DIR and runs the executable
+
+cmake_minimum_required(VERSION 3.10.2)
+
+foreach(variable FLANG SCRIPT EXPECTED MODE WORK_DIR)
+  if (NOT DEFINED ${variable})
+    message(FATAL_ERROR "${variable} is not set")
+  endif()
+endforeach()
+
+separate_arguments(FLAGS UNIX_COMMAND "${FLAGS}")
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+file(READ ${EXPECTED} expected)
+
+get_filename_component(name ${SCRIPT} NAME_WE)
+
+function(run_flang output)
+  execute_process(
+    COMMAND ${FLANG} ${ARGN}
+    WORKING_DIRECTORY ${WORK_DIR}
+    OUTPUT_VARIABLE stdout
+    ERROR_VARIABLE stderr
+    RESULT_VARIABLE result)
+
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "flang ${ARGN} exited with ${result}\n${stdout}${stderr}")
+  endif()
+
+  set(${output} "${stdout}" PARENT_SCOPE)
+endfunction()
+
+function(expect_output actual what)
+  if (NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${what} printed\n${actual}\nbut expected\n${expected}")
+  endif()
+endfunction()
+
+function(expect_entries directory count what)
+  file(GLOB entries ${directory}/*.fbc)
+  list(LENGTH entries found)
+
+  if (NOT found EQUAL count)
+    message(FATAL_ERROR "${what} left ${found} cache entries instead of ${count}")
+  endif()
+endfunction()
+
+if (MODE STREQUAL "run")
+  run_flang(output --no-cache ${FLAGS} ${SCRIPT})
+  expect_output("${output}" "${name}")
+
+elseif (MODE STREQUAL "bytecode")
+  run_flang(ignored --no-cache ${FLAGS} --compile ${WORK_DIR}/${name}.fbc ${SCRIPT})
+  run_flang(output ${FLAGS} --run-bytecode ${WORK_DIR}/${name}.fbc)
+  expect_output("${output}" "${name}.fbc")
+
+elseif (MODE STREQUAL "snapshot")
+  run_flang(before --no-cache ${FLAGS} --snapshot ${WORK_DIR}/${name}.snapshot ${SCRIPT})
+  run_flang(after ${FLAGS} --run-snapshot ${WORK_DIR}/${name}.snapshot)
+  expect_output("${before}${after}" "${name} stopped and resumed at snapshot()")
+
+elseif (MODE STREQUAL "cache")
+  set(cache ${WORK_DIR}/cache)
+  configure_file(${SCRIPT} ${WORK_DIR}/${name}.f COPYONLY)
+
+  run_flang(output ${FLAGS} --cache ${cache} ${WORK_DIR}/${name}.f)
+  expect_output("${output}" "${name} on a miss")
+  expect_entries(${cache} 1 "a miss")
+
+  file(GLOB entry ${cache}/*.fbc)
+  file(READ ${entry} written HEX)
+
+  run_flang(output ${FLAGS} --cache ${cache} ${WORK_DIR}/${name}.f)
+  expect_output("${output}" "${name} on a hit")
+  expect_entries(${cache} 1 "a hit")
+
+  # a damaged entry under the right name is a miss and gets replaced
+  file(WRITE ${entry} "FLANGCE")
+  run_flang(output ${FLAGS} --cache ${cache} ${WORK_DIR}/${name}.f)
+  expect_output("${output}" "${name} with a damaged entry")
+  file(READ ${entry} replaced HEX)
+
+  if (NOT replaced STREQUAL written)
+    message(FATAL_ERROR "the damaged cache entry was not replaced")
+  endif()
+
+  # a changed source must not run the old entry
+  file(APPEND ${WORK_DIR}/${name}.f "print(\"changed\\n\");\n")
+  set(expected "${expected}changed\n")
+  run_flang(output ${FLAGS} --cache ${cache} ${WORK_DIR}/${name}.f)
+  expect_output("${output}" "${name} after a change")
+  expect_entries(${cache} 2 "a changed source")
+
+elseif (MODE STREQUAL "profile")
+  set(profile ${WORK_DIR}/${name}.profile)
+
+  run_flang(output --no-cache ${FLAGS} --profile ${profile} ${SCRIPT})
+  expect_output("${output}" "${name} without a profile")
+  file(READ ${profile} cold)
+
+  if (NOT cold MATCHES "^flang-profile 2\n")
+    message(FATAL_ERROR "no profile was written\n${cold}")
+  endif()
+
+  run_flang(output --no-cache ${FLAGS} --profile ${profile} ${SCRIPT})
+  expect_output("${output}" "${name} with a profile")
+
+elseif (MODE STREQUAL "aot")
+  foreach(variable CC BUILD_DIR SOURCE_DIR)
+    if (NOT DEFINED ${variable})
+      message(FATAL_ERROR "${variable} is not set")
+    endif()
+  endforeach()
+
+  run_flang(ignored --no-cache ${FLAGS} --aot ${WORK_DIR}/${name}.c ${SCRIPT})
+
+  file(READ ${BUILD_DIR}/flang_runtime_libraries.txt libraries)
+  separate_arguments(libraries UNIX_COMMAND "${libraries}")
+
+  execute_process(
+    COMMAND ${CC} -O2 -I${SOURCE_DIR}/include ${WORK_DIR}/${name}.c -L${BUILD_DIR} ${libraries} -o ${WORK_DIR}/${name}
+    RESULT_VARIABLE result
+    ERROR_VARIABLE stderr)
+
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "could not build ${name}.c\n${stderr}")
+  endif()
+
+  execute_process(
+    COMMAND ${WORK_DIR}/${name}
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result)
+
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${name} built ahead of time exited with ${result}")
+  endif()
+
+  expect_output("${output}" "${name} built ahead of time")
+
+else()
+  message(FATAL_ERROR "unknown mode ${MODE}")
+endif()